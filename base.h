@@ -46,6 +46,16 @@
 #define ORCA_UNREACHABLE assert(false)
 #endif
 
+// printf-style format checking, where the compiler can do it
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__has_attribute)
+#if __has_attribute(format)
+#define ORCA_PRINTF(...) __attribute__((format(printf, __VA_ARGS__)))
+#endif
+#endif
+#ifndef ORCA_PRINTF
+#define ORCA_PRINTF(...)
+#endif
+
 // array count, safer on gcc/clang
 #if defined(__GNUC__) || defined(__clang__)
 #define ORCA_ASSERT_IS_ARRAY(_array)                                           \
@@ -90,6 +100,32 @@ ORCA_FORCEINLINE static Usz orca_round_up_power2(Usz x) {
   return x + 1;
 }
 
+// Index of the lowest set bit. `x` must not be zero.
+ORCA_FORCEINLINE static Usz orca_ctz64(U64 x) {
+  assert(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+  return (Usz)__builtin_ctzll(x);
+#else
+  Usz n = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+ORCA_FORCEINLINE static Usz orca_popcount64(U64 x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (Usz)__builtin_popcountll(x);
+#else
+  Usz n = 0;
+  for (; x; x &= x - 1)
+    ++n;
+  return n;
+#endif
+}
+
 ORCA_OK_IF_UNUSED
 static bool orca_is_valid_glyph(Glyph c) {
   if (c >= '0' && c <= '9')
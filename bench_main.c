@@ -0,0 +1,236 @@
+#include "base.h"
+#include "field.h"
+#include "gbuffer.h"
+#include "osc_out.h"
+#include "sim.h"
+#include "vmio.h"
+#include <getopt.h>
+#include <stdio.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#undef SOKOL_IMPL
+
+static ORCA_NOINLINE void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: bench [options] infile...\n\n"
+"Runs each file in the VM and prints timing results as JSON to stdout.\n"
+"The time taken to work out the MIDI and OSC messages for the events each\n"
+"timestep emits, at 120 BPM, is measured too, as out_ns_per_1k_events.\n\n"
+"Options:\n"
+"    -t <number>   Number of timesteps to measure for each file.\n"
+"                  Default: 1000\n"
+"    -w <number>   Number of untimed runs of the same number of\n"
+"                  timesteps to do first, for each file.\n"
+"                  Default: 2\n"
+"    -b <number>   Run each timestep on up to this many threads, split\n"
+"                  into horizontal bands, like orca --bands.\n"
+"                  Default: 1\n"
+"    -h or --help  Print this message and exit.\n"
+);} // clang-format on
+
+static int cmp_u64(void const *a, void const *b) {
+  U64 x = *(U64 const *)a, y = *(U64 const *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Index into sorted samples for the given percentile, using the nearest-rank
+// method. `count` must not be zero.
+static Usz percentile_index(Usz count, Usz percentile) {
+  Usz rank = (count * percentile + 99) / 100;
+  return rank == 0 ? 0 : rank - 1;
+}
+
+static void fput_json_string(char const *str, FILE *stream) {
+  fputc('"', stream);
+  for (; *str; ++str) {
+    unsigned char c = (unsigned char)*str;
+    if (c == '"' || c == '\\')
+      fprintf(stream, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(stream, "\\u%04x", (unsigned)c);
+    else
+      fputc(c, stream);
+  }
+  fputc('"', stream);
+}
+
+enum { Bench_bpm = 120 };
+
+// Runs `ticks` timesteps starting from `original`, timing each one if
+// `tick_ns` is not NULL. The events from each one are turned into what would
+// be sent for them, which is timed separately, into `out_ns`.
+static void bench_run(Field const *original, Field *field,
+                      Mbuf_reusable *mbuf_r, Oevent_list *oevent_list,
+                      Orca_vm *vm, Live_index *live_index,
+                      Orca_band_pool *band_pool, Susnote_list *susnote_list,
+                      Oevent_out_list *out_list, Usz ticks, U64 *tick_ns,
+                      Usz *out_event_count, U64 *out_ns) {
+  Usz height = original->height, width = original->width;
+  field_resize_raw(field, height, width);
+  memcpy(field->buffer, original->buffer, height * width * sizeof(Glyph));
+  orca_vm_reset(vm);
+  live_index_invalidate(live_index);
+  susnote_list_clear(susnote_list);
+  double frame_secs = 60.0 / (double)Bench_bpm / 4.0;
+  Usz event_count = 0;
+  U64 total_out_ns = 0;
+  for (Usz i = 0; i < ticks; ++i) {
+    U64 start = stm_now();
+    oevent_list_clear(oevent_list);
+    orca_run(field->buffer, mbuf_r->buffer, height, width, i, oevent_list, 0,
+             vm, live_index, band_pool);
+    if (tick_ns)
+      tick_ns[i] = (U64)stm_ns(stm_since(start));
+    event_count += oevent_list->count;
+    start = stm_now();
+    Usz start_removed, end_removed;
+    double soonest_deadline;
+    susnote_list_advance_time(susnote_list, frame_secs, &start_removed,
+                              &end_removed, &soonest_deadline);
+    oevent_out_list_build(out_list, susnote_list, oevent_list->buffer,
+                          oevent_list->count, Bench_bpm);
+    total_out_ns += (U64)stm_ns(stm_since(start));
+  }
+  *out_event_count = event_count;
+  *out_ns = total_out_ns;
+}
+
+int main(int argc, char **argv) {
+  static struct option bench_options[] = {{"help", no_argument, 0, 'h'},
+                                          {NULL, 0, NULL, 0}};
+  int ticks = 1000;
+  int warmup = 2;
+  int band_threads = 1;
+  for (;;) {
+    int c = getopt_long(argc, argv, "t:w:b:h", bench_options, NULL);
+    if (c == -1)
+      break;
+    switch (c) {
+    case 't':
+      ticks = atoi(optarg);
+      if (ticks < 1) {
+        fprintf(stderr,
+                "Bad timestep argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case 'w':
+      warmup = atoi(optarg);
+      if (warmup < 0 || (warmup == 0 && strcmp(optarg, "0"))) {
+        fprintf(stderr,
+                "Bad warmup argument %s.\n"
+                "Must be 0 or a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case 'b':
+      band_threads = atoi(optarg);
+      if (band_threads < 1) {
+        fprintf(stderr,
+                "Bad thread count argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case 'h':
+      usage();
+      return 0;
+    case '?':
+      usage();
+      return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "No input files.\n");
+    usage();
+    return 1;
+  }
+
+  stm_setup();
+  Usz max_ticks = (Usz)ticks;
+  U64 *tick_ns = malloc(max_ticks * sizeof(U64));
+  Field original, field;
+  field_init(&original);
+  field_init(&field);
+  Mbuf_reusable mbuf_r;
+  mbuf_reusable_init(&mbuf_r);
+  Oevent_list oevent_list;
+  oevent_list_init(&oevent_list);
+  Orca_vm vm;
+  orca_vm_init(&vm);
+  Live_index live_index;
+  live_index_init(&live_index);
+  Orca_band_pool band_pool;
+  orca_band_pool_init(&band_pool, (Usz)band_threads);
+  Susnote_list susnote_list;
+  susnote_list_init(&susnote_list);
+  Oevent_out_list out_list;
+  oevent_out_list_init(&out_list);
+  int exit_code = 0;
+
+  printf("{\n  \"ticks\": %d,\n  \"warmup\": %d,\n  \"band_threads\": %zu,\n"
+         "  \"results\": [",
+         ticks, warmup, band_pool.thread_count);
+  bool first_result = true;
+  for (int i = optind; i < argc; ++i) {
+    char const *input_file = argv[i];
+    Field_load_error fle = field_load_file(input_file, &original);
+    if (fle != Field_load_error_ok) {
+      fprintf(stderr, "File load error for %s: %s.\n", input_file,
+              field_load_error_string(fle));
+      exit_code = 1;
+      continue;
+    }
+    Usz height = original.height, width = original.width;
+    mbuf_reusable_ensure_size(&mbuf_r, height, width);
+    Usz event_count = 0;
+    U64 out_ns = 0;
+    for (int j = 0; j < warmup; ++j) {
+      bench_run(&original, &field, &mbuf_r, &oevent_list, &vm, &live_index,
+                &band_pool, &susnote_list, &out_list, max_ticks, NULL,
+                &event_count, &out_ns);
+    }
+    bench_run(&original, &field, &mbuf_r, &oevent_list, &vm, &live_index,
+              &band_pool, &susnote_list, &out_list, max_ticks, tick_ns,
+              &event_count, &out_ns);
+    U64 total_ns = 0;
+    for (Usz j = 0; j < max_ticks; ++j) {
+      total_ns += tick_ns[j];
+    }
+    qsort(tick_ns, max_ticks, sizeof(U64), cmp_u64);
+    double ns_per_tick = (double)total_ns / (double)max_ticks;
+    double ns_per_cell = ns_per_tick / (double)(height * width);
+    double events_per_tick = (double)event_count / (double)max_ticks;
+    double out_ns_per_1k_events =
+        event_count ? (double)out_ns * 1000.0 / (double)event_count : 0.0;
+    printf("%s\n    {\"file\": ", first_result ? "" : ",");
+    fput_json_string(input_file, stdout);
+    printf(", \"height\": %zu, \"width\": %zu, \"ns_per_tick\": %.1f, "
+           "\"ns_per_cell\": %.3f, \"events_per_tick\": %.3f, "
+           "\"out_ns_per_1k_events\": %.1f, "
+           "\"p50_tick_ns\": %llu, \"p99_tick_ns\": %llu}",
+           height, width, ns_per_tick, ns_per_cell, events_per_tick,
+           out_ns_per_1k_events,
+           (unsigned long long)tick_ns[percentile_index(max_ticks, 50)],
+           (unsigned long long)tick_ns[percentile_index(max_ticks, 99)]);
+    first_result = false;
+  }
+  printf("\n  ]\n}\n");
+
+  free(tick_ns);
+  field_deinit(&original);
+  field_deinit(&field);
+  mbuf_reusable_deinit(&mbuf_r);
+  oevent_list_deinit(&oevent_list);
+  live_index_deinit(&live_index);
+  orca_vm_deinit(&vm);
+  orca_band_pool_deinit(&band_pool);
+  susnote_list_deinit(&susnote_list);
+  oevent_out_list_deinit(&out_list);
+  return exit_code;
+}
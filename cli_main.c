@@ -2,31 +2,389 @@
 #include "field.h"
 #include "gbuffer.h"
 #include "sim.h"
+#include "snapshot.h"
 #include "vmio.h"
 #include <getopt.h>
+#include <pthread.h>
 
 static ORCA_NOINLINE void usage(void) { // clang-format off
 fprintf(stderr,
-"Usage: cli [options] infile\n\n"
+"Usage: cli [options] infile\n"
+"       cli [options] -j <number> infile...\n"
+"       cli [options] --manifest <file>\n\n"
+"With more than one input file, a manifest, or -j, the files are run in\n"
+"batch mode: they're spread over a pool of threads, and instead of the\n"
+"grid, one line is printed for each file, in input order:\n"
+"    ok <file> <height>x<width> grid <digest> events <count> <digest>\n"
+"    error <file> <reason>\n"
+"separated by tabs. The digests are 64-bit FNV-1a hashes of the final\n"
+"grid and of every event from every timestep.\n\n"
 "Options:\n"
 "    -t <number>   Number of timesteps to simulate.\n"
 "                  Must be 0 or a positive integer.\n"
 "                  Default: 1\n"
 "    -q or --quiet Don't print the result to stdout.\n"
+"    --marks       After the grid, also print the marks from the last\n"
+"                  timestep, one character per cell.\n"
+"    --events      Print the output events of every timestep, as they\n"
+"                  happen.\n"
+"    --bands <number>\n"
+"                  Run each timestep on up to this many threads, by\n"
+"                  splitting the grid into horizontal bands that don't\n"
+"                  affect each other. The results are the same.\n"
+"                  Can't be used in batch mode.\n"
+"                  Default: 1\n"
+"    --seek <number>\n"
+"                  After simulating, seek to the start of this timestep\n"
+"                  and print the grid from there instead. Seeking back\n"
+"                  loads the nearest checkpoint and runs forward from it.\n"
+"                  Can't be used with --marks or in batch mode.\n"
+"    --checkpoint-every <number>\n"
+"                  Save a checkpoint for --seek every this many\n"
+"                  timesteps.\n"
+"                  Default: 64\n"
+"    -j <number>   Number of threads to use in batch mode.\n"
+"                  Default: the number of online CPUs\n"
+"    --manifest <file>\n"
+"                  Read input files from <file>, one per line, and use\n"
+"                  batch mode. Empty lines and lines starting with #\n"
+"                  are skipped. Use - to read from stdin.\n"
 "    -h or --help  Print this message and exit.\n"
 );} // clang-format on
 
+// Mark flags fit in 5 bits, so each combination gets its own character.
+static void marks_fput(Mark const *mbuf, Usz height, Usz width, FILE *stream) {
+  static char const mark_chars[32] = "0123456789abcdefghijklmnopqrstuv";
+  for (Usz iy = 0; iy < height; ++iy) {
+    Mark const *row_p = mbuf + width * iy;
+    for (Usz ix = 0; ix < width; ++ix) {
+      fputc(mark_chars[row_p[ix] & 31], stream);
+    }
+    fputc('\n', stream);
+  }
+}
+
+static void oevent_list_fput(Oevent_list const *oevent_list, Usz tick_number,
+                             FILE *stream) {
+  for (Usz i = 0, num_events = oevent_list->count; i < num_events; ++i) {
+    Oevent const *ev = oevent_list->buffer + i;
+    fprintf(stream, "%zu\t", tick_number);
+    switch ((Oevent_types)ev->any.oevent_type) {
+    case Oevent_type_midi_note: {
+      Oevent_midi_note const *em = &ev->midi_note;
+      fprintf(stream,
+              "MIDI Note\tchannel %d\toctave %d\tnote %d\tvelocity %d\t"
+              "length %d\tmono %d\n",
+              (int)em->channel, (int)em->octave, (int)em->note,
+              (int)em->velocity, (int)em->duration, (int)em->mono);
+      break;
+    }
+    case Oevent_type_midi_cc: {
+      Oevent_midi_cc const *ec = &ev->midi_cc;
+      fprintf(stream, "MIDI CC\tchannel %d\tcontrol %d\tvalue %d\n",
+              (int)ec->channel, (int)ec->control, (int)ec->value);
+      break;
+    }
+    case Oevent_type_midi_pb: {
+      Oevent_midi_pb const *ep = &ev->midi_pb;
+      fprintf(stream, "MIDI PB\tchannel %d\tmsb %d\tlsb %d\n",
+              (int)ep->channel, (int)ep->msb, (int)ep->lsb);
+      break;
+    }
+    case Oevent_type_osc_ints: {
+      Oevent_osc_ints const *eo = &ev->osc_ints;
+      fprintf(stream, "OSC\t%c\tcount %d\t|", eo->glyph, (int)eo->count);
+      for (Usz j = 0; j < eo->count; ++j) {
+        fprintf(stream, " %d", (int)eo->numbers[j]);
+      }
+      fputc('\n', stream);
+      break;
+    }
+    case Oevent_type_udp_string: {
+      Oevent_udp_string const *eo = &ev->udp_string;
+      fprintf(stream, "UDP\tcount %d\t%.*s\n", (int)eo->count, (int)eo->count,
+              eo->chars);
+      break;
+    }
+    }
+  }
+}
+
+//////// Batch mode
+
+static U64 const fnv1a_basis = UINT64_C(0xcbf29ce484222325);
+
+static U64 fnv1a(U64 hash, void const *data, Usz size) {
+  U8 const *bytes = data;
+  for (Usz i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+// Hashes the fields of the event one at a time, so that padding and unused
+// bytes in the union don't change the result.
+static U64 oevent_digest(U64 hash, Usz tick_number, Oevent const *ev) {
+  U8 fields[4 + Oevent_osc_int_count];
+  Usz count = 0;
+  U64 tick = (U64)tick_number;
+  hash = fnv1a(hash, &tick, sizeof tick);
+  fields[count++] = ev->any.oevent_type;
+  switch ((Oevent_types)ev->any.oevent_type) {
+  case Oevent_type_midi_note:
+    fields[count++] = ev->midi_note.channel;
+    fields[count++] = ev->midi_note.octave;
+    fields[count++] = ev->midi_note.note;
+    fields[count++] = ev->midi_note.velocity;
+    fields[count++] = ev->midi_note.duration;
+    fields[count++] = ev->midi_note.mono;
+    break;
+  case Oevent_type_midi_cc:
+    fields[count++] = ev->midi_cc.channel;
+    fields[count++] = ev->midi_cc.control;
+    fields[count++] = ev->midi_cc.value;
+    break;
+  case Oevent_type_midi_pb:
+    fields[count++] = ev->midi_pb.channel;
+    fields[count++] = ev->midi_pb.lsb;
+    fields[count++] = ev->midi_pb.msb;
+    break;
+  case Oevent_type_osc_ints:
+    fields[count++] = (U8)ev->osc_ints.glyph;
+    fields[count++] = ev->osc_ints.count;
+    for (Usz i = 0; i < ev->osc_ints.count && i < Oevent_osc_int_count; ++i)
+      fields[count++] = ev->osc_ints.numbers[i];
+    break;
+  case Oevent_type_udp_string:
+    fields[count++] = ev->udp_string.count;
+    for (Usz i = 0; i < ev->udp_string.count && i < Oevent_udp_string_count;
+         ++i)
+      fields[count++] = (U8)ev->udp_string.chars[i];
+    break;
+  }
+  return fnv1a(hash, fields, count);
+}
+
+typedef struct {
+  char const *path;
+  Field_load_error load_error;
+  Usz height, width, event_count;
+  U64 grid_digest, event_digest;
+  bool is_done;
+} Batch_result;
+
+typedef struct {
+  Batch_result *results;
+  Usz count, next_to_run, next_to_print, ticks;
+  int failures;
+  pthread_mutex_t lock;
+} Batch;
+
+// Each worker reuses its own buffers and VM state from one file to the next.
+typedef struct {
+  Batch *batch;
+  Field field;
+  Mbuf_reusable mbuf_r;
+  Oevent_list oevent_list;
+  Live_index live_index;
+  Orca_vm vm;
+  pthread_t thread;
+} Batch_worker;
+
+static void batch_worker_init(Batch_worker *w, Batch *batch) {
+  w->batch = batch;
+  field_init(&w->field);
+  mbuf_reusable_init(&w->mbuf_r);
+  oevent_list_init(&w->oevent_list);
+  live_index_init(&w->live_index);
+  orca_vm_init(&w->vm);
+}
+
+static void batch_worker_deinit(Batch_worker *w) {
+  field_deinit(&w->field);
+  mbuf_reusable_deinit(&w->mbuf_r);
+  oevent_list_deinit(&w->oevent_list);
+  live_index_deinit(&w->live_index);
+  orca_vm_deinit(&w->vm);
+}
+
+static void batch_run_file(Batch_worker *w, Batch_result *r) {
+  r->load_error = field_load_file(r->path, &w->field);
+  if (r->load_error != Field_load_error_ok)
+    return;
+  Usz height = w->field.height, width = w->field.width;
+  mbuf_reusable_ensure_size(&w->mbuf_r, height, width);
+  live_index_invalidate(&w->live_index);
+  orca_vm_reset(&w->vm);
+  U64 event_digest = fnv1a_basis;
+  Usz event_count = 0;
+  for (Usz i = 0, ticks = w->batch->ticks; i < ticks; ++i) {
+    oevent_list_clear(&w->oevent_list);
+    orca_run(w->field.buffer, w->mbuf_r.buffer, height, width, i,
+             &w->oevent_list, 0, &w->vm, &w->live_index, NULL);
+    for (Usz j = 0; j < w->oevent_list.count; ++j) {
+      event_digest = oevent_digest(event_digest, i, w->oevent_list.buffer + j);
+    }
+    event_count += w->oevent_list.count;
+  }
+  r->height = height;
+  r->width = width;
+  r->event_count = event_count;
+  r->event_digest = event_digest;
+  r->grid_digest =
+      fnv1a(fnv1a_basis, w->field.buffer, height * width * sizeof(Glyph));
+}
+
+// Must be called with the batch lock held.
+static void batch_print_finished(Batch *b) {
+  for (; b->next_to_print < b->count; ++b->next_to_print) {
+    Batch_result const *r = b->results + b->next_to_print;
+    if (!r->is_done)
+      break;
+    if (r->load_error != Field_load_error_ok) {
+      printf("error\t%s\t%s\n", r->path,
+             field_load_error_string(r->load_error));
+      ++b->failures;
+      continue;
+    }
+    printf("ok\t%s\t%zux%zu\tgrid %016llx\tevents %zu %016llx\n", r->path,
+           r->height, r->width, (unsigned long long)r->grid_digest,
+           r->event_count, (unsigned long long)r->event_digest);
+  }
+  fflush(stdout);
+}
+
+static void *batch_worker_main(void *arg) {
+  Batch_worker *w = arg;
+  Batch *b = w->batch;
+  pthread_mutex_lock(&b->lock);
+  while (b->next_to_run < b->count) {
+    Batch_result *r = b->results + b->next_to_run++;
+    pthread_mutex_unlock(&b->lock);
+    batch_run_file(w, r);
+    pthread_mutex_lock(&b->lock);
+    r->is_done = true;
+    batch_print_finished(b);
+  }
+  pthread_mutex_unlock(&b->lock);
+  return NULL;
+}
+
+// Returns the number of files which couldn't be run.
+static int batch_run(char const *const *paths, Usz count, Usz ticks,
+                     Usz num_workers) {
+  Batch b;
+  b.results = calloc(count, sizeof(Batch_result));
+  b.count = count;
+  b.next_to_run = b.next_to_print = 0;
+  b.ticks = ticks;
+  b.failures = 0;
+  pthread_mutex_init(&b.lock, NULL);
+  for (Usz i = 0; i < count; ++i) {
+    b.results[i].path = paths[i];
+  }
+  if (num_workers > count)
+    num_workers = count;
+  if (num_workers < 1)
+    num_workers = 1;
+  Batch_worker *workers = malloc(num_workers * sizeof(Batch_worker));
+  Usz num_started = 1;
+  for (Usz i = 0; i < num_workers; ++i) {
+    batch_worker_init(workers + i, &b);
+  }
+  // The calling thread is the first worker.
+  for (Usz i = 1; i < num_workers; ++i) {
+    if (pthread_create(&workers[i].thread, NULL, batch_worker_main,
+                       workers + i) != 0) {
+      fprintf(stderr, "Unable to start more than %zu threads.\n", num_started);
+      break;
+    }
+    ++num_started;
+  }
+  batch_worker_main(workers);
+  for (Usz i = 1; i < num_started; ++i) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (Usz i = 0; i < num_workers; ++i) {
+    batch_worker_deinit(workers + i);
+  }
+  free(workers);
+  pthread_mutex_destroy(&b.lock);
+  free(b.results);
+  return b.failures;
+}
+
+// Returns false if the manifest file couldn't be read.
+static bool manifest_read(char const *manifest_path, char ***out_paths,
+                          Usz *out_count) {
+  FILE *file = strcmp(manifest_path, "-") ? fopen(manifest_path, "r") : stdin;
+  if (!file)
+    return false;
+  char **paths = *out_paths;
+  Usz count = *out_count, capacity = count;
+  enum { Bufsize = 4096 };
+  char buf[Bufsize];
+  while (fgets(buf, Bufsize, file)) {
+    Usz len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+      --len;
+    if (len == 0 || buf[0] == '#')
+      continue;
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      paths = realloc(paths, capacity * sizeof(char *));
+    }
+    char *path = malloc(len + 1);
+    memcpy(path, buf, len);
+    path[len] = '\0';
+    paths[count++] = path;
+  }
+  bool ok = !ferror(file);
+  if (file != stdin)
+    fclose(file);
+  *out_paths = paths;
+  *out_count = count;
+  return ok;
+}
+
 int main(int argc, char **argv) {
+  enum {
+    Argopt_marks = UCHAR_MAX + 1,
+    Argopt_events,
+    Argopt_manifest,
+    Argopt_bands,
+    Argopt_seek,
+    Argopt_checkpoint_every,
+  };
   static struct option cli_options[] = {{"help", no_argument, 0, 'h'},
                                         {"quiet", no_argument, 0, 'q'},
+                                        {"marks", no_argument, 0, Argopt_marks},
+                                        {"events", no_argument, 0,
+                                         Argopt_events},
+                                        {"manifest", required_argument, 0,
+                                         Argopt_manifest},
+                                        {"bands", required_argument, 0,
+                                         Argopt_bands},
+                                        {"seek", required_argument, 0,
+                                         Argopt_seek},
+                                        {"checkpoint-every", required_argument,
+                                         0, Argopt_checkpoint_every},
                                         {NULL, 0, NULL, 0}};
 
   char *input_file = NULL;
   int ticks = 1;
   bool print_output = true;
+  bool print_marks = false;
+  bool print_events = false;
+  char const *manifest_path = NULL;
+  int num_jobs = 0;
+  int band_threads = 0;
+  int seek_tick = -1;
+  int checkpoint_interval = Orca_checkpoint_interval_default;
 
   for (;;) {
-    int c = getopt_long(argc, argv, "t:qh", cli_options, NULL);
+    int c = getopt_long(argc, argv, "t:qj:h", cli_options, NULL);
     if (c == -1)
       break;
     switch (c) {
@@ -43,6 +401,55 @@ int main(int argc, char **argv) {
     case 'q':
       print_output = false;
       break;
+    case Argopt_marks:
+      print_marks = true;
+      break;
+    case Argopt_events:
+      print_events = true;
+      break;
+    case Argopt_manifest:
+      manifest_path = optarg;
+      break;
+    case Argopt_bands:
+      band_threads = atoi(optarg);
+      if (band_threads < 1) {
+        fprintf(stderr,
+                "Bad thread count argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Argopt_seek:
+      seek_tick = atoi(optarg);
+      if (seek_tick < 0 || (seek_tick == 0 && strcmp(optarg, "0"))) {
+        fprintf(stderr,
+                "Bad seek argument %s.\n"
+                "Must be 0 or a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case Argopt_checkpoint_every:
+      checkpoint_interval = atoi(optarg);
+      if (checkpoint_interval < 1) {
+        fprintf(stderr,
+                "Bad checkpoint interval argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
+    case 'j':
+      num_jobs = atoi(optarg);
+      if (num_jobs < 1) {
+        fprintf(stderr,
+                "Bad thread count argument %s.\n"
+                "Must be a positive integer.\n",
+                optarg);
+        return 1;
+      }
+      break;
     case 'h':
       usage();
       return 0;
@@ -52,21 +459,68 @@ int main(int argc, char **argv) {
     }
   }
 
-  if (optind == argc - 1) {
-    input_file = argv[optind];
-  } else if (optind < argc - 1) {
-    fprintf(stderr, "Expected only 1 file argument.\n");
+  if (ticks < 0) {
+    fprintf(stderr, "Time must be >= 0.\n");
     usage();
     return 1;
   }
 
-  if (input_file == NULL) {
-    fprintf(stderr, "No input file.\n");
-    usage();
+  if (manifest_path || num_jobs > 0 || optind < argc - 1) {
+    if (print_marks || print_events) {
+      fprintf(stderr, "--marks and --events can't be used in batch mode.\n");
+      return 1;
+    }
+    if (band_threads > 0) {
+      fprintf(stderr, "--bands can't be used in batch mode.\n");
+      return 1;
+    }
+    if (seek_tick >= 0) {
+      fprintf(stderr, "--seek can't be used in batch mode.\n");
+      return 1;
+    }
+    char **paths = NULL;
+    Usz count = 0;
+    for (int i = optind; i < argc; ++i) {
+      paths = realloc(paths, (count + 1) * sizeof(char *));
+      Usz len = strlen(argv[i]);
+      paths[count] = malloc(len + 1);
+      memcpy(paths[count], argv[i], len + 1);
+      ++count;
+    }
+    if (manifest_path && !manifest_read(manifest_path, &paths, &count)) {
+      fprintf(stderr, "Unable to read manifest file %s.\n", manifest_path);
+      return 1;
+    }
+    if (count == 0) {
+      fprintf(stderr, "No input files.\n");
+      return 1;
+    }
+    if (num_jobs == 0) {
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      num_jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    int failures =
+        batch_run((char const *const *)paths, count, (Usz)ticks, (Usz)num_jobs);
+    for (Usz i = 0; i < count; ++i) {
+      free(paths[i]);
+    }
+    free(paths);
+    return failures ? 1 : 0;
+  }
+
+  // Seeking to a checkpoint doesn't run a timestep, so there might not be any
+  // marks to print.
+  if (seek_tick >= 0 && print_marks) {
+    fprintf(stderr, "--seek can't be used with --marks.\n");
     return 1;
   }
-  if (ticks < 0) {
-    fprintf(stderr, "Time must be >= 0.\n");
+
+  if (optind == argc - 1) {
+    input_file = argv[optind];
+  }
+
+  if (input_file == NULL) {
+    fprintf(stderr, "No input file.\n");
     usage();
     return 1;
   }
@@ -84,17 +538,47 @@ int main(int argc, char **argv) {
   mbuf_reusable_ensure_size(&mbuf_r, field.height, field.width);
   Oevent_list oevent_list;
   oevent_list_init(&oevent_list);
+  Live_index live_index;
+  live_index_init(&live_index);
+  Orca_vm vm;
+  orca_vm_init(&vm);
+  Orca_band_pool band_pool;
+  orca_band_pool_init(&band_pool, band_threads > 0 ? (Usz)band_threads : 1);
+  Orca_checkpoints checkpoints;
+  orca_checkpoints_init(&checkpoints, (Usz)checkpoint_interval,
+                        Orca_checkpoint_limit_default);
+  int exit_code = 0;
   Usz max_ticks = (Usz)ticks;
   for (Usz i = 0; i < max_ticks; ++i) {
-    mbuffer_clear(mbuf_r.buffer, field.height, field.width);
+    if (seek_tick >= 0)
+      orca_checkpoints_maybe_save(&checkpoints, &field, &vm, i, 0);
     oevent_list_clear(&oevent_list);
     orca_run(field.buffer, mbuf_r.buffer, field.height, field.width, i,
-             &oevent_list, 0);
+             &oevent_list, 0, &vm, &live_index, &band_pool);
+    if (print_events)
+      oevent_list_fput(&oevent_list, i, stdout);
+  }
+  if (seek_tick >= 0) {
+    Usz tick_num = max_ticks, random_seed = 0;
+    if (!orca_seek(&checkpoints, (Usz)seek_tick, &field, &mbuf_r, &oevent_list,
+                   &vm, &live_index, &band_pool, &tick_num, &random_seed)) {
+      fprintf(stderr, "Unable to seek to timestep %d.\n", seek_tick);
+      exit_code = 1;
+      print_output = false;
+    }
+  }
+  if (print_output && !field_fput(&field, stdout)) {
+    fprintf(stderr, "Error writing the grid to stdout.\n");
+    exit_code = 1;
   }
+  if (print_marks && max_ticks > 0)
+    marks_fput(mbuf_r.buffer, field.height, field.width, stdout);
   mbuf_reusable_deinit(&mbuf_r);
   oevent_list_deinit(&oevent_list);
-  if (print_output)
-    field_fput(&field, stdout);
+  live_index_deinit(&live_index);
+  orca_vm_deinit(&vm);
+  orca_band_pool_deinit(&band_pool);
+  orca_checkpoints_deinit(&checkpoints);
   field_deinit(&field);
-  return 0;
+  return exit_code;
 }
@@ -0,0 +1,636 @@
+#include "base.h"
+#include "field.h"
+#include "player.h"
+#include "sim.h"
+#include "snapshot.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SOKOL_IMPL
+#include "sokol_time.h"
+#undef SOKOL_IMPL
+
+#define staticni ORCA_NOINLINE static
+
+staticni void usage(void) { // clang-format off
+fprintf(stderr,
+"Usage: orcad [options] [file]\n\n"
+"Plays a grid in real time, sending its MIDI and OSC output, with no\n"
+"terminal. It starts playing right away, and is controlled through a\n"
+"UNIX socket, with one command per line:\n"
+"    load <file>           Replace the grid with the one in <file>.\n"
+"    play\n"
+"    stop\n"
+"    bpm <number>          Set the tempo.\n"
+"    poke <x> <y> <glyphs> Write <glyphs> into the grid, from column\n"
+"                          <x> of row <y> rightwards.\n"
+"    stats                 Print the tick, tempo and timing counters.\n"
+"    dest <n> [on|off]     Turn OSC destination <n> on or off, counting\n"
+"                          --osc-dest options from 0, and print its\n"
+"                          address, state and send errors.\n"
+"    quit                  Stop playing and exit.\n"
+"Each command gets one line back, starting with \"ok\" or \"error\".\n"
+"For example: echo 'bpm 140' | socat - UNIX-CONNECT:orcad.sock\n\n"
+"Options:\n"
+"    --socket <path>        Where to make the control socket.\n"
+"                           Default: orcad.sock\n"
+"    --bpm <number>         Set the tempo (beats per minute).\n"
+"                           Default: 120\n"
+"    --seed <number>        Set the seed for the random function.\n"
+"                           Default: 1\n"
+"    --bands <number>       Run each timestep on up to this many\n"
+"                           threads, like orca --bands.\n"
+"                           Default: 1\n"
+"    --initial-size <nxn>   Size of the empty grid to start with, when\n"
+"                           there's no file.\n"
+"                           Default: 57x25\n"
+"    -h or --help           Print this message and exit.\n"
+"\n"
+"OSC/MIDI options:\n"
+"    --strict-timing\n"
+"        Attempt to reduce timing jitter of outgoing MIDI and OSC\n"
+"        messages. Uses more CPU time. May have no effect.\n"
+"\n"
+"    --osc-dest <[host:]port>\n"
+"        Send OSC output to this host and port. The host defaults to\n"
+"        localhost. Can be given more than once, to send everything\n"
+"        to each of them.\n"
+"\n"
+"    --osc-bundles\n"
+"        Send the OSC messages from each step together, in one OSC\n"
+"        bundle timetagged with when the step was due, like orca\n"
+"        --osc-bundles.\n"
+"\n"
+"    --osc-midi-bidule <path>\n"
+"        Set MIDI to be sent via OSC formatted for Plogue Bidule.\n"
+"        The path argument is the path of the Plogue OSC MIDI device.\n"
+"        Example: /OSC_MIDI_0/MIDI\n"
+"\n"
+"    --midi-bclock\n"
+"        Send MIDI beat clock, and start and stop messages.\n"
+#ifdef FEAT_PORTMIDI
+"\n"
+"    --portmidi-output-device <name>\n"
+"        Send MIDI to the PortMidi output device with this name.\n"
+"\n"
+"    --midi-lookahead <number>\n"
+"        Delay PortMidi output by this many milliseconds, like orca\n"
+"        --midi-lookahead.\n"
+"        Default: 1\n"
+#endif
+);} // clang-format on
+
+enum {
+  // The longest the control thread waits for a command at a time. A signal
+  // that lands just before it starts waiting is noticed this late at worst.
+  Daemon_max_wait_ms = 250,
+  Daemon_max_clients = 8,
+  Daemon_line_size = 1024, // Including the newline
+};
+
+typedef struct {
+  int fd;
+  Usz len;
+  char buf[Daemon_line_size];
+} Daemon_client;
+
+typedef struct {
+  Player player;
+  Field scratch_field;
+  int listen_fd;
+  Daemon_client clients[Daemon_max_clients];
+  Usz client_count;
+  bool quit;
+} Daemon;
+
+static volatile sig_atomic_t daemon_got_signal = 0;
+
+static void daemon_signal_handler(int sig) {
+  (void)sig;
+  daemon_got_signal = 1;
+}
+
+static bool read_int(char const *str, int *out) {
+  int a;
+  if (sscanf(str, "%d", &a) != 1)
+    return false;
+  *out = a;
+  return true;
+}
+
+// Makes the listening socket at `path`. A socket file left behind by a
+// daemon that's no longer running is replaced, but not one that's in use.
+staticni int daemon_listen(char const *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof addr.sun_path) {
+    fprintf(stderr, "Socket path is too long: %s\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    perror("socket");
+    return -1;
+  }
+  int rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  if (rc != 0 && errno == EADDRINUSE) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool in_use =
+        connect(probe, (struct sockaddr *)&addr, sizeof addr) == 0 ||
+        errno != ECONNREFUSED;
+    close(probe);
+    if (in_use) {
+      fprintf(stderr, "Socket is already in use: %s\n", path);
+      close(fd);
+      return -1;
+    }
+    unlink(path);
+    rc = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  }
+  if (rc != 0 || listen(fd, Daemon_max_clients) != 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void daemon_client_drop(Daemon *d, Usz i) {
+  close(d->clients[i].fd);
+  d->clients[i] = d->clients[--d->client_count];
+}
+
+// Replies are short, so a client that can't take one in its socket buffer
+// isn't reading them, and is dropped instead of being waited on. Returns false
+// if it was.
+static bool daemon_reply(Daemon *d, Usz i, char const *fmt, ...)
+    ORCA_PRINTF(3, 4);
+static bool daemon_reply(Daemon *d, Usz i, char const *fmt, ...) {
+  char buf[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof buf - 1, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return false;
+  Usz len = (Usz)n < sizeof buf - 1 ? (Usz)n : sizeof buf - 2;
+  buf[len++] = '\n';
+  ssize_t sent = send(d->clients[i].fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (sent != (ssize_t)len) {
+    daemon_client_drop(d, i);
+    return false;
+  }
+  return true;
+}
+
+// Like loading a file in orca, this doesn't restart the tick count, so
+// anything timed off the tick number keeps in step.
+staticni bool daemon_load(Daemon *d, Usz i, char const *path) {
+  Player *pl = &d->player;
+  Field_load_error fle = field_load_file(path, &d->scratch_field);
+  if (fle == Field_load_error_ok &&
+      (d->scratch_field.height < 1 || d->scratch_field.width < 1))
+    return daemon_reply(d, i, "error not a usable file");
+  if (fle != Field_load_error_ok)
+    return daemon_reply(d, i, "error %s", field_load_error_string(fle));
+  field_copy(&d->scratch_field, &pl->field);
+  mbuf_reusable_ensure_size(&pl->mbuf_r, pl->field.height, pl->field.width);
+  live_index_invalidate(&pl->live_index);
+  orca_checkpoints_forget_from(&pl->checkpoints, 0);
+  return daemon_reply(d, i, "ok %dx%d", (int)pl->field.width,
+                      (int)pl->field.height);
+}
+
+staticni bool daemon_poke(Daemon *d, Usz i, char const *args) {
+  Player *pl = &d->player;
+  int x, y, n = 0;
+  if (sscanf(args, "%d %d %n", &x, &y, &n) != 2)
+    return daemon_reply(d, i, "error expected: poke <x> <y> <glyphs>");
+  char const *glyphs = args + n;
+  Usz count = strlen(glyphs);
+  if (count == 0)
+    return daemon_reply(d, i, "error expected: poke <x> <y> <glyphs>");
+  if (x < 0 || y < 0 || (Usz)y >= pl->field.height ||
+      (Usz)x + count > pl->field.width)
+    return daemon_reply(d, i, "error outside the %dx%d grid",
+                        (int)pl->field.width, (int)pl->field.height);
+  for (Usz j = 0; j < count; ++j) {
+    if (!orca_is_valid_glyph((Glyph)glyphs[j]))
+      return daemon_reply(d, i, "error not a glyph: %c", glyphs[j]);
+  }
+  memcpy(pl->field.buffer + (Usz)y * pl->field.width + (Usz)x, glyphs, count);
+  live_index_update_rect(&pl->live_index, pl->field.buffer, pl->field.height,
+                         pl->field.width, (Usz)y, (Usz)x, 1, count);
+  orca_checkpoints_forget_from(&pl->checkpoints, pl->tick_num);
+  return daemon_reply(d, i, "ok");
+}
+
+staticni bool daemon_stats(Daemon *d, Usz i) {
+  Player *pl = &d->player;
+  Player_output_stats out = player_output_stats(pl);
+  Player_clock_stats const *clk = &pl->clock.stats;
+  U64 sent = out.sent ? out.sent : 1;
+  U64 deadlines = clk->deadlines ? clk->deadlines : 1;
+  return daemon_reply(
+      d, i,
+      "ok tick %zu bpm %zu playing %d grid %dx%d events %zu sent %llu "
+      "dropped %llu latency_us %llu latency_max_us %llu late_us %llu "
+      "late_max_us %llu resyncs %llu udp_errors %llu",
+      pl->tick_num, pl->bpm, (int)pl->is_playing, (int)pl->field.width,
+      (int)pl->field.height, pl->activity_counter,
+      (unsigned long long)out.sent, (unsigned long long)out.overflows,
+      (unsigned long long)(out.latency_sum_ns / sent / 1000),
+      (unsigned long long)(out.latency_max_ns / 1000),
+      (unsigned long long)(clk->late_sum_ns / deadlines / 1000),
+      (unsigned long long)(clk->late_max_ns / 1000),
+      (unsigned long long)clk->resyncs,
+      (unsigned long long)out.udp_send_errors);
+}
+
+staticni bool daemon_dest(Daemon *d, Usz i, char const *args) {
+  Oosc_dev *oosc_dev = d->player.oosc_dev;
+  int index, n = 0;
+  if (sscanf(args, "%d %n", &index, &n) != 1)
+    return daemon_reply(d, i, "error expected: dest <n> [on|off]");
+  if (!oosc_dev || index < 0 || (Usz)index >= oosc_dev_dest_count(oosc_dev))
+    return daemon_reply(d, i, "error no OSC destination %d", index);
+  Usz dest = (Usz)index;
+  char const *state = args + n;
+  if (strcmp(state, "on") == 0 || strcmp(state, "off") == 0)
+    oosc_dev_set_dest_enabled(oosc_dev, dest, state[1] == 'n');
+  else if (*state)
+    return daemon_reply(d, i, "error expected: dest <n> [on|off]");
+  return daemon_reply(
+      d, i, "ok %s %s send_errors %llu", oosc_dev_dest_name(oosc_dev, dest),
+      oosc_dev_dest_is_enabled(oosc_dev, dest) ? "on" : "off",
+      (unsigned long long)oosc_dev_dest_send_errors(oosc_dev, dest));
+}
+
+// Runs one command line, with the player lock held. Returns false if the
+// client was dropped.
+staticni bool daemon_command(Daemon *d, Usz i, char *line) {
+  Player *pl = &d->player;
+  char *args = line;
+  while (*args && *args != ' ')
+    ++args;
+  if (*args)
+    *args++ = '\0';
+  if (strcmp(line, "load") == 0)
+    return daemon_load(d, i, args);
+  if (strcmp(line, "play") == 0) {
+    player_set_playing(pl, true);
+    return daemon_reply(d, i, "ok");
+  }
+  if (strcmp(line, "stop") == 0) {
+    player_set_playing(pl, false);
+    return daemon_reply(d, i, "ok");
+  }
+  if (strcmp(line, "bpm") == 0) {
+    int bpm;
+    if (!read_int(args, &bpm) || bpm < 1)
+      return daemon_reply(d, i, "error must be a positive integer");
+    if ((Usz)bpm != pl->bpm) {
+      pl->bpm = (Usz)bpm;
+      player_send_osc_bpm(pl, (I32)bpm);
+    }
+    return daemon_reply(d, i, "ok");
+  }
+  if (strcmp(line, "poke") == 0)
+    return daemon_poke(d, i, args);
+  if (strcmp(line, "stats") == 0)
+    return daemon_stats(d, i);
+  if (strcmp(line, "dest") == 0)
+    return daemon_dest(d, i, args);
+  if (strcmp(line, "quit") == 0) {
+    d->quit = true;
+    return daemon_reply(d, i, "ok");
+  }
+  if (!*line)
+    return true;
+  return daemon_reply(d, i, "error unknown command: %s", line);
+}
+
+// Reads what the client has sent, and runs each whole line of it.
+staticni void daemon_client_read(Daemon *d, Usz i) {
+  Daemon_client *c = d->clients + i;
+  ssize_t n = read(c->fd, c->buf + c->len, sizeof c->buf - c->len);
+  if (n <= 0) {
+    if (n == 0 || (errno != EAGAIN && errno != EINTR))
+      daemon_client_drop(d, i);
+    return;
+  }
+  c->len += (Usz)n;
+  Usz start = 0;
+  for (Usz j = start; j < c->len; ++j) {
+    if (c->buf[j] != '\n')
+      continue;
+    c->buf[j] = '\0';
+    if (j > start && c->buf[j - 1] == '\r')
+      c->buf[j - 1] = '\0';
+    if (!daemon_command(d, i, c->buf + start))
+      return;
+    start = j + 1;
+  }
+  if (start == 0 && c->len == sizeof c->buf) {
+    if (daemon_reply(d, i, "error line too long"))
+      daemon_client_drop(d, i);
+    return;
+  }
+  memmove(c->buf, c->buf + start, c->len - start);
+  c->len -= start;
+}
+
+staticni void daemon_accept(Daemon *d) {
+  for (;;) {
+    int fd = accept(d->listen_fd, NULL, NULL);
+    if (fd == -1)
+      return;
+    if (d->client_count == Daemon_max_clients) {
+      close(fd);
+      continue;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Daemon_client *c = d->clients + d->client_count++;
+    c->fd = fd;
+    c->len = 0;
+  }
+}
+
+// Waits, without the lock, for a connection or a command, or for `timeout_ms`
+// to pass, then deals with whatever came in.
+staticni void daemon_wait_and_serve(Daemon *d, int timeout_ms) {
+  struct pollfd fds[Daemon_max_clients + 1];
+  Usz count = d->client_count;
+  fds[0] = (struct pollfd){d->listen_fd, POLLIN, 0};
+  for (Usz i = 0; i < count; ++i) {
+    fds[i + 1] = (struct pollfd){d->clients[i].fd, POLLIN, 0};
+  }
+  player_unlock(&d->player);
+  int ready = poll(fds, count + 1, timeout_ms);
+  player_lock(&d->player);
+  if (ready <= 0)
+    return;
+  // Backwards, since dropping a client moves the last one into its place.
+  for (Usz i = count; i-- > 0;) {
+    if (fds[i + 1].revents && !d->quit)
+      daemon_client_read(d, i);
+  }
+  if (fds[0].revents)
+    daemon_accept(d);
+}
+
+enum {
+  Argopt_socket = UCHAR_MAX + 1,
+  Argopt_bpm,
+  Argopt_seed,
+  Argopt_bands,
+  Argopt_init_grid_size,
+  Argopt_strict_timing,
+  Argopt_osc_dest,
+  Argopt_osc_bundles,
+  Argopt_osc_midi_bidule,
+  Argopt_midi_bclock,
+#ifdef FEAT_PORTMIDI
+  Argopt_portmidi_output_device,
+  Argopt_midi_lookahead,
+#endif
+};
+
+int main(int argc, char **argv) {
+  static struct option daemon_options[] = {
+      {"help", no_argument, 0, 'h'},
+      {"socket", required_argument, 0, Argopt_socket},
+      {"bpm", required_argument, 0, Argopt_bpm},
+      {"seed", required_argument, 0, Argopt_seed},
+      {"bands", required_argument, 0, Argopt_bands},
+      {"initial-size", required_argument, 0, Argopt_init_grid_size},
+      {"strict-timing", no_argument, 0, Argopt_strict_timing},
+      {"osc-dest", required_argument, 0, Argopt_osc_dest},
+      {"osc-bundles", no_argument, 0, Argopt_osc_bundles},
+      {"osc-midi-bidule", required_argument, 0, Argopt_osc_midi_bidule},
+      {"midi-bclock", no_argument, 0, Argopt_midi_bclock},
+#ifdef FEAT_PORTMIDI
+      {"portmidi-output-device", required_argument, 0,
+       Argopt_portmidi_output_device},
+      {"midi-lookahead", required_argument, 0, Argopt_midi_lookahead},
+#endif
+      {NULL, 0, NULL, 0}};
+  char const *socket_path = "orcad.sock";
+  int init_bpm = 120;
+  int init_seed = 1;
+  int band_threads = 1;
+  int init_grid_dim_y = 25, init_grid_dim_x = 57;
+  bool strict_timing = false;
+  char const **osc_dests = NULL;
+  Usz osc_dest_count = 0;
+  bool osc_bundles = false;
+  char const *osc_midi_bidule_path = NULL;
+  bool midi_bclock = false;
+#ifdef FEAT_PORTMIDI
+  char const *portmidi_output_device = NULL;
+  int midi_lookahead_ms = 1;
+#endif
+
+  int longindex = 0;
+  for (;;) {
+    int c = getopt_long(argc, argv, "h", daemon_options, &longindex);
+    if (c == -1)
+      break;
+    switch (c) {
+    case 'h':
+      usage();
+      exit(0);
+    case '?':
+      usage();
+      exit(1);
+#define OPTFAIL(...)                                                           \
+  {                                                                            \
+    fprintf(stderr, "Bad %s argument: %s\n", daemon_options[longindex].name,   \
+            optarg);                                                           \
+    fprintf(stderr, __VA_ARGS__);                                              \
+    fputc('\n', stderr);                                                       \
+    exit(1);                                                                   \
+  }
+    case Argopt_socket:
+      socket_path = optarg;
+      break;
+    case Argopt_bpm:
+      if (read_int(optarg, &init_bpm) && init_bpm >= 1)
+        break;
+      OPTFAIL("Must be positive integer.");
+    case Argopt_seed:
+      if (read_int(optarg, &init_seed) && init_seed >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_bands:
+      if (read_int(optarg, &band_threads) && band_threads >= 1)
+        break;
+      OPTFAIL("Must be positive integer.");
+    case Argopt_init_grid_size:
+      if (sscanf(optarg, "%dx%d", &init_grid_dim_x, &init_grid_dim_y) != 2)
+        OPTFAIL("Bad format or count. Expected something like: 40x30");
+      if (init_grid_dim_x <= 0 || init_grid_dim_x > ORCA_X_MAX)
+        OPTFAIL("X dimension for initial-size must be 1 <= n <= %d, was %d.",
+                ORCA_X_MAX, init_grid_dim_x);
+      if (init_grid_dim_y <= 0 || init_grid_dim_y > ORCA_Y_MAX)
+        OPTFAIL("Y dimension for initial-size must be 1 <= n <= %d, was %d.",
+                ORCA_Y_MAX, init_grid_dim_y);
+      break;
+    case Argopt_strict_timing:
+      strict_timing = true;
+      break;
+    case Argopt_osc_dest: {
+      char host[256];
+      char const *port;
+      if (!split_udp_dest(optarg, host, sizeof host, &port))
+        OPTFAIL("Expected a port, or something like: 192.168.1.2:49162");
+      osc_dests =
+          realloc(osc_dests, (osc_dest_count + 1) * sizeof(char const *));
+      osc_dests[osc_dest_count++] = optarg;
+      break;
+    }
+    case Argopt_osc_bundles:
+      osc_bundles = true;
+      break;
+    case Argopt_osc_midi_bidule:
+      osc_midi_bidule_path = optarg;
+      break;
+    case Argopt_midi_bclock:
+      midi_bclock = true;
+      break;
+#ifdef FEAT_PORTMIDI
+    case Argopt_portmidi_output_device:
+      portmidi_output_device = optarg;
+      break;
+    case Argopt_midi_lookahead:
+      if (read_int(optarg, &midi_lookahead_ms) && midi_lookahead_ms >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
+#endif
+    }
+  }
+#undef OPTFAIL
+  char const *file_name = NULL;
+  if (optind == argc - 1) {
+    file_name = argv[optind];
+  } else if (optind < argc - 1) {
+    fprintf(stderr, "Expected only 1 file argument.\n");
+    exit(1);
+  }
+
+  Daemon d;
+  d.client_count = 0;
+  d.quit = false;
+  field_init(&d.scratch_field);
+  Player *pl = &d.player;
+  if (file_name) {
+    Field_load_error fle = field_load_file(file_name, &d.scratch_field);
+    if (fle != Field_load_error_ok) {
+      fprintf(stderr, "File load error: %s\n", field_load_error_string(fle));
+      exit(1);
+    }
+    if (d.scratch_field.height < 1 || d.scratch_field.width < 1) {
+      fprintf(stderr, "Not a usable file: %s\n", file_name);
+      exit(1);
+    }
+  }
+  d.listen_fd = daemon_listen(socket_path);
+  if (d.listen_fd == -1)
+    exit(1);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = daemon_signal_handler;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  stm_setup(); // Set up timer lib
+  player_init(pl, (Usz)init_bpm, (Usz)init_seed, (Usz)band_threads,
+              strict_timing);
+  pl->output.osc_bundles = osc_bundles;
+  pl->midi_bclock = midi_bclock;
+  // Held from here on, except while waiting for commands, so that the clock
+  // thread only runs ticks in between them.
+  player_lock(pl);
+  int exit_code = 0;
+  if (file_name)
+    field_copy(&d.scratch_field, &pl->field);
+  else
+    field_init_fill(&pl->field, (Usz)init_grid_dim_y, (Usz)init_grid_dim_x,
+                    '.');
+  mbuf_reusable_ensure_size(&pl->mbuf_r, pl->field.height, pl->field.width);
+  for (Usz i = 0; i < osc_dest_count; ++i) {
+    char host[256];
+    char const *port;
+    split_udp_dest(osc_dests[i], host, sizeof host, &port);
+    bool ok = i == 0 ? player_set_osc_udp(pl, host[0] ? host : NULL, port)
+                     : player_add_osc_udp_dest(pl, osc_dests[i]);
+    if (!ok) {
+      fprintf(stderr, "Couldn't set up OSC output to %s\n", osc_dests[i]);
+      exit_code = 1;
+      goto quit;
+    }
+  }
+  if (osc_midi_bidule_path) {
+    player_output_lock(pl);
+    midi_mode_deinit(&pl->midi_mode);
+    midi_mode_init_osc_bidule(&pl->midi_mode, osc_midi_bidule_path);
+    player_output_unlock(pl);
+  }
+#ifdef FEAT_PORTMIDI
+  if (portmidi_output_device) {
+    PmError pmerr;
+    PmDeviceID devid;
+    if (!portmidi_find_device_id_by_name(portmidi_output_device,
+                                         strlen(portmidi_output_device),
+                                         &pmerr, &devid)) {
+      fprintf(stderr, "PortMidi output device not found: %s\n",
+              portmidi_output_device);
+      exit_code = 1;
+      goto quit;
+    }
+    player_output_lock(pl);
+    midi_mode_deinit(&pl->midi_mode);
+    pmerr = midi_mode_init_portmidi(&pl->midi_mode, devid, midi_lookahead_ms);
+    player_output_unlock(pl);
+    if (pmerr) {
+      fprintf(stderr, "PortMidi error: %s\n", Pm_GetErrorText(pmerr));
+      exit_code = 1;
+      goto quit;
+    }
+  }
+#endif
+  player_send_osc_bpm(pl, (I32)pl->bpm); // Send initial BPM
+  player_set_playing(pl, true);          // Auto-play
+  while (!d.quit && !daemon_got_signal) {
+    daemon_wait_and_serve(
+        &d, player_clock_timeout_ms(pl, Daemon_max_wait_ms));
+  }
+quit:
+  player_set_playing(pl, false);
+  player_unlock(pl);
+  for (Usz i = 0; i < d.client_count; ++i) {
+    close(d.clients[i].fd);
+  }
+  close(d.listen_fd);
+  unlink(socket_path);
+  player_deinit(pl);
+  field_deinit(&d.scratch_field);
+  free(osc_dests);
+#ifdef FEAT_PORTMIDI
+  portmidi_deinit_if_necessary();
+#endif
+  return exit_code;
+}
+
+#undef staticni
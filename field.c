@@ -1,6 +1,9 @@
 #include "field.h"
 #include "gbuffer.h"
-#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void field_init(Field *f) {
   f->buffer = NULL;
@@ -42,78 +45,195 @@ void field_copy(Field *src, Field *dest) {
 
 static inline bool glyph_char_is_valid(char c) { return c >= '!' && c <= '~'; }
 
-void field_fput(Field *f, FILE *stream) {
-  enum { Column_buffer_count = 4096 };
-  char out_buffer[Column_buffer_count];
+static bool fd_write_all(int fd, char const *data, Usz size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= (Usz)written;
+  }
+  return true;
+}
+
+bool field_fput(Field const *f, FILE *stream) {
+  // Rows are put together in a buffer of up to about this many bytes, and
+  // written straight to the file descriptor, past stdio, a buffer at a time.
+  enum { Chunk_target_size = 1 << 20 };
   Usz f_height = f->height;
   Usz f_width = f->width;
-  Glyph *f_buffer = f->buffer;
-  if (f_width > Column_buffer_count - 2)
-    return;
-  for (Usz iy = 0; iy < f_height; ++iy) {
-    Glyph *row_p = f_buffer + f_width * iy;
-    for (Usz ix = 0; ix < f_width; ++ix) {
-      char c = row_p[ix];
-      out_buffer[ix] = glyph_char_is_valid(c) ? c : '?';
+  Glyph const *f_buffer = f->buffer;
+  // Anything already written through `stream` has to come out first.
+  if (fflush(stream) != 0)
+    return false;
+  int fd = fileno(stream);
+  if (fd < 0 || f_height == 0)
+    return fd >= 0;
+  Usz line_size = f_width + 1;
+  Usz chunk_rows = Chunk_target_size / line_size;
+  if (chunk_rows == 0)
+    chunk_rows = 1;
+  if (chunk_rows > f_height)
+    chunk_rows = f_height;
+  char *out_buffer = malloc(chunk_rows * line_size);
+  if (!out_buffer)
+    return false;
+  bool ok = true;
+  for (Usz iy = 0; ok && iy < f_height; iy += chunk_rows) {
+    Usz rows = f_height - iy < chunk_rows ? f_height - iy : chunk_rows;
+    char *out = out_buffer;
+    for (Usz i = 0; i < rows; ++i) {
+      Glyph const *row_p = f_buffer + f_width * (iy + i);
+      for (Usz ix = 0; ix < f_width; ++ix) {
+        char c = row_p[ix];
+        out[ix] = glyph_char_is_valid(c) ? c : '?';
+      }
+      out[f_width] = '\n';
+      out += line_size;
     }
-    out_buffer[f_width] = '\n';
-    out_buffer[f_width + 1] = '\0';
-    fputs(out_buffer, stream);
+    ok = fd_write_all(fd, out_buffer, rows * line_size);
   }
+  free(out_buffer);
+  return ok;
 }
 
-Field_load_error field_load_file(char const *filepath, Field *field) {
-  FILE *file = fopen(filepath, "r");
-  if (file == NULL) {
-    return Field_load_error_cant_open_file;
+// The whole file, mapped if it can be, or read into memory if not (like for a
+// pipe).
+typedef struct {
+  char *data;
+  Usz size;
+  bool is_mapped;
+} Field_file_contents;
+
+static bool field_file_contents_load(int fd, Field_file_contents *out) {
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return false;
+  if (S_ISREG(st.st_mode)) {
+    out->size = (Usz)st.st_size;
+    out->is_mapped = true;
+    if (out->size == 0) {
+      out->data = NULL;
+      return true;
+    }
+    void *mapped = mmap(NULL, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      out->data = mapped;
+      return true;
+    }
   }
-  enum { Bufsize = 4096 };
-  char buf[Bufsize];
-  Usz first_row_columns = 0;
-  Usz rows = 0;
+  out->is_mapped = false;
+  out->data = NULL;
+  out->size = 0;
+  Usz capacity = 0;
   for (;;) {
-    char *s = fgets(buf, Bufsize, file);
-    if (s == NULL)
-      break;
-    if (rows == ORCA_Y_MAX) {
-      fclose(file);
-      return Field_load_error_too_many_rows;
+    if (capacity - out->size < 4096) {
+      capacity = capacity < 65536 ? 65536 : capacity * 2;
+      char *data = realloc(out->data, capacity);
+      if (!data) {
+        free(out->data);
+        return false;
+      }
+      out->data = data;
     }
-    Usz len = strlen(buf);
-    if (len == Bufsize - 1 && buf[len - 1] != '\n' && !feof(file)) {
-      fclose(file);
-      return Field_load_error_too_many_columns;
+    ssize_t got = read(fd, out->data + out->size, capacity - out->size);
+    if (got == 0)
+      return true;
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      free(out->data);
+      return false;
     }
-    for (;;) {
-      if (len == 0)
-        break;
-      if (!isspace(buf[len - 1]))
-        break;
-      --len;
+    out->size += (Usz)got;
+  }
+}
+
+static void field_file_contents_free(Field_file_contents *fc) {
+  if (!fc->is_mapped)
+    free(fc->data);
+  else if (fc->size)
+    munmap(fc->data, fc->size);
+}
+
+static inline bool char_is_space(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// The length of a line, up to (not including) `end`, once trailing
+// whitespace is taken off. Like reading it with fgets() would, this stops at
+// a null byte.
+static Usz field_line_len(char const *line, char const *end) {
+  char const *nul = memchr(line, '\0', (Usz)(end - line));
+  if (nul)
+    end = nul;
+  while (end != line && char_is_space(end[-1]))
+    --end;
+  return (Usz)(end - line);
+}
+
+// Lines with nothing but whitespace on them are skipped. The file is gone
+// through twice: once to find the size of the grid and check that it's a
+// rectangle, and once to copy it into the field, which is only resized if the
+// file is OK.
+Field_load_error field_load_file(char const *filepath, Field *field) {
+  int fd = open(filepath, O_RDONLY);
+  if (fd < 0)
+    return Field_load_error_cant_open_file;
+  Field_file_contents fc;
+  bool did_load = field_file_contents_load(fd, &fc);
+  close(fd);
+  if (!did_load)
+    return Field_load_error_cant_open_file;
+  Field_load_error err = Field_load_error_ok;
+  char const *begin = fc.data, *end = fc.data + fc.size;
+  Usz rows = 0, columns = 0;
+  for (char const *line = begin; line != end;) {
+    char const *eol = memchr(line, '\n', (Usz)(end - line));
+    char const *next = eol ? eol + 1 : end;
+    if (rows == ORCA_Y_MAX) {
+      err = Field_load_error_too_many_rows;
+      goto done;
     }
+    Usz len = field_line_len(line, eol ? eol : end);
+    line = next;
     if (len == 0)
       continue;
     if (len >= ORCA_X_MAX) {
-      fclose(file);
-      return Field_load_error_too_many_columns;
+      err = Field_load_error_too_many_columns;
+      goto done;
     }
-    // quick hack until we use a proper scanner
     if (rows == 0) {
-      first_row_columns = len;
-    } else if (len != first_row_columns) {
-      fclose(file);
-      return Field_load_error_not_a_rectangle;
-    }
-    field_resize_raw(field, rows + 1, first_row_columns);
-    Glyph *rowbuff = field->buffer + first_row_columns * rows;
-    for (Usz i = 0; i < len; ++i) {
-      char c = buf[i];
-      rowbuff[i] = glyph_char_is_valid(c) ? c : '.';
+      columns = len;
+    } else if (len != columns) {
+      err = Field_load_error_not_a_rectangle;
+      goto done;
     }
     ++rows;
   }
-  fclose(file);
-  return Field_load_error_ok;
+  if (rows == 0)
+    goto done;
+  field_resize_raw(field, rows, columns);
+  Glyph *rowbuff = field->buffer;
+  for (char const *line = begin; line != end;) {
+    char const *eol = memchr(line, '\n', (Usz)(end - line));
+    char const *next = eol ? eol + 1 : end;
+    Usz len = field_line_len(line, eol ? eol : end);
+    if (len != 0) {
+      for (Usz i = 0; i < len; ++i) {
+        char c = line[i];
+        rowbuff[i] = glyph_char_is_valid(c) ? c : '.';
+      }
+      rowbuff += columns;
+    }
+    line = next;
+  }
+done:
+  field_file_contents_free(&fc);
+  return err;
 }
 
 char const *field_load_error_string(Field_load_error fle) {
@@ -17,7 +17,10 @@ void field_deinit(Field *field);
 void field_resize_raw(Field *field, Usz height, Usz width);
 void field_resize_raw_if_necessary(Field *field, Usz height, Usz width);
 void field_copy(Field *src, Field *dest);
-void field_fput(Field *field, FILE *stream);
+// Writes the grid as text, a line per row, with anything that isn't a valid
+// glyph written as '?'. Goes to the file descriptor of `stream`, after
+// flushing it. Returns false if it couldn't all be written.
+bool field_fput(Field const *field, FILE *stream);
 
 typedef enum {
   Field_load_error_ok = 0,
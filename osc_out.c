@@ -1,3 +1,6 @@
+#if defined(__linux__)
+#define _GNU_SOURCE // For sendmmsg()
+#endif
 #include "osc_out.h"
 #include <arpa/inet.h>
 #include <errno.h>
@@ -7,17 +10,62 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
-struct Oosc_dev {
+enum {
+  Oosc_message_max_size = 2048,
+  Oosc_int32s_max = 255, // More than that wouldn't fit in a message anyway
+  // The OSC message and bundle element headers
+  Oosc_bundle_header_size = 16,
+  Oosc_bundle_element_header_size = 4,
+  // Room for the largest message on its own, which goes out in a datagram by
+  // itself even if it's bigger than Oosc_bundle_max_size.
+  Oosc_bundle_buffer_size = Oosc_bundle_header_size +
+                            Oosc_bundle_element_header_size +
+                            Oosc_message_max_size,
+  // Datagrams handed to each sendmmsg() call when the queue is flushed
+  Oosc_tx_batch_count = 64,
+  // Room for "[IPv6 address]:port"
+  Oosc_dest_name_size = 64,
+};
+
+typedef struct {
+  Usz offset, size; // In `tx_data`
+} Oosc_tx_item;
+
+typedef struct {
   int fd;
   // Just keep the whole list around, since juggling the strict-aliasing
   // problems with sockaddr_storage is not worth it.
   struct addrinfo *chosen;
   struct addrinfo *head;
+  // Set and read atomically, since other threads look at them while the
+  // output thread sends.
+  bool enabled;
+  U64 send_errors;
+  char name[Oosc_dest_name_size];
+} Oosc_dest;
+
+struct Oosc_dev {
+  // Everything sent goes to each enabled one of these, encoded only once.
+  Oosc_dest *dests;
+  Usz dest_count;
+  // Between oosc_bundle_begin() and oosc_bundle_end(). `bundle_size` includes
+  // the header, which is already written.
+  bool is_bundling;
+  Usz bundle_size;
+  char bundle[Oosc_bundle_buffer_size];
+  // Between oosc_queue_begin() and oosc_queue_end(), datagrams are copied
+  // into `tx_data` instead of being sent.
+  bool is_queueing;
+  Oosc_tx_item *tx_items;
+  Usz tx_count, tx_capacity;
+  char *tx_data;
+  Usz tx_data_size, tx_data_capacity;
+  Oosc_tx_stats tx_stats;
 };
 
-Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr,
-                                          char const *dest_addr,
-                                          char const *dest_port) {
+static Oosc_udp_create_error oosc_dest_open(Oosc_dest *dest,
+                                            char const *dest_addr,
+                                            char const *dest_port) {
   struct addrinfo hints = {0};
   hints.ai_family = AF_UNSPEC;
   hints.ai_socktype = SOCK_DGRAM;
@@ -80,33 +128,205 @@ Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr,
     freeaddrinfo(head);
     return Oosc_udp_create_error_couldnt_open_socket;
   }
+  dest->fd = udpfd;
+  dest->chosen = chosen;
+  dest->head = head;
+  dest->enabled = true;
+  dest->send_errors = 0;
+  char host[INET6_ADDRSTRLEN], port[8];
+  if (getnameinfo(chosen->ai_addr, chosen->ai_addrlen, host, sizeof host, port,
+                  sizeof port, NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+    snprintf(dest->name, sizeof dest->name, "?");
+  else if (chosen->ai_family == AF_INET6)
+    snprintf(dest->name, sizeof dest->name, "[%s]:%s", host, port);
+  else
+    snprintf(dest->name, sizeof dest->name, "%s:%s", host, port);
+  return Oosc_udp_create_error_ok;
+}
+
+Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr,
+                                          char const *dest_addr,
+                                          char const *dest_port) {
+  Oosc_dest dest;
+  Oosc_udp_create_error err = oosc_dest_open(&dest, dest_addr, dest_port);
+  if (err)
+    return err;
   Oosc_dev *dev = malloc(sizeof(Oosc_dev));
-  dev->fd = udpfd;
-  dev->chosen = chosen;
-  dev->head = head;
+  dev->dests = malloc(sizeof(Oosc_dest));
+  dev->dests[0] = dest;
+  dev->dest_count = 1;
+  dev->is_bundling = false;
+  dev->bundle_size = 0;
+  dev->is_queueing = false;
+  dev->tx_items = NULL;
+  dev->tx_count = dev->tx_capacity = 0;
+  dev->tx_data = NULL;
+  dev->tx_data_size = dev->tx_data_capacity = 0;
+  memset(&dev->tx_stats, 0, sizeof dev->tx_stats);
   *out_ptr = dev;
   return Oosc_udp_create_error_ok;
 }
 
+Oosc_udp_create_error oosc_dev_add_udp_dest(Oosc_dev *dev,
+                                            char const *dest_addr,
+                                            char const *dest_port) {
+  Oosc_dest dest;
+  Oosc_udp_create_error err = oosc_dest_open(&dest, dest_addr, dest_port);
+  if (err)
+    return err;
+  Usz count = dev->dest_count;
+  dev->dests = realloc(dev->dests, (count + 1) * sizeof(Oosc_dest));
+  dev->dests[count] = dest;
+  dev->dest_count = count + 1;
+  return Oosc_udp_create_error_ok;
+}
+
+Usz oosc_dev_dest_count(Oosc_dev const *dev) { return dev->dest_count; }
+
+char const *oosc_dev_dest_name(Oosc_dev const *dev, Usz index) {
+  return dev->dests[index].name;
+}
+
+void oosc_dev_set_dest_enabled(Oosc_dev *dev, Usz index, bool enabled) {
+  __atomic_store_n(&dev->dests[index].enabled, enabled, __ATOMIC_RELAXED);
+}
+
+bool oosc_dev_dest_is_enabled(Oosc_dev const *dev, Usz index) {
+  return __atomic_load_n(&dev->dests[index].enabled, __ATOMIC_RELAXED);
+}
+
+U64 oosc_dev_dest_send_errors(Oosc_dev const *dev, Usz index) {
+  return __atomic_load_n(&dev->dests[index].send_errors, __ATOMIC_RELAXED);
+}
+
+// Only the thread sending with the device counts errors, so this doesn't have
+// to be an atomic read-modify-write.
+static void oosc_dest_count_error(Oosc_dev *dev, Oosc_dest *dest) {
+  __atomic_store_n(&dest->send_errors, dest->send_errors + 1,
+                   __ATOMIC_RELAXED);
+  ++dev->tx_stats.dropped;
+}
+
 void oosc_dev_destroy(Oosc_dev *dev) {
-  close(dev->fd);
-  freeaddrinfo(dev->head);
+  for (Usz i = 0; i < dev->dest_count; ++i) {
+    close(dev->dests[i].fd);
+    freeaddrinfo(dev->dests[i].head);
+  }
+  free(dev->dests);
+  free(dev->tx_items);
+  free(dev->tx_data);
   free(dev);
 }
 
-void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size) {
-  ssize_t res = sendto(dev->fd, data, size, 0, dev->chosen->ai_addr,
-                       dev->chosen->ai_addrlen);
-  (void)res;
-  // TODO handle this in UI somehow
-#if 0
+static void oosc_queue_push(Oosc_dev *dev, char const *data, Usz size) {
+  Usz count = dev->tx_count;
+  if (count == dev->tx_capacity) {
+    Usz cap = count < 16 ? 16 : orca_round_up_power2(count + 1);
+    dev->tx_items = realloc(dev->tx_items, cap * sizeof(Oosc_tx_item));
+    dev->tx_capacity = cap;
+  }
+  Usz offset = dev->tx_data_size;
+  if (dev->tx_data_capacity - offset < size) {
+    Usz cap = orca_round_up_power2(offset + size);
+    if (cap < 4096)
+      cap = 4096;
+    dev->tx_data = realloc(dev->tx_data, cap);
+    dev->tx_data_capacity = cap;
+  }
+  memcpy(dev->tx_data + offset, data, size);
+  dev->tx_items[count] = (Oosc_tx_item){.offset = offset, .size = size};
+  dev->tx_count = count + 1;
+  dev->tx_data_size = offset + size;
+}
+
+static void oosc_dest_send(Oosc_dev *dev, Oosc_dest *dest, char const *data,
+                           Usz size) {
+  ssize_t res = sendto(dest->fd, data, size, 0, dest->chosen->ai_addr,
+                       dest->chosen->ai_addrlen);
   if (res < 0) {
-    fprintf(stderr, "UDP message send failed\n");
-    exit(1);
+    oosc_dest_count_error(dev, dest);
+  }
+}
+
+// Sends the queued datagrams from `first` on to `dest`, and returns how many
+// of them were sent (or given up on) by one system call.
+static Usz oosc_queue_send_some(Oosc_dev *dev, Oosc_dest *dest, Usz first) {
+  Usz count = dev->tx_count - first;
+#if defined(__linux__)
+  if (count > Oosc_tx_batch_count)
+    count = Oosc_tx_batch_count;
+  struct mmsghdr msgs[Oosc_tx_batch_count];
+  struct iovec iovs[Oosc_tx_batch_count];
+  memset(msgs, 0, count * sizeof(struct mmsghdr));
+  for (Usz i = 0; i < count; ++i) {
+    Oosc_tx_item const *item = dev->tx_items + first + i;
+    iovs[i].iov_base = dev->tx_data + item->offset;
+    iovs[i].iov_len = item->size;
+    msgs[i].msg_hdr.msg_name = dest->chosen->ai_addr;
+    msgs[i].msg_hdr.msg_namelen = dest->chosen->ai_addrlen;
+    msgs[i].msg_hdr.msg_iov = iovs + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
   }
+  int res;
+  do {
+    res = sendmmsg(dest->fd, msgs, (unsigned)count, 0);
+  } while (res < 0 && errno == EINTR);
+  if (res < 0) {
+    // Only the first one failed. Skip it, the same as if it had been sent
+    // by itself, and try the rest.
+    oosc_dest_count_error(dev, dest);
+    return 1;
+  }
+  if ((Usz)res < count)
+    ++dev->tx_stats.partial_sends;
+  return (Usz)res;
+#else
+  // No sendmmsg(), so it's still one call per datagram, but at least they
+  // all go out together.
+  Oosc_tx_item const *item = dev->tx_items + first;
+  oosc_dest_send(dev, dest, dev->tx_data + item->offset, item->size);
+  (void)count;
+  return 1;
 #endif
 }
 
+void oosc_queue_begin(Oosc_dev *dev) { dev->is_queueing = true; }
+
+void oosc_queue_end(Oosc_dev *dev) {
+  dev->is_queueing = false;
+  Usz count = dev->tx_count;
+  if (count == 0)
+    return;
+  Oosc_tx_stats *st = &dev->tx_stats;
+  ++st->flushes;
+  st->datagrams += count;
+  st->depth_last = count;
+  if (count > st->depth_max)
+    st->depth_max = count;
+  for (Usz i = 0; i < dev->dest_count; ++i) {
+    Oosc_dest *dest = dev->dests + i;
+    if (!oosc_dev_dest_is_enabled(dev, i))
+      continue;
+    for (Usz sent = 0; sent < count;)
+      sent += oosc_queue_send_some(dev, dest, sent);
+  }
+  dev->tx_count = 0;
+  dev->tx_data_size = 0;
+}
+
+Oosc_tx_stats oosc_dev_tx_stats(Oosc_dev const *dev) { return dev->tx_stats; }
+
+void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size) {
+  if (dev->is_queueing) {
+    oosc_queue_push(dev, data, size);
+    return;
+  }
+  for (Usz i = 0; i < dev->dest_count; ++i) {
+    if (oosc_dev_dest_is_enabled(dev, i))
+      oosc_dest_send(dev, dev->dests + i, data, size);
+  }
+}
+
 static bool oosc_write_strn(char *restrict buffer, Usz buffer_size,
                             Usz *buffer_pos, char const *restrict in_str,
                             Usz in_str_len) {
@@ -129,28 +349,66 @@ static bool oosc_write_strn(char *restrict buffer, Usz buffer_size,
   return true;
 }
 
+static void oosc_write_u32(char *dest, U32 val) {
+  U32 val_ne = htonl(val);
+  memcpy(dest, &val_ne, sizeof(val_ne));
+}
+
+static void oosc_bundle_flush(Oosc_dev *dev) {
+  if (dev->bundle_size > Oosc_bundle_header_size)
+    oosc_send_datagram(dev, dev->bundle, dev->bundle_size);
+  dev->bundle_size = Oosc_bundle_header_size;
+}
+
+void oosc_bundle_begin(Oosc_dev *dev, U64 ntp_timetag) {
+  memcpy(dev->bundle, "#bundle", 8);
+  oosc_write_u32(dev->bundle + 8, (U32)(ntp_timetag >> 32));
+  oosc_write_u32(dev->bundle + 12, (U32)ntp_timetag);
+  dev->bundle_size = Oosc_bundle_header_size;
+  dev->is_bundling = true;
+}
+
+void oosc_bundle_end(Oosc_dev *dev) {
+  oosc_bundle_flush(dev);
+  dev->is_bundling = false;
+}
+
+U64 oosc_ntp_timetag_of_unix_ns(U64 unix_ns) {
+  // NTP time counts from 1900 instead of 1970.
+  U64 secs = unix_ns / 1000000000 + 2208988800u;
+  U64 frac = ((unix_ns % 1000000000) << 32) / 1000000000;
+  return secs << 32 | frac;
+}
+
+// Sends a whole OSC message, or adds it to the bundle if one is open.
+static void oosc_send_message(Oosc_dev *dev, char const *msg, Usz size) {
+  if (!dev->is_bundling) {
+    oosc_send_datagram(dev, msg, size);
+    return;
+  }
+  if (dev->bundle_size + Oosc_bundle_element_header_size + size >
+      Oosc_bundle_max_size)
+    oosc_bundle_flush(dev);
+  char *dest = dev->bundle + dev->bundle_size;
+  oosc_write_u32(dest, (U32)size);
+  memcpy(dest + Oosc_bundle_element_header_size, msg, size);
+  dev->bundle_size += Oosc_bundle_element_header_size + size;
+}
+
 void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals,
                       Usz count) {
-  char buffer[2048];
+  char buffer[Oosc_message_max_size];
   Usz buf_pos = 0;
   if (!oosc_write_strn(buffer, sizeof(buffer), &buf_pos, osc_address,
                        strlen(osc_address)))
     return;
-  Usz typetag_str_size = 1 + count + 1; // comma, 'i'... , null
-  Usz typetag_str_null_pad = (4 - typetag_str_size % 4) % 4;
-  if (buf_pos + typetag_str_size + typetag_str_null_pad > sizeof(buffer))
+  if (count > Oosc_int32s_max)
+    return;
+  char typetag[1 + Oosc_int32s_max]; // comma, 'i'...
+  typetag[0] = ',';
+  memset(typetag + 1, 'i', count);
+  if (!oosc_write_strn(buffer, sizeof(buffer), &buf_pos, typetag, 1 + count))
     return;
-  buffer[buf_pos] = ',';
-  ++buf_pos;
-  for (Usz i = 0; i < count; ++i) {
-    buffer[buf_pos + i] = 'i';
-  }
-  buffer[buf_pos + count] = 0;
-  buf_pos += count + 1;
-  for (Usz i = 0; i < typetag_str_null_pad; ++i) {
-    buffer[buf_pos + i] = 0;
-  }
-  buf_pos += typetag_str_null_pad;
   Usz ints_size = count * sizeof(I32);
   if (buf_pos + ints_size > sizeof(buffer))
     return;
@@ -160,22 +418,129 @@ void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals,
       U32 u;
     } pun;
     pun.i = vals[i];
-    U32 u_ne = htonl(pun.u);
-    memcpy(buffer + buf_pos, &u_ne, sizeof(u_ne));
-    buf_pos += sizeof(u_ne);
+    oosc_write_u32(buffer + buf_pos, pun.u);
+    buf_pos += sizeof(U32);
+  }
+  oosc_send_message(dev, buffer, buf_pos);
+}
+
+enum {
+  Susnote_none = UINT16_MAX,
+  Susnote_entry_count = Susnote_channels * Susnote_notes,
+  // A wheel unit is 2^20 nanoseconds, a little over a millisecond. Each level
+  // of the wheel has 64 slots, and each slot covers 64 slots of the level
+  // below it, so the levels cover about 67 milliseconds, 4 seconds, 4.5
+  // minutes and 5 hours.
+  Susnote_wheel_unit_shift = 20,
+  Susnote_wheel_level_shift = 6,
+  // A note counts as done when it has this much time or less left, so that
+  // rounding doesn't leave it on for one more step.
+  Susnote_slop_ns = 1000000,
+};
+
+static Usz susnote_index(U16 chan_note) {
+  assert((chan_note >> 8) < Susnote_channels &&
+         (chan_note & 0xFF) < Susnote_notes);
+  return (Usz)(chan_note >> 8) * Susnote_notes + (chan_note & 0x7F);
+}
+
+static float susnote_remaining(Susnote_list const *sl,
+                               Susnote_entry const *e) {
+  return (float)((double)((I64)e->deadline - (I64)sl->now) / 1e9);
+}
+
+// The wheel unit in which the note-off is due, taking the slop into account.
+static U64 susnote_due_unit(Susnote_entry const *e) {
+  U64 due = e->deadline > Susnote_slop_ns ? e->deadline - Susnote_slop_ns : 0;
+  return due >> Susnote_wheel_unit_shift;
+}
+
+static void susnote_wheel_link(Susnote_list *sl, Usz idx) {
+  Susnote_entry *e = sl->entries + idx;
+  U64 pos = sl->wheel_pos;
+  U64 unit = susnote_due_unit(e);
+  if (unit < pos)
+    unit = pos; // Already due, so it goes in the slot being expired next
+  U64 delta = unit - pos;
+  Usz level = 0;
+  while (level + 1 < Susnote_wheel_levels &&
+         delta >> (Susnote_wheel_level_shift * (level + 1)) != 0)
+    ++level;
+  U64 span = (U64)1 << (Susnote_wheel_level_shift * Susnote_wheel_levels);
+  if (delta >= span) // Too far off. It'll be put back in when that slot comes.
+    unit = pos + span - 1;
+  Usz slot = (Usz)(unit >> (Susnote_wheel_level_shift * level)) &
+             (Susnote_wheel_slots - 1);
+  U16 *head = &sl->wheel_heads[level][slot];
+  e->level = (U8)level;
+  e->slot = (U8)slot;
+  e->prev = Susnote_none;
+  e->next = *head;
+  if (*head != Susnote_none)
+    sl->entries[*head].prev = (U16)idx;
+  *head = (U16)idx;
+  sl->wheel_occupied[level] |= (U64)1 << slot;
+}
+
+static void susnote_wheel_unlink(Susnote_list *sl, Usz idx) {
+  Susnote_entry *e = sl->entries + idx;
+  if (e->prev != Susnote_none)
+    sl->entries[e->prev].next = e->next;
+  else
+    sl->wheel_heads[e->level][e->slot] = e->next;
+  if (e->next != Susnote_none)
+    sl->entries[e->next].prev = e->prev;
+  if (sl->wheel_heads[e->level][e->slot] == Susnote_none)
+    sl->wheel_occupied[e->level] &= ~((U64)1 << e->slot);
+}
+
+// Takes the note out of the live part of the buffer by swapping it with the
+// last live one. The removed note ends up just past the new `count`.
+static void susnote_remove(Susnote_list *sl, Usz idx) {
+  Susnote_entry *e = sl->entries + idx;
+  susnote_wheel_unlink(sl, idx);
+  Usz pos = e->pos;
+  Usz last = sl->count - 1;
+  Susnote sn = {.remaining = susnote_remaining(sl, e),
+                .chan_note = sl->buffer[pos].chan_note};
+  if (pos != last) {
+    Susnote moved = sl->buffer[last];
+    sl->buffer[pos] = moved;
+    sl->entries[susnote_index(moved.chan_note)].pos = (U16)pos;
   }
-  oosc_send_datagram(dev, buffer, buf_pos);
+  sl->buffer[last] = sn;
+  sl->count = last;
+  e->pos = Susnote_none;
 }
 
 void susnote_list_init(Susnote_list *sl) {
   sl->buffer = NULL;
   sl->count = 0;
   sl->capacity = 0;
+  sl->entries = NULL;
+  sl->now = 0;
+  sl->wheel_pos = 0;
+  for (Usz i = 0; i < Susnote_wheel_levels; ++i) {
+    sl->wheel_occupied[i] = 0;
+    for (Usz j = 0; j < Susnote_wheel_slots; ++j) {
+      sl->wheel_heads[i][j] = Susnote_none;
+    }
+  }
 }
 
-void susnote_list_deinit(Susnote_list *sl) { free(sl->buffer); }
+void susnote_list_deinit(Susnote_list *sl) {
+  free(sl->buffer);
+  free(sl->entries);
+}
 
-void susnote_list_clear(Susnote_list *sl) { sl->count = 0; }
+void susnote_list_clear(Susnote_list *sl) {
+  for (Usz i = 0, n = sl->count; i < n; ++i) {
+    Usz idx = susnote_index(sl->buffer[i].chan_note);
+    susnote_wheel_unlink(sl, idx);
+    sl->entries[idx].pos = Susnote_none;
+  }
+  sl->count = 0;
+}
 
 void susnote_list_add_notes(Susnote_list *sl, Susnote const *restrict notes,
                             Usz added_count, Usz *restrict start_removed,
@@ -191,83 +556,274 @@ void susnote_list_add_notes(Susnote_list *sl, Susnote const *restrict notes,
     sl->capacity = cap;
     sl->buffer = buffer;
   }
+  if (!sl->entries) {
+    sl->entries = malloc(Susnote_entry_count * sizeof(Susnote_entry));
+    for (Usz i = 0; i < Susnote_entry_count; ++i) {
+      sl->entries[i].pos = Susnote_none;
+    }
+  }
   *start_removed = rem;
-  Usz i_in = 0;
-  for (; i_in < added_count; ++i_in) {
+  for (Usz i_in = 0; i_in < added_count; ++i_in) {
     Susnote this_in = notes[i_in];
-    for (Usz i_old = 0; i_old < count; ++i_old) {
-      Susnote this_old = buffer[i_old];
-      if (this_old.chan_note == this_in.chan_note) {
-        buffer[i_old] = this_in;
-        buffer[rem] = this_old;
-        ++rem;
-        goto next_in;
-      }
+    Usz idx = susnote_index(this_in.chan_note);
+    Susnote_entry *e = sl->entries + idx;
+    if (e->pos != Susnote_none) {
+      // Retriggered. The old one goes in the removed range, and the new one
+      // takes its place.
+      susnote_wheel_unlink(sl, idx);
+      buffer[rem] = (Susnote){.remaining = susnote_remaining(sl, e),
+                              .chan_note = this_in.chan_note};
+      ++rem;
+      buffer[e->pos] = this_in;
+    } else {
+      buffer[count] = this_in;
+      e->pos = (U16)count;
+      ++count;
     }
-    buffer[count] = this_in;
-    ++count;
-  next_in:;
+    double remaining = this_in.remaining > 0.0f ? this_in.remaining : 0.0;
+    e->deadline = sl->now + (U64)(remaining * 1e9 + 0.5);
+    susnote_wheel_link(sl, idx);
   }
   sl->count = count;
   *end_removed = rem;
 }
 
+// Moves everything in a higher level slot back into the wheel, which puts it
+// in lower levels now that it's closer.
+static void susnote_wheel_cascade(Susnote_list *sl, Usz level, Usz slot) {
+  U16 idx = sl->wheel_heads[level][slot];
+  sl->wheel_heads[level][slot] = Susnote_none;
+  sl->wheel_occupied[level] &= ~((U64)1 << slot);
+  while (idx != Susnote_none) {
+    U16 next = sl->entries[idx].next;
+    susnote_wheel_link(sl, idx);
+    idx = next;
+  }
+}
+
+// Removes the notes in the current level 0 slot that are due by `now`.
+static void susnote_wheel_expire(Susnote_list *sl) {
+  Usz slot = (Usz)sl->wheel_pos & (Susnote_wheel_slots - 1);
+  U16 idx = sl->wheel_heads[0][slot];
+  while (idx != Susnote_none) {
+    Susnote_entry *e = sl->entries + idx;
+    U16 next = e->next;
+    if (e->deadline <= sl->now + Susnote_slop_ns)
+      susnote_remove(sl, idx);
+    idx = next;
+  }
+}
+
 void susnote_list_advance_time(Susnote_list *sl, double delta_time,
                                Usz *restrict start_removed,
                                Usz *restrict end_removed,
                                double *soonest_deadline) {
-  Susnote *restrict buffer = sl->buffer;
-  Usz count = sl->count;
-  *end_removed = count;
-  float delta_float = (float)delta_time;
-  float soonest = 1.0f;
-  for (Usz i = 0; i < count;) {
-    Susnote sn = buffer[i];
-    sn.remaining -= delta_float;
-    if (sn.remaining > 0.001) {
-      if (sn.remaining < soonest)
-        soonest = sn.remaining;
-      buffer[i].remaining = sn.remaining;
-      ++i;
-    } else {
-      --count;
-      buffer[i] = buffer[count];
-      buffer[count] = sn;
+  *end_removed = sl->count;
+  if (delta_time > 0.0)
+    sl->now += (U64)(delta_time * 1e9 + 0.5);
+  U64 target = sl->now >> Susnote_wheel_unit_shift;
+  U64 pos = sl->wheel_pos;
+  bool is_empty = true;
+  for (Usz i = 0; i < Susnote_wheel_levels; ++i) {
+    if (sl->wheel_occupied[i])
+      is_empty = false;
+  }
+  if (is_empty)
+    pos = target;
+  while (pos < target) {
+    susnote_wheel_expire(sl);
+    // Skip ahead to the next slot with something in it, or to where the
+    // next higher level slot has to be cascaded, whichever comes first.
+    Usz in_slot = (Usz)pos & (Susnote_wheel_slots - 1);
+    U64 next = (pos | (Susnote_wheel_slots - 1)) + 1;
+    if (in_slot + 1 < Susnote_wheel_slots) {
+      U64 later = sl->wheel_occupied[0] & ~(U64)0 << (in_slot + 1);
+      if (later)
+        next = (pos & ~(U64)(Susnote_wheel_slots - 1)) + orca_ctz64(later);
+    }
+    pos = next < target ? next : target;
+    sl->wheel_pos = pos;
+    for (Usz level = 1; level < Susnote_wheel_levels; ++level) {
+      Usz shift = Susnote_wheel_level_shift * level;
+      if (pos & (((U64)1 << shift) - 1))
+        break;
+      susnote_wheel_cascade(sl, level,
+                            (Usz)(pos >> shift) & (Susnote_wheel_slots - 1));
     }
   }
-  *start_removed = count;
-  *soonest_deadline = (double)soonest;
-  sl->count = count;
+  sl->wheel_pos = pos;
+  susnote_wheel_expire(sl); // Only partly through this one
+  *start_removed = sl->count;
+  *soonest_deadline = susnote_list_soonest_deadline(sl);
 }
 
 void susnote_list_remove_by_chan_mask(Susnote_list *sl, Usz chan_mask,
                                       Usz *restrict start_removed,
                                       Usz *restrict end_removed) {
-  Susnote *restrict buffer = sl->buffer;
-  Usz count = sl->count;
-  *end_removed = count;
-  for (Usz i = 0; i < count;) {
-    Susnote sn = buffer[i];
-    Usz chan = sn.chan_note >> 8;
-    if (chan_mask & 1u << chan) {
-      --count;
-      buffer[i] = buffer[count];
-      buffer[count] = sn;
-    } else {
+  *end_removed = sl->count;
+  for (Usz i = 0; i < sl->count;) {
+    U16 chan_note = sl->buffer[i].chan_note;
+    if (chan_mask & 1u << (chan_note >> 8))
+      susnote_remove(sl, susnote_index(chan_note)); // Brings in another at i
+    else
       ++i;
-    }
   }
-  *start_removed = count;
-  sl->count = count;
+  *start_removed = sl->count;
 }
 
 double susnote_list_soonest_deadline(Susnote_list const *sl) {
-  float soonest = 1.0f;
-  Susnote const *buffer = sl->buffer;
-  for (Usz i = 0, n = sl->count; i < n; ++i) {
-    float rem = buffer[i].remaining;
-    if (rem < soonest)
-      soonest = rem;
+  // The earliest note in each level is in its first non-empty slot, counting
+  // from where the wheel is. For level 0, that's the slot being expired; for
+  // the others, it's the one after, since the current one has already been
+  // cascaded down.
+  U64 soonest = UINT64_MAX;
+  for (Usz level = 0; level < Susnote_wheel_levels; ++level) {
+    U64 occupied = sl->wheel_occupied[level];
+    if (!occupied)
+      continue;
+    Usz first = (Usz)(sl->wheel_pos >> (Susnote_wheel_level_shift * level)) &
+                (Susnote_wheel_slots - 1);
+    if (level > 0)
+      ++first;
+    U64 later = first < Susnote_wheel_slots ? occupied & ~(U64)0 << first : 0;
+    Usz slot = orca_ctz64(later ? later : occupied);
+    for (U16 idx = sl->wheel_heads[level][slot]; idx != Susnote_none;
+         idx = sl->entries[idx].next) {
+      U64 deadline = sl->entries[idx].deadline;
+      if (deadline < soonest)
+        soonest = deadline;
+    }
+  }
+  if (soonest == UINT64_MAX || soonest >= sl->now + 1000000000)
+    return 1.0;
+  return (double)(soonest > sl->now ? soonest - sl->now : 0) / 1e9;
+}
+
+void oevent_out_list_init(Oevent_out_list *out) {
+  out->buffer = NULL;
+  out->count = 0;
+  out->capacity = 0;
+}
+
+void oevent_out_list_deinit(Oevent_out_list *out) { free(out->buffer); }
+
+static Oevent_out *oevent_out_list_alloc_item(Oevent_out_list *out) {
+  Usz count = out->count;
+  if (out->capacity == count) {
+    Usz capacity = count < 16 ? 16 : orca_round_up_power2(count + 1);
+    out->buffer = realloc(out->buffer, capacity * sizeof(Oevent_out));
+    out->capacity = capacity;
+  }
+  out->count = count + 1;
+  return out->buffer + count;
+}
+
+static void oevent_out_list_push_midi(Oevent_out_list *out, Usz status,
+                                      Usz data1, Usz data2) {
+  Oevent_out *o = oevent_out_list_alloc_item(out);
+  o->type = Oevent_out_midi;
+  o->status = (U8)status;
+  o->data1 = (U8)data1;
+  o->data2 = (U8)data2;
+  o->oevent_index = 0;
+}
+
+// Note-offs for a removed range of `sl`, other than for `skipped_chan_note`.
+static void oevent_out_list_push_note_offs(Oevent_out_list *out,
+                                           Susnote_list const *sl, Usz start,
+                                           Usz end, U16 skipped_chan_note) {
+  for (Usz i = start; i < end; ++i) {
+    U16 chan_note = sl->buffer[i].chan_note;
+    if (chan_note == skipped_chan_note)
+      continue;
+    oevent_out_list_push_midi(out, 0x80u | (Usz)(chan_note >> 8),
+                              chan_note & 0xFFu, 0);
+  }
+}
+
+void oevent_out_list_build(Oevent_out_list *out, Susnote_list *sl,
+                           Oevent const *events, Usz count, Usz bpm) {
+  out->count = 0;
+  double frame_secs = 60.0 / (double)bpm / 4.0;
+  Usz monofied_chans = 0; // Channels with a mono note-on from this tick
+  Usz mono_on_pos[Susnote_channels]; // Where that note-on is in `out`
+  for (Usz i = 0; i < count; ++i) {
+    Oevent const *e = events + i;
+    switch ((Oevent_types)e->any.oevent_type) {
+    case Oevent_type_midi_note: {
+      Oevent_midi_note const *em = &e->midi_note;
+      Usz note_number = (Usz)(12u * em->octave + em->note);
+      if (note_number > 127)
+        note_number = 127;
+      Usz channel = em->channel;
+      if (channel > 15)
+        break;
+      Usz chan_bit = (Usz)1 << channel;
+      Susnote sn = {.remaining = (float)(frame_secs * (double)em->duration),
+                    .chan_note = (U16)(channel << 8 | note_number)};
+      Usz start_offs, end_offs;
+      if (em->mono) {
+        // A mono note cuts off everything else sustained on its channel. If
+        // there was already one on the channel from this tick, only the last
+        // one gets played: the earlier one hasn't been sent yet, so its
+        // note-on is dropped and it doesn't need a note-off.
+        U16 dropped_chan_note = UINT16_MAX;
+        if (monofied_chans & chan_bit) {
+          Oevent_out *prev = out->buffer + mono_on_pos[channel];
+          prev->type = Oevent_out_skip;
+          dropped_chan_note = (U16)(channel << 8 | prev->data1);
+        }
+        susnote_list_remove_by_chan_mask(sl, chan_bit, &start_offs,
+                                         &end_offs);
+        oevent_out_list_push_note_offs(out, sl, start_offs, end_offs,
+                                       dropped_chan_note);
+        monofied_chans |= chan_bit;
+        mono_on_pos[channel] = out->count;
+        // Nothing to retrigger, since the channel was just emptied.
+        susnote_list_add_notes(sl, &sn, 1, &start_offs, &end_offs);
+      } else if (monofied_chans & chan_bit) {
+        // A mono note came first in this tick, and it cuts off the regular
+        // notes on its channel whichever side of it they're on. So this one
+        // gets its note-off straight away, and isn't sustained. If it's the
+        // same note, it would only cut off the mono note, so it's left out.
+        Usz mono_note = out->buffer[mono_on_pos[channel]].data1;
+        if (note_number == mono_note)
+          break;
+        oevent_out_list_push_midi(out, 0x90u | channel, note_number,
+                                  em->velocity);
+        oevent_out_list_push_midi(out, 0x80u | channel, note_number, 0);
+        break;
+      } else {
+        susnote_list_add_notes(sl, &sn, 1, &start_offs, &end_offs);
+        // The old note-off, if this note was retriggered.
+        oevent_out_list_push_note_offs(out, sl, start_offs, end_offs,
+                                       UINT16_MAX);
+      }
+      oevent_out_list_push_midi(out, 0x90u | channel, note_number,
+                                em->velocity);
+      break;
+    }
+    case Oevent_type_midi_cc: {
+      Oevent_midi_cc const *ec = &e->midi_cc;
+      oevent_out_list_push_midi(out, 0xB0u | (ec->channel & 0xFu),
+                                ec->control, ec->value);
+      break;
+    }
+    case Oevent_type_midi_pb: {
+      Oevent_midi_pb const *ep = &e->midi_pb;
+      oevent_out_list_push_midi(out, 0xE0u | (ep->channel & 0xFu), ep->lsb,
+                                ep->msb);
+      break;
+    }
+    case Oevent_type_osc_ints: {
+      Oevent_out *o = oevent_out_list_alloc_item(out);
+      o->type = Oevent_out_osc;
+      o->status = o->data1 = o->data2 = 0;
+      o->oevent_index = (U32)i;
+      break;
+    }
+    case Oevent_type_udp_string:
+      break;
+    }
   }
-  return (double)soonest;
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "base.h"
+#include "vmio.h"
 
 typedef struct Oosc_dev Oosc_dev;
 
@@ -14,27 +15,108 @@ Oosc_udp_create_error oosc_dev_create_udp(Oosc_dev **out_ptr,
                                           char const *dest_port);
 void oosc_dev_destroy(Oosc_dev *dev);
 
-// Send a raw UDP datagram.
+// A device can send to more than one place. Everything sent is encoded once,
+// and the same bytes go to each destination that's enabled. The one it was
+// created with is destination 0, and each one added is enabled to begin with.
+Oosc_udp_create_error oosc_dev_add_udp_dest(Oosc_dev *dev,
+                                            char const *dest_addr,
+                                            char const *dest_port);
+Usz oosc_dev_dest_count(Oosc_dev const *dev);
+// The numeric address and port it sends to, like "127.0.0.1:49162".
+char const *oosc_dev_dest_name(Oosc_dev const *dev, Usz index);
+// These can be used while another thread is sending with the device, as long
+// as no destinations are being added at the same time.
+void oosc_dev_set_dest_enabled(Oosc_dev *dev, Usz index, bool enabled);
+bool oosc_dev_dest_is_enabled(Oosc_dev const *dev, Usz index);
+// How many datagrams couldn't be sent to the destination.
+U64 oosc_dev_dest_send_errors(Oosc_dev const *dev, Usz index);
+
+// Send a raw UDP datagram, or add it to the queue.
 void oosc_send_datagram(Oosc_dev *dev, char const *data, Usz size);
 
+// Between these, datagrams (OSC messages and bundles too) are queued instead
+// of being sent with a system call each. oosc_queue_end() sends them all, with
+// one sendmmsg() for every 64 of them on Linux. Elsewhere, it's still one
+// sendto() each.
+void oosc_queue_begin(Oosc_dev *dev);
+void oosc_queue_end(Oosc_dev *dev);
+
+typedef struct {
+  U64 flushes;   // Times oosc_queue_end() had something to send
+  U64 datagrams; // Sent through the queue
+  // How many datagrams were queued when it was last flushed, and the most
+  // there have been.
+  U64 depth_last, depth_max;
+  // Times sendmmsg() sent fewer datagrams than it was given, so that the rest
+  // needed another call.
+  U64 partial_sends;
+  U64 dropped; // Failed to send, counting each destination
+} Oosc_tx_stats;
+
+Oosc_tx_stats oosc_dev_tx_stats(Oosc_dev const *dev);
+
 // Send a list/array of 32-bit integers in OSC format to the specified "osc
-// address" (a path like /foo) as a UDP datagram.
+// address" (a path like /foo) as a UDP datagram, or add it to the open bundle.
 void oosc_send_int32s(Oosc_dev *dev, char const *osc_address, I32 const *vals,
                       Usz count);
 
+// Bundles fit in a UDP datagram that fits in an Ethernet frame, over IPv6 or
+// IPv4, so they don't get fragmented.
+enum { Oosc_bundle_max_size = 1452 };
+
+// Between these, OSC messages are collected into a #bundle with the given NTP
+// timetag, instead of being sent as a datagram each. oosc_bundle_end() sends
+// it. If the messages don't fit in Oosc_bundle_max_size bytes, they're split
+// over as many bundles as it takes, all with the same timetag. Nothing is sent
+// if there were no messages.
+void oosc_bundle_begin(Oosc_dev *dev, U64 ntp_timetag);
+void oosc_bundle_end(Oosc_dev *dev);
+
+// The NTP timestamp, as used for OSC timetags, for a time in nanoseconds since
+// the Unix epoch: whole seconds since 1900 in the high 32 bits, and the
+// fraction of a second in the low 32.
+U64 oosc_ntp_timetag_of_unix_ns(U64 unix_ns);
+
 // Susnote is for handling MIDI note sustains -- each MIDI on event should be
 // matched with a MIDI note-off event. The duration/sustain length of a MIDI
 // note is specified when it is first triggered, so the orca VM itself is not
 // responsible for sending the note-off event. We keep a list of currently 'on'
 // notes so that they can have a matching 'off' sent at the correct time.
+//
+// `remaining` is the sustain length a note is added with. In a removed range,
+// it's how long the note had left when it was removed.
 typedef struct {
   float remaining;
-  U16 chan_note;
+  U16 chan_note; // Channel (0-15) in the high byte, note (0-127) in the low
 } Susnote;
 
+enum {
+  Susnote_channels = 16,
+  Susnote_notes = 128,
+  Susnote_wheel_levels = 4,
+  Susnote_wheel_slots = 64, // Per level, so each level's bitmask is a U64
+};
+
+// One per channel and note, since only one of each can be sustained at once.
+typedef struct {
+  U64 deadline; // In nanoseconds, on the list's own clock
+  U16 pos;      // Index in the list's buffer, or UINT16_MAX if not sustained
+  U16 prev, next; // In its wheel slot, or UINT16_MAX at either end
+  U8 level, slot;
+} Susnote_entry;
+
+// Besides the buffer of notes, the notes are kept in a hierarchical timing
+// wheel, keyed on when their note-offs are due, and in a table indexed by
+// channel and note number. So finding a retriggered note, or the notes that
+// are due, doesn't mean going through all of them.
 typedef struct {
   Susnote *buffer;
   Usz count, capacity;
+  Susnote_entry *entries; // Allocated when the first note is added
+  U64 now;                // Total time advanced, in nanoseconds
+  U64 wheel_pos;          // In wheel units. Earlier units are all expired.
+  U64 wheel_occupied[Susnote_wheel_levels]; // One bit per non-empty slot
+  U16 wheel_heads[Susnote_wheel_levels][Susnote_wheel_slots];
 } Susnote_list;
 
 void susnote_list_init(Susnote_list *sl);
@@ -54,3 +136,33 @@ void susnote_list_remove_by_chan_mask(Susnote_list *sl, Usz chan_mask,
 
 // Returns 1.0 if no notes remain or none are shorter than 1.0
 double susnote_list_soonest_deadline(Susnote_list const *sl);
+
+// What to send for the output events from one tick, worked out before any of
+// it is sent: the events' MIDI messages, with note-offs for the notes they cut
+// off, and the OSC events, all in the order the VM emitted them. The list is
+// reused from tick to tick, so it only has to grow when a tick has more to
+// send than any before it.
+typedef enum {
+  Oevent_out_midi, // `status`, `data1` and `data2`
+  Oevent_out_osc,  // The event at `oevent_index`
+  Oevent_out_skip, // A note-on that was dropped after it was added
+} Oevent_out_type;
+
+typedef struct {
+  U8 type;
+  U8 status, data1, data2;
+  U32 oevent_index;
+} Oevent_out;
+
+typedef struct {
+  Oevent_out *buffer;
+  Usz count, capacity;
+} Oevent_out_list;
+
+void oevent_out_list_init(Oevent_out_list *out);
+void oevent_out_list_deinit(Oevent_out_list *out);
+// Replaces what's in `out` with what to send for `events`, in one pass over
+// them. The notes they turn on are added to `sl`, which has to have had time
+// advanced up to this tick already. `bpm` is for the sustain lengths.
+void oevent_out_list_build(Oevent_out_list *out, Susnote_list *sl,
+                           Oevent const *events, Usz count, Usz bpm);
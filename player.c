@@ -0,0 +1,864 @@
+#include "player.h"
+#include "oso.h"
+#include "sokol_time.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+
+#define staticni ORCA_NOINLINE static
+
+U64 clock_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (U64)ts.tv_sec * 1000000000 + (U64)ts.tv_nsec;
+}
+
+// What the wall clock will say (or said) at `ns`, on clock_now_ns(), in
+// nanoseconds since the Unix epoch.
+static U64 clock_unix_ns_of(U64 ns) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  U64 unix_now = (U64)ts.tv_sec * 1000000000 + (U64)ts.tv_nsec;
+  return unix_now + (ns - clock_now_ns()); // Wraps around if `ns` is past
+}
+
+void clock_sleep_until_ns(U64 deadline_ns) {
+#ifdef ORCA_OS_MAC // No clock_nanosleep()
+  U64 now = clock_now_ns();
+  if (deadline_ns <= now)
+    return;
+  U64 ns = deadline_ns - now;
+  struct timespec ts = {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+  nanosleep(&ts, NULL);
+#else
+  struct timespec ts = {(time_t)(deadline_ns / 1000000000),
+                        (long)(deadline_ns % 1000000000)};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+#endif
+}
+
+#ifdef FEAT_PORTMIDI
+// Not sure whether it's OK to call Pm_Terminate() without having a successful
+// call to Pm_Initialize() -- let's just treat it with tweezers.
+static bool portmidi_is_initialized = false;
+#endif
+
+void midi_mode_init_null(Midi_mode *mm) { mm->any.type = Midi_mode_type_null; }
+void midi_mode_init_osc_bidule(Midi_mode *mm, char const *path) {
+  mm->osc_bidule.type = Midi_mode_type_osc_bidule;
+  mm->osc_bidule.path = path;
+}
+#ifdef FEAT_PORTMIDI
+static struct {
+  U64 clock_base;
+  bool did_init;
+} portmidi_global_data;
+// Milliseconds since PortMidi was first used, on the same clock as the tick
+// deadlines, so that a message can be stamped with when its tick was due.
+static PmTimestamp portmidi_timestamp_of(U64 ns) {
+  if (!portmidi_global_data.did_init) {
+    portmidi_global_data.did_init = true;
+    portmidi_global_data.clock_base = clock_now_ns();
+  }
+  U64 base = portmidi_global_data.clock_base;
+  return (PmTimestamp)(ns > base ? (ns - base) / 1000000 : 0);
+}
+static PmTimestamp portmidi_timeproc(void *time_info) {
+  (void)time_info;
+  return portmidi_timestamp_of(clock_now_ns());
+}
+PmError portmidi_init_if_necessary(void) {
+  if (portmidi_is_initialized)
+    return 0;
+  PmError e = Pm_Initialize();
+  if (e)
+    return e;
+  portmidi_is_initialized = true;
+  return 0;
+}
+void portmidi_deinit_if_necessary(void) {
+  if (portmidi_is_initialized)
+    Pm_Terminate();
+  portmidi_is_initialized = false;
+}
+// PortMidi holds each message until `latency_ms` after its timestamp. Since
+// messages are stamped with when their tick was due, that's how far ahead of
+// being heard they have to be sent, and any lateness in running the tick or
+// sending its output, up to that much, doesn't show up in the MIDI timing.
+// With 0, messages are sent right away and the timestamps are ignored.
+PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id,
+                                int latency_ms) {
+  PmError e = portmidi_init_if_necessary();
+  if (e)
+    goto fail;
+  e = Pm_OpenOutput(&mm->portmidi.stream, dev_id, NULL, 128, portmidi_timeproc,
+                    NULL, latency_ms);
+  if (e)
+    goto fail;
+  mm->portmidi.type = Midi_mode_type_portmidi;
+  mm->portmidi.device_id = dev_id;
+  mm->portmidi.latency_ms = latency_ms;
+  return pmNoError;
+fail:
+  midi_mode_init_null(mm);
+  return e;
+}
+bool portmidi_find_device_id_by_name(char const *name, Usz namelen,
+                                     PmError *out_pmerror, PmDeviceID *out_id) {
+  *out_pmerror = portmidi_init_if_necessary();
+  if (*out_pmerror)
+    return false;
+  int num = Pm_CountDevices();
+  for (int i = 0; i < num; ++i) {
+    PmDeviceInfo const *info = Pm_GetDeviceInfo(i);
+    if (!info || !info->output)
+      continue;
+    Usz len = strlen(info->name);
+    if (len != namelen)
+      continue;
+    if (strncmp(name, info->name, namelen) == 0) {
+      *out_id = i;
+      return true;
+    }
+  }
+  return false;
+}
+bool portmidi_find_name_of_device_id(PmDeviceID id, PmError *out_pmerror,
+                                     oso **out_name) {
+  *out_pmerror = portmidi_init_if_necessary();
+  if (*out_pmerror)
+    return false;
+  int num = Pm_CountDevices();
+  if (id < 0 || id >= num)
+    return false;
+  PmDeviceInfo const *info = Pm_GetDeviceInfo(id);
+  if (!info || !info->output)
+    return false;
+  osoput(out_name, info->name);
+  return true;
+}
+#endif
+void midi_mode_deinit(Midi_mode *mm) {
+  switch (mm->any.type) {
+  case Midi_mode_type_null:
+  case Midi_mode_type_osc_bidule:
+    break;
+#ifdef FEAT_PORTMIDI
+  case Midi_mode_type_portmidi:
+    // Because PortMidi seems to work correctly ony more platforms when using
+    // its timing stuff, we are using it. And because we are using it, and
+    // because it may be buffering events for sending 'later', we might have
+    // pending outgoing MIDI events. We'll need to wait until they finish being
+    // before calling Pm_Close, otherwise users could have problems like MIDI
+    // notes being stuck on. This is slow and blocking, but not much we can do
+    // about it right now.
+    clock_sleep_until_ns(clock_now_ns() +
+                         ((U64)mm->portmidi.latency_ms + 1) * 1000000);
+    Pm_Close(mm->portmidi.stream);
+    break;
+#endif
+  }
+}
+
+// `due_ns` is when the message should be heard, on clock_now_ns(). Only
+// PortMidi can do anything with it -- everything else is sent right away.
+staticni void send_midi_3bytes(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
+                               U64 due_ns, int status, int byte1, int byte2) {
+  switch (midi_mode->any.type) {
+  case Midi_mode_type_null:
+    break;
+  case Midi_mode_type_osc_bidule: {
+    (void)due_ns;
+    if (!oosc_dev)
+      break;
+    oosc_send_int32s(oosc_dev, midi_mode->osc_bidule.path,
+                     (int[]){status, byte1, byte2}, 3);
+    break;
+  }
+#ifdef FEAT_PORTMIDI
+  case Midi_mode_type_portmidi: {
+    // Stamped with when the tick it came from was due, rather than when we
+    // got around to sending it. See midi_mode_init_portmidi().
+    PmTimestamp pm_timestamp = portmidi_timestamp_of(due_ns);
+    PmError pme = Pm_WriteShort(midi_mode->portmidi.stream, pm_timestamp,
+                                Pm_Message(status, byte1, byte2));
+    (void)pme;
+    break;
+  }
+#endif
+  }
+}
+
+static void send_midi_chan_msg(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
+                               U64 due_ns, int type /*0..15*/,
+                               int chan /*0.. 15*/, int byte1 /*0..127*/,
+                               int byte2 /*0..127*/) {
+  send_midi_3bytes(oosc_dev, midi_mode, due_ns, type << 4 | chan, byte1,
+                   byte2);
+}
+
+static void send_midi_byte(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
+                           U64 due_ns, int x) {
+  // PortMidi wants 0 and 0 for the unused bytes. Likewise, Bidule's
+  // MIDI-via-OSC won't accept the message unless there are at least all 3
+  // bytes, with the second 2 set to zero.
+  send_midi_3bytes(oosc_dev, midi_mode, due_ns, x, 0, 0);
+}
+
+staticni void //
+send_midi_note_offs(Oosc_dev *oosc_dev, Midi_mode *midi_mode, U64 due_ns,
+                    Susnote const *start, Susnote const *end) {
+  for (; start != end; ++start) {
+    U16 chan_note = start->chan_note;
+    send_midi_chan_msg(oosc_dev, midi_mode, due_ns, 0x8, chan_note >> 8,
+                       chan_note & 0xFF, 0);
+  }
+}
+
+static void send_control_message(Oosc_dev *oosc_dev, char const *osc_address) {
+  if (!oosc_dev)
+    return;
+  oosc_send_int32s(oosc_dev, osc_address, NULL, 0);
+}
+
+static void send_num_message(Oosc_dev *oosc_dev, char const *osc_address,
+                             I32 num) {
+  if (!oosc_dev)
+    return;
+  I32 nums[1];
+  nums[0] = num;
+  oosc_send_int32s(oosc_dev, osc_address, nums, ORCA_ARRAY_COUNTOF(nums));
+}
+
+staticni void apply_time_to_sustained_notes(Oosc_dev *oosc_dev,
+                                            Midi_mode *midi_mode, U64 due_ns,
+                                            double time_elapsed,
+                                            Susnote_list *susnote_list,
+                                            double *next_note_off_deadline) {
+  Usz start_removed, end_removed;
+  susnote_list_advance_time(susnote_list, time_elapsed, &start_removed,
+                            &end_removed, next_note_off_deadline);
+  if (ORCA_UNLIKELY(start_removed != end_removed)) {
+    Susnote const *restrict susnotes_off = susnote_list->buffer;
+    send_midi_note_offs(oosc_dev, midi_mode, due_ns,
+                        susnotes_off + start_removed,
+                        susnotes_off + end_removed);
+  }
+}
+
+// Sends the events from one tick, in the order the VM emitted them. What to
+// send is worked out first, into `out_list`, by oevent_out_list_build().
+staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
+                                 U64 due_ns, Usz bpm,
+                                 Susnote_list *susnote_list,
+                                 Oevent_out_list *out_list,
+                                 Oevent const *events, Usz count) {
+  oevent_out_list_build(out_list, susnote_list, events, count, bpm);
+  Oevent_out const *outs = out_list->buffer;
+  for (Usz i = 0, n = out_list->count; i < n; ++i) {
+    Oevent_out const *o = outs + i;
+    switch ((Oevent_out_type)o->type) {
+    case Oevent_out_midi:
+      send_midi_3bytes(oosc_dev, midi_mode, due_ns, o->status, o->data1,
+                       o->data2);
+      break;
+    case Oevent_out_osc: {
+      // kinda lame
+      if (!oosc_dev)
+        break;
+      Oevent_osc_ints const *eo = &events[o->oevent_index].osc_ints;
+      char path[] = {'/', eo->glyph, '\0'};
+      I32 ints[ORCA_ARRAY_COUNTOF(eo->numbers)];
+      Usz nnum = eo->count;
+      for (Usz inum = 0; inum < nnum; ++inum) {
+        ints[inum] = eo->numbers[inum];
+      }
+      oosc_send_int32s(oosc_dev, path, ints, nnum);
+      break;
+    }
+    case Oevent_out_skip:
+      break;
+    }
+  }
+}
+
+//////// Output thread
+
+staticni void player_output_send(Player *pl, Outmsg const *msg) {
+  Oosc_dev *oosc_dev = pl->oosc_dev;
+  Midi_mode *midi_mode = &pl->midi_mode;
+  Susnote_list *sl = &pl->output.susnote_list;
+  // A tick can be run late, after the UI thread has published something with
+  // a later time.
+  U64 due_ns = msg->due_ns;
+  if (due_ns < pl->output.last_due_ns)
+    due_ns = pl->output.last_due_ns;
+  pl->output.last_due_ns = due_ns;
+  // Everything for this message goes out together, with as few system calls
+  // as the OS allows.
+  if (oosc_dev)
+    oosc_queue_begin(oosc_dev);
+  bool is_bundled = oosc_dev && pl->output.osc_bundles;
+  if (is_bundled)
+    oosc_bundle_begin(oosc_dev,
+                      oosc_ntp_timetag_of_unix_ns(clock_unix_ns_of(due_ns)));
+  switch (msg->type) {
+  case Outmsg_tick: {
+    double next_note_off_deadline;
+    apply_time_to_sustained_notes(oosc_dev, midi_mode, due_ns, msg->secs, sl,
+                                  &next_note_off_deadline);
+    Usz count = msg->oevent_list.count;
+    if (count > 0)
+      send_output_events(oosc_dev, midi_mode, due_ns, msg->bpm, sl,
+                         &pl->output.out_list, msg->oevent_list.buffer, count);
+    break;
+  }
+  case Outmsg_midi_byte:
+    send_midi_byte(oosc_dev, midi_mode, due_ns, msg->num);
+    break;
+  case Outmsg_osc_control:
+    send_control_message(oosc_dev, msg->osc_address);
+    break;
+  case Outmsg_osc_num:
+    send_num_message(oosc_dev, msg->osc_address, msg->num);
+    break;
+  case Outmsg_stop_notes:
+    send_midi_note_offs(oosc_dev, midi_mode, due_ns, sl->buffer,
+                        sl->buffer + sl->count);
+    susnote_list_clear(sl);
+    break;
+  }
+  if (is_bundled)
+    oosc_bundle_end(oosc_dev);
+  if (oosc_dev) {
+    oosc_queue_end(oosc_dev);
+    Oosc_tx_stats tx = oosc_dev_tx_stats(oosc_dev);
+    Player_output_stats *st = &pl->output.stats;
+    __atomic_store_n(&st->udp_depth_last, tx.depth_last, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->udp_depth_max, tx.depth_max, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->udp_partial_sends, tx.partial_sends,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&st->udp_send_errors, tx.dropped, __ATOMIC_RELAXED);
+  }
+}
+
+static void *player_output_main(void *arg) {
+  Player *pl = arg;
+  Player_output *out = &pl->output;
+  pthread_mutex_lock(&out->lock);
+  for (;;) {
+    Usz consumed = out->consumed;
+    if (consumed == __atomic_load_n(&out->published, __ATOMIC_ACQUIRE)) {
+      pthread_cond_broadcast(&out->drained_cond);
+      if (out->quit)
+        break;
+      // player_output_publish() checks this after it publishes, so one of us
+      // will see what the other did.
+      __atomic_store_n(&out->output_is_waiting, true, __ATOMIC_SEQ_CST);
+      if (consumed == __atomic_load_n(&out->published, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&out->wake_cond, &out->lock);
+      __atomic_store_n(&out->output_is_waiting, false, __ATOMIC_RELAXED);
+      continue;
+    }
+    Outmsg const *msg = out->ring + (consumed & (Output_ring_size - 1));
+    U64 latency = (U64)stm_ns(stm_since(msg->stamp));
+    player_output_send(pl, msg);
+    __atomic_store_n(&out->consumed, consumed + 1, __ATOMIC_RELEASE);
+    Player_output_stats *st = &out->stats;
+    __atomic_store_n(&st->latency_last_ns, latency, __ATOMIC_RELAXED);
+    if (latency > st->latency_max_ns)
+      __atomic_store_n(&st->latency_max_ns, latency, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->latency_sum_ns, st->latency_sum_ns + latency,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&st->sent, st->sent + 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&out->lock);
+  return NULL;
+}
+
+staticni void player_output_init(Player *pl) {
+  Player_output *out = &pl->output;
+  for (Usz i = 0; i < Output_ring_size; ++i) {
+    oevent_list_init(&out->ring[i].oevent_list);
+  }
+  out->published = out->consumed = 0;
+  out->output_is_waiting = false;
+  out->dropped_secs = 0.0;
+  pthread_mutex_init(&out->lock, NULL);
+  pthread_cond_init(&out->wake_cond, NULL);
+  pthread_cond_init(&out->drained_cond, NULL);
+  out->quit = false;
+  susnote_list_init(&out->susnote_list);
+  oevent_out_list_init(&out->out_list);
+  out->last_due_ns = 0;
+  out->osc_bundles = false;
+  memset(&out->stats, 0, sizeof out->stats);
+  // Without the thread, messages are sent as soon as they're published.
+  out->has_thread =
+      pthread_create(&out->thread, NULL, player_output_main, pl) == 0;
+}
+
+staticni void player_output_deinit(Player *pl) {
+  Player_output *out = &pl->output;
+  if (out->has_thread) {
+    pthread_mutex_lock(&out->lock);
+    out->quit = true;
+    pthread_cond_signal(&out->wake_cond);
+    pthread_mutex_unlock(&out->lock);
+    pthread_join(out->thread, NULL);
+  }
+  pthread_mutex_destroy(&out->lock);
+  pthread_cond_destroy(&out->wake_cond);
+  pthread_cond_destroy(&out->drained_cond);
+  for (Usz i = 0; i < Output_ring_size; ++i) {
+    oevent_list_deinit(&out->ring[i].oevent_list);
+  }
+  susnote_list_deinit(&out->susnote_list);
+  oevent_out_list_deinit(&out->out_list);
+}
+
+void player_output_lock(Player *pl) {
+  Player_output *out = &pl->output;
+  pthread_mutex_lock(&out->lock);
+  while (out->has_thread && out->consumed != out->published)
+    pthread_cond_wait(&out->drained_cond, &out->lock);
+}
+
+void player_output_unlock(Player *pl) {
+  pthread_mutex_unlock(&pl->output.lock);
+}
+
+// Returns the next free slot in the ring, or NULL if it's full. If `must_send`
+// is set, it waits for a slot instead.
+staticni Outmsg *player_output_reserve(Player *pl, Outmsg_type type,
+                                      bool must_send) {
+  Player_output *out = &pl->output;
+  Usz published = out->published;
+  if (published - __atomic_load_n(&out->consumed, __ATOMIC_ACQUIRE) ==
+      Output_ring_size) {
+    if (!must_send) {
+      __atomic_store_n(&out->stats.overflows, out->stats.overflows + 1,
+                       __ATOMIC_RELAXED);
+      return NULL;
+    }
+    player_output_lock(pl);
+    player_output_unlock(pl);
+  }
+  Outmsg *msg = out->ring + (published & (Output_ring_size - 1));
+  msg->type = type;
+  msg->due_ns = clock_now_ns();
+  return msg;
+}
+
+staticni void player_output_publish(Player *pl, Outmsg *msg) {
+  Player_output *out = &pl->output;
+  msg->stamp = stm_now();
+  if (!out->has_thread) {
+    player_output_send(pl, msg);
+    ++out->published;
+    out->consumed = out->published;
+    return;
+  }
+  __atomic_store_n(&out->published, out->published + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&out->output_is_waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&out->lock);
+    pthread_cond_signal(&out->wake_cond);
+    pthread_mutex_unlock(&out->lock);
+  }
+}
+
+// `secs` is the time since the last tick. If the ring is full, the events are
+// dropped, and the time is added on to the next tick that fits.
+staticni void player_output_tick(Player *pl, double secs,
+                                Oevent_list const *oevent_list) {
+  Player_output *out = &pl->output;
+  Outmsg *msg = player_output_reserve(pl, Outmsg_tick, false);
+  if (!msg) {
+    out->dropped_secs += secs;
+    return;
+  }
+  msg->secs = secs + out->dropped_secs;
+  msg->bpm = pl->bpm;
+  msg->due_ns = pl->clock.last_deadline_ns;
+  oevent_list_copy(oevent_list, &msg->oevent_list);
+  out->dropped_secs = 0.0;
+  player_output_publish(pl, msg);
+}
+
+void player_output_midi_byte(Player *pl, int byte) {
+  bool is_beat_clock = byte == 0xF8;
+  Outmsg *msg = player_output_reserve(pl, Outmsg_midi_byte, !is_beat_clock);
+  if (!msg)
+    return;
+  if (is_beat_clock)
+    msg->due_ns = pl->clock.last_deadline_ns;
+  msg->num = byte;
+  player_output_publish(pl, msg);
+}
+
+void player_output_osc(Player *pl, char const *osc_address) {
+  Outmsg *msg = player_output_reserve(pl, Outmsg_osc_control, true);
+  msg->osc_address = osc_address;
+  player_output_publish(pl, msg);
+}
+
+void player_send_osc_bpm(Player *pl, I32 bpm) {
+  Outmsg *msg = player_output_reserve(pl, Outmsg_osc_num, true);
+  msg->osc_address = "/orca/bpm";
+  msg->num = bpm;
+  player_output_publish(pl, msg);
+}
+
+void player_stop_all_sustained_notes(Player *pl) {
+  player_output_publish(pl, player_output_reserve(pl, Outmsg_stop_notes, true));
+}
+
+Player_output_stats player_output_stats(Player const *pl) {
+  Player_output_stats const *st = &pl->output.stats;
+  Player_output_stats result;
+  result.sent = __atomic_load_n(&st->sent, __ATOMIC_RELAXED);
+  result.overflows = __atomic_load_n(&st->overflows, __ATOMIC_RELAXED);
+  result.latency_last_ns =
+      __atomic_load_n(&st->latency_last_ns, __ATOMIC_RELAXED);
+  result.latency_max_ns =
+      __atomic_load_n(&st->latency_max_ns, __ATOMIC_RELAXED);
+  result.latency_sum_ns =
+      __atomic_load_n(&st->latency_sum_ns, __ATOMIC_RELAXED);
+  result.udp_depth_last =
+      __atomic_load_n(&st->udp_depth_last, __ATOMIC_RELAXED);
+  result.udp_depth_max = __atomic_load_n(&st->udp_depth_max, __ATOMIC_RELAXED);
+  result.udp_partial_sends =
+      __atomic_load_n(&st->udp_partial_sends, __ATOMIC_RELAXED);
+  result.udp_send_errors =
+      __atomic_load_n(&st->udp_send_errors, __ATOMIC_RELAXED);
+  return result;
+}
+
+//////// Clock thread
+
+enum {
+  // How long the clock thread sleeps at a time while it waits for a deadline,
+  // so that a change of tempo is noticed before the old deadline comes.
+  Clock_max_sleep_ns = 10 * 1000 * 1000,
+  // With --strict-timing, how long before each deadline to stop sleeping and
+  // spin instead, to get around being woken up late by the scheduler.
+  Clock_strict_spin_ns = 250 * 1000,
+  // Up to this far behind, or one tick if that's longer, the clock runs the
+  // ticks it missed right away to catch up. Any further and it gives up on
+  // them instead of running them all at once.
+  Clock_max_catch_up_ns = 250 * 1000 * 1000,
+};
+
+staticni void clear_and_run_vm(Glyph *restrict gbuf, Mark *restrict mbuf,
+                               Usz height, Usz width, Usz tick_number,
+                               Oevent_list *oevent_list, Usz random_seed,
+                               Orca_vm *vm, Live_index *live_index,
+                               Orca_band_pool *band_pool) {
+  oevent_list_clear(oevent_list);
+  orca_run(gbuf, mbuf, height, width, tick_number, oevent_list, random_seed,
+           vm, live_index, band_pool);
+}
+
+// Runs the tick at `tick_num`, leaving its events in `oevent_list`.
+staticni void player_run_tick(Player *pl) {
+  orca_checkpoints_maybe_save(&pl->checkpoints, &pl->field, &pl->vm,
+                              pl->tick_num, pl->random_seed);
+  clear_and_run_vm(pl->field.buffer, pl->mbuf_r.buffer, pl->field.height,
+                   pl->field.width, pl->tick_num, &pl->oevent_list,
+                   pl->random_seed, &pl->vm, &pl->live_index, &pl->band_pool);
+  ++pl->tick_num;
+  ++pl->ticks_run;
+  pl->activity_counter += pl->oevent_list.count;
+  pl->has_new_tick = true;
+}
+
+staticni void player_clock_tick(Player *pl) {
+  if (pl->midi_bclock) {
+    player_output_midi_byte(pl, 0xF8); // MIDI beat clock
+    Usz sixths = pl->midi_bclock_sixths;
+    pl->midi_bclock_sixths = (U8)((sixths + 1) % 6);
+    if (sixths != 0)
+      return;
+  }
+  player_run_tick(pl);
+  // The output thread moves the sustained notes along by the length of a
+  // tick, then sends the events.
+  player_output_tick(pl, 60.0 / (double)pl->bpm / 4.0, &pl->oevent_list);
+}
+
+// A tick is a 16th note, so at 1 BPM there are 15 seconds between ticks. If
+// MIDI beat clock output is enabled, we need to send an event every 24 parts
+// per quarter note, so that's divided by a further 6, and a tick is run on
+// every 6th one.
+static U64 player_clock_divisor(Player const *pl) {
+  return (U64)pl->bpm * (pl->midi_bclock ? 6 : 1);
+}
+
+// Makes the next deadline be now.
+staticni void player_clock_restart(Player *pl) {
+  Player_clock *clk = &pl->clock;
+  clk->last_deadline_ns =
+      clock_now_ns() - (U64)15 * 1000000000 / player_clock_divisor(pl);
+  clk->deadline_frac = 0;
+}
+
+// If the next tick or beat clock pulse is due by `now`, runs it and returns
+// true. Otherwise returns false, and `*out_deadline_ns` is when it's due. The
+// tempo is read each time, so if it changes, the next deadline moves with it.
+staticni bool player_clock_run_due(Player *pl, U64 now, U64 *out_deadline_ns) {
+  Player_clock *clk = &pl->clock;
+  U64 divisor = player_clock_divisor(pl);
+  U64 const span = (U64)15 * 1000000000;
+  U64 frac = clk->deadline_frac + span % divisor;
+  U64 period = span / divisor + frac / divisor;
+  U64 deadline = clk->last_deadline_ns + period;
+  if (now < deadline) {
+    *out_deadline_ns = deadline;
+    return false;
+  }
+  Player_clock_stats *st = &clk->stats;
+  U64 late = now - deadline;
+  ++st->deadlines;
+  st->late_last_ns = late;
+  if (late > st->late_max_ns)
+    st->late_max_ns = late;
+  st->late_sum_ns += late;
+  if (late >= period && late >= Clock_max_catch_up_ns) {
+    // Most likely the machine was suspended, or the grid takes longer to run
+    // than the time between ticks. Count on from now.
+    ++st->resyncs;
+    deadline = now;
+    frac = 0;
+  }
+  clk->last_deadline_ns = deadline;
+  clk->deadline_frac = frac % divisor;
+  player_clock_tick(pl);
+  return true;
+}
+
+static void *player_clock_main(void *arg) {
+  Player *pl = arg;
+  Player_clock *clk = &pl->clock;
+  pthread_mutex_lock(&clk->lock);
+  while (!clk->quit) {
+    if (!pl->is_playing) {
+      pthread_cond_wait(&clk->wake_cond, &clk->lock);
+      continue;
+    }
+    U64 now = clock_now_ns(), deadline;
+    if (player_clock_run_due(pl, now, &deadline)) {
+      if (clk->wants_wakeups && pl->has_new_tick) {
+        // If the pipe is full, the UI thread already has wakeups waiting.
+        ssize_t written = write(clk->wake_fds[1], "", 1);
+        (void)written;
+      }
+      // Let the UI thread have the lock if it's waiting for it, so that a
+      // grid that takes longer to run than the time between ticks doesn't
+      // lock it out.
+      if (__atomic_load_n(&clk->ui_is_waiting, __ATOMIC_RELAXED)) {
+        pthread_mutex_unlock(&clk->lock);
+        while (__atomic_load_n(&clk->ui_is_waiting, __ATOMIC_RELAXED))
+          sched_yield();
+        pthread_mutex_lock(&clk->lock);
+      }
+      continue;
+    }
+    U64 spin_ns = clk->spin_ns;
+    pthread_mutex_unlock(&clk->lock);
+    if (deadline - now > Clock_max_sleep_ns + spin_ns) {
+      clock_sleep_until_ns(now + Clock_max_sleep_ns);
+    } else {
+      clock_sleep_until_ns(deadline - spin_ns);
+      while (clock_now_ns() < deadline) {
+      }
+    }
+    pthread_mutex_lock(&clk->lock);
+  }
+  pthread_mutex_unlock(&clk->lock);
+  return NULL;
+}
+
+staticni void player_clock_init(Player *pl, bool strict_timing) {
+  Player_clock *clk = &pl->clock;
+  pthread_mutex_init(&clk->lock, NULL);
+  pthread_cond_init(&clk->wake_cond, NULL);
+  clk->quit = false;
+  clk->ui_is_waiting = false;
+  clk->wants_wakeups = false;
+  clk->last_deadline_ns = clk->deadline_frac = 0;
+  clk->spin_ns = strict_timing ? Clock_strict_spin_ns : 0;
+  memset(&clk->stats, 0, sizeof clk->stats);
+  clk->has_thread = false;
+  if (pipe(clk->wake_fds) != 0) {
+    clk->wake_fds[0] = clk->wake_fds[1] = -1;
+    return;
+  }
+  for (int i = 0; i < 2; ++i) {
+    fcntl(clk->wake_fds[i], F_SETFL,
+          fcntl(clk->wake_fds[i], F_GETFL) | O_NONBLOCK);
+  }
+  // Without the thread, the UI thread runs the ticks when it wakes up.
+  clk->has_thread =
+      pthread_create(&clk->thread, NULL, player_clock_main, pl) == 0;
+}
+
+staticni void player_clock_deinit(Player *pl) {
+  Player_clock *clk = &pl->clock;
+  if (clk->has_thread) {
+    pthread_mutex_lock(&clk->lock);
+    clk->quit = true;
+    pthread_cond_signal(&clk->wake_cond);
+    pthread_mutex_unlock(&clk->lock);
+    pthread_join(clk->thread, NULL);
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (clk->wake_fds[i] != -1)
+      close(clk->wake_fds[i]);
+  }
+  pthread_mutex_destroy(&clk->lock);
+  pthread_cond_destroy(&clk->wake_cond);
+}
+
+void player_lock(Player *pl) {
+  Player_clock *clk = &pl->clock;
+  __atomic_store_n(&clk->ui_is_waiting, true, __ATOMIC_RELAXED);
+  pthread_mutex_lock(&clk->lock);
+  __atomic_store_n(&clk->ui_is_waiting, false, __ATOMIC_RELAXED);
+}
+
+void player_unlock(Player *pl) { pthread_mutex_unlock(&pl->clock.lock); }
+
+int player_clock_timeout_ms(Player *pl, int max_ms) {
+  if (pl->clock.has_thread || !pl->is_playing)
+    return max_ms;
+  U64 deadline;
+  if (player_clock_run_due(pl, clock_now_ns(), &deadline))
+    return 0;
+  U64 now = clock_now_ns();
+  U64 ms = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+  return ms < (U64)max_ms ? (int)ms : max_ms;
+}
+
+void player_init(Player *pl, Usz init_bpm, Usz init_seed, Usz band_threads,
+                 bool strict_timing) {
+  field_init(&pl->field);
+  mbuf_reusable_init(&pl->mbuf_r);
+  live_index_init(&pl->live_index);
+  orca_vm_init(&pl->vm);
+  orca_band_pool_init(&pl->band_pool, band_threads);
+  orca_checkpoints_init(&pl->checkpoints, Orca_checkpoint_interval_default,
+                        Orca_checkpoint_limit_default);
+  oevent_list_init(&pl->oevent_list);
+  oevent_list_init(&pl->scratch_oevent_list);
+  pl->oosc_dev = NULL;
+  midi_mode_init_null(&pl->midi_mode);
+  pl->tick_num = 0;
+  pl->ticks_run = 0;
+  pl->bpm = init_bpm;
+  pl->activity_counter = 0;
+  pl->random_seed = init_seed;
+  pl->midi_bclock_sixths = 0;
+  pl->is_playing = false;
+  pl->midi_bclock = false;
+  pl->has_new_tick = false;
+  player_output_init(pl);
+  player_clock_init(pl, strict_timing);
+}
+
+void player_deinit(Player *pl) {
+  player_clock_deinit(pl); // Stops the ticks before anything is freed
+  field_deinit(&pl->field);
+  mbuf_reusable_deinit(&pl->mbuf_r);
+  live_index_deinit(&pl->live_index);
+  orca_vm_deinit(&pl->vm);
+  orca_band_pool_deinit(&pl->band_pool);
+  orca_checkpoints_deinit(&pl->checkpoints);
+  oevent_list_deinit(&pl->oevent_list);
+  oevent_list_deinit(&pl->scratch_oevent_list);
+  player_output_deinit(pl); // Before the devices it sends to are closed
+  if (pl->oosc_dev)
+    oosc_dev_destroy(pl->oosc_dev);
+  midi_mode_deinit(&pl->midi_mode);
+}
+
+void player_set_playing(Player *pl, bool playing) {
+  if (playing == pl->is_playing)
+    return;
+  if (playing) {
+    pl->is_playing = true;
+    pl->midi_bclock_sixths = 0;
+    if (pl->midi_bclock)
+      player_output_midi_byte(pl, 0xFA); // "start"
+    player_output_osc(pl, "/orca/started");
+    player_clock_restart(pl); // First tick right away
+    pthread_cond_signal(&pl->clock.wake_cond);
+  } else {
+    player_stop_all_sustained_notes(pl);
+    pl->is_playing = false;
+    player_output_osc(pl, "/orca/stopped");
+    if (pl->midi_bclock)
+      player_output_midi_byte(pl, 0xFC); // "stop"
+  }
+}
+
+void player_step(Player *pl) { player_run_tick(pl); }
+
+void player_clear_osc_udp(Player *pl) {
+  if (pl->oosc_dev) {
+    if (pl->midi_mode.any.type == Midi_mode_type_osc_bidule) {
+      player_stop_all_sustained_notes(pl);
+    }
+    player_output_lock(pl);
+    oosc_dev_destroy(pl->oosc_dev);
+    pl->oosc_dev = NULL;
+    player_output_unlock(pl);
+  }
+}
+
+bool split_udp_dest(char const *spec, char *host, Usz host_size,
+                    char const **out_port) {
+  char const *colon = strrchr(spec, ':');
+  char const *port = colon ? colon + 1 : spec;
+  Usz host_len = colon ? (Usz)(colon - spec) : 0;
+  if (host_len >= 2 && spec[0] == '[' && spec[host_len - 1] == ']') {
+    ++spec;
+    host_len -= 2;
+  }
+  if (!*port || host_len >= host_size)
+    return false;
+  memcpy(host, spec, host_len);
+  host[host_len] = '\0';
+  *out_port = port;
+  return true;
+}
+
+bool player_add_osc_udp_dest(Player *pl, char const *spec) {
+  char host[256];
+  char const *port;
+  if (!pl->oosc_dev || !split_udp_dest(spec, host, sizeof host, &port))
+    return false;
+  player_output_lock(pl);
+  Oosc_udp_create_error err =
+      oosc_dev_add_udp_dest(pl->oosc_dev, host[0] ? host : NULL, port);
+  player_output_unlock(pl);
+  return !err;
+}
+
+bool player_set_osc_udp(Player *pl, char const *dest_addr,
+                        char const *dest_port) {
+  player_clear_osc_udp(pl);
+  if (dest_port) {
+    player_output_lock(pl);
+    Oosc_udp_create_error err =
+        oosc_dev_create_udp(&pl->oosc_dev, dest_addr, dest_port);
+    player_output_unlock(pl);
+    if (err) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#undef staticni
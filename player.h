@@ -0,0 +1,246 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+#include "gbuffer.h"
+#include "osc_out.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "vmio.h"
+#include <pthread.h>
+
+#ifdef FEAT_PORTMIDI
+#include <portmidi.h>
+#endif
+
+// Playing a grid in real time: running its ticks on time, on a clock thread,
+// and sending the MIDI and OSC output from them, on an output thread. None of
+// it draws anything, so it's shared by the livecoding environment and the
+// headless daemon.
+
+// The clock that tick deadlines, and the timestamps given to PortMidi, are
+// measured on.
+U64 clock_now_ns(void);
+void clock_sleep_until_ns(U64 deadline_ns);
+
+typedef enum {
+  Midi_mode_type_null,
+  Midi_mode_type_osc_bidule,
+#ifdef FEAT_PORTMIDI
+  Midi_mode_type_portmidi,
+#endif
+} Midi_mode_type;
+
+typedef struct {
+  Midi_mode_type type;
+} Midi_mode_any;
+
+typedef struct {
+  Midi_mode_type type;
+  char const *path;
+} Midi_mode_osc_bidule;
+
+#ifdef FEAT_PORTMIDI
+typedef struct {
+  Midi_mode_type type;
+  PmDeviceID device_id;
+  PortMidiStream *stream;
+  int latency_ms;
+} Midi_mode_portmidi;
+#endif
+
+typedef union {
+  Midi_mode_any any;
+  Midi_mode_osc_bidule osc_bidule;
+#ifdef FEAT_PORTMIDI
+  Midi_mode_portmidi portmidi;
+#endif
+} Midi_mode;
+
+void midi_mode_init_null(Midi_mode *mm);
+// `path` isn't copied, so it has to outlive the MIDI mode.
+void midi_mode_init_osc_bidule(Midi_mode *mm, char const *path);
+void midi_mode_deinit(Midi_mode *mm);
+#ifdef FEAT_PORTMIDI
+PmError portmidi_init_if_necessary(void);
+// Call at exit, after every PortMidi MIDI mode is deinitialized.
+void portmidi_deinit_if_necessary(void);
+PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id,
+                                int latency_ms);
+// Returns true on success. Only looks at output devices.
+bool portmidi_find_device_id_by_name(char const *name, Usz namelen,
+                                     PmError *out_pmerror, PmDeviceID *out_id);
+struct oso;
+bool portmidi_find_name_of_device_id(PmDeviceID id, PmError *out_pmerror,
+                                     struct oso **out_name);
+#endif
+
+// Counters from the output thread. Latency is from when a message is handed
+// to the output thread to when it starts sending it. The UDP ones are from
+// the OSC device's transmit queue -- see oosc_queue_begin().
+typedef struct {
+  U64 sent, overflows, latency_last_ns, latency_max_ns, latency_sum_ns;
+  U64 udp_depth_last, udp_depth_max, udp_partial_sends, udp_send_errors;
+} Player_output_stats;
+
+// How late the clock thread was for each deadline, from when it was due to
+// when the thread got going after waking up. `resyncs` counts the times it was
+// too far behind to catch up, and started counting again from then.
+typedef struct {
+  U64 deadlines, resyncs, late_last_ns, late_max_ns, late_sum_ns;
+} Player_clock_stats;
+
+// MIDI and OSC output is sent from its own thread, so that a slow sendto() or
+// PortMidi write doesn't hold up the next tick or the UI. The clock and UI
+// threads hand it the output events from each tick, and the other messages
+// they would have sent (start, stop, beat clock, BPM), through a ring that
+// needs no lock, since there's only ever one thread on each end: the output
+// thread on one, and whichever thread holds the player lock on the other. If
+// the ring is full, the tick's events are dropped and counted as an overflow.
+//
+// The output thread owns the list of sustained notes. The OSC device and MIDI
+// mode in Player are only changed between player_output_lock() and
+// player_output_unlock(), which wait for the ring to drain first.
+typedef enum {
+  Outmsg_tick,        // Events from one tick
+  Outmsg_midi_byte,   // Like start, stop or beat clock
+  Outmsg_osc_control, // OSC message with no arguments
+  Outmsg_osc_num,     // OSC message with one number
+  Outmsg_stop_notes,  // Note-offs for every sustained note
+} Outmsg_type;
+
+typedef struct {
+  Outmsg_type type;
+  U64 stamp;               // stm_now() when it was published
+  U64 due_ns;              // When it should be heard, on clock_now_ns()
+  double secs;             // Tick: time since the last one, for sustains
+  Usz bpm;                 // Tick: for working out sustain lengths
+  I32 num;                 // MIDI byte or OSC number
+  char const *osc_address; // Must be a string literal
+  Oevent_list oevent_list; // Tick. Reused each time around the ring.
+} Outmsg;
+
+enum { Output_ring_size = 64 }; // Must be a power of 2
+
+typedef struct {
+  Outmsg ring[Output_ring_size];
+  // Running counts, used as indices into the ring. `published` is only written
+  // with the player lock held, and `consumed` only by the output thread.
+  Usz published, consumed;
+  bool output_is_waiting;
+  double dropped_secs; // Time from ticks that didn't fit in the ring
+  pthread_mutex_t lock; // Held by the output thread while it sends
+  pthread_cond_t wake_cond, drained_cond;
+  pthread_t thread;
+  bool has_thread, quit;
+  Susnote_list susnote_list;
+  Oevent_out_list out_list; // Scratch space for send_output_events()
+  U64 last_due_ns; // PortMidi wants timestamps that never go backwards
+  // Each message from the ring, like a whole tick, goes out as one OSC bundle
+  // (or more, if it's too big for a datagram) instead of a datagram for each
+  // OSC message in it. Only set before anything is published.
+  bool osc_bundles;
+  // `overflows` is written with the player lock held, the rest by the output
+  // thread.
+  Player_output_stats stats;
+} Player_output;
+
+// Ticks are run by a clock thread, which sleeps until each one is due with
+// clock_nanosleep() on CLOCK_MONOTONIC, instead of by the UI thread between
+// input events. Each deadline is worked out from the one before it, not from
+// when the last tick actually ran, so being woken up late now and then doesn't
+// add up to drift.
+//
+// Everything in Player other than `output` is only touched with `lock` held.
+// The UI thread has it all the time, except while it waits for input or writes
+// to the terminal. After running a tick, if `wants_wakeups` is set, the clock
+// thread writes a byte to `wake_fds[1]`, so that the UI thread wakes up and
+// draws it.
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake_cond; // Signaled when playing starts, and to quit
+  pthread_t thread;
+  bool has_thread, quit;
+  bool ui_is_waiting; // For the lock, set and cleared by the UI thread
+  bool wants_wakeups;
+  int wake_fds[2];
+  // When the last tick or MIDI beat clock pulse was due, in nanoseconds, plus
+  // the part of a nanosecond left over from working it out.
+  U64 last_deadline_ns, deadline_frac;
+  U64 spin_ns; // Spin instead of sleeping for this long before a deadline
+  Player_clock_stats stats;
+} Player_clock;
+
+typedef struct {
+  Field field;
+  Mbuf_reusable mbuf_r;
+  Live_index live_index;
+  Orca_vm vm;
+  Orca_band_pool band_pool;
+  Orca_checkpoints checkpoints;
+  Oevent_list oevent_list;
+  Oevent_list scratch_oevent_list;
+  Player_output output;
+  Player_clock clock;
+  Oosc_dev *oosc_dev;
+  Midi_mode midi_mode;
+  Usz tick_num;
+  // Every tick run on `field` by player_step() or the clock. Unlike
+  // `tick_num`, this only ever goes up.
+  U64 ticks_run;
+  Usz bpm;
+  Usz activity_counter;
+  Usz random_seed;
+  U8 midi_bclock_sixths; // 0..5, holds 6th of the quarter note step
+  bool is_playing;
+  bool midi_bclock;
+  // Set after each tick is run, for whatever shows the grid. The marks in
+  // `mbuf_r` are then the ones from running it.
+  bool has_new_tick;
+} Player;
+
+// Starts the clock and output threads. If a thread can't be started, the work
+// is done without it, by player_clock_timeout_ms() and by the thread that
+// hands over the output.
+void player_init(Player *pl, Usz init_bpm, Usz init_seed, Usz band_threads,
+                 bool strict_timing);
+// Mustn't be called with the lock held.
+void player_deinit(Player *pl);
+
+// For threads other than the clock thread.
+void player_lock(Player *pl);
+void player_unlock(Player *pl);
+
+// Waits for everything published so far to be sent, and keeps the output
+// thread from sending anything else until player_output_unlock().
+void player_output_lock(Player *pl);
+void player_output_unlock(Player *pl);
+// Beat clock bytes are dropped if the ring is full, and are timed by the clock
+// like ticks are. Others aren't.
+void player_output_midi_byte(Player *pl, int byte);
+void player_output_osc(Player *pl, char const *osc_address);
+void player_send_osc_bpm(Player *pl, I32 bpm);
+void player_stop_all_sustained_notes(Player *pl);
+Player_output_stats player_output_stats(Player const *pl);
+
+void player_set_playing(Player *pl, bool playing);
+// Runs one tick right away, without sending its output, for stepping through
+// a grid while it's paused.
+void player_step(Player *pl);
+// Called with the lock held, by a thread waiting on something else, like
+// input. Returns how long it should wait before calling this again, in
+// milliseconds, at most `max_ms`. If there's no clock thread, this runs the
+// ticks that are due.
+int player_clock_timeout_ms(Player *pl, int max_ms);
+
+// Splits "host:port", "[v6 address]:port" or just "port". `host` is set to
+// the empty string if there's no host.
+bool split_udp_dest(char const *spec, char *host, Usz host_size,
+                    char const **out_port);
+
+void player_clear_osc_udp(Player *pl);
+bool player_set_osc_udp(Player *pl, char const *dest_addr,
+                        char const *dest_port);
+// Adds another place to send OSC output to, as well as the one set with
+// player_set_osc_udp(). `spec` is "host:port", "[v6 address]:port" or just
+// "port".
+bool player_add_osc_udp_dest(Player *pl, char const *spec);
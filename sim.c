@@ -5,12 +5,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-
-// stored unique random value
-Usz last_random_unique = UINT_MAX;
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // Note Sequence
-static char note_sequence[] = "CcDdEFfGgAaB";
+static char const note_sequence[] = "CcDdEFfGgAaB";
 
 Usz find_note_index(Glyph root_note_glyph) {
   for (Usz i = 0; i < sizeof(note_sequence) - 1; i++) {
@@ -93,11 +95,40 @@ typedef struct {
   Glyph *vars_slots;
   Oevent_list *oevent_list;
   Usz random_seed;
+  Orca_vm *vm;
+  Live_index *live_index;
+  Usz band_y1;       // Rows from here down belong to another band
+  bool band_escaped; // Something tried to reach them
+  bool marks_only;   // Don't change anything but the marks. See orca_mark_rows
 } Oper_extra_params;
 
+static ORCA_FORCEINLINE void live_index_set_cell(Live_index *li, Usz y, Usz x,
+                                                 Glyph g) {
+  if (!li)
+    return;
+  U64 *word = li->bits + y * li->row_words + (x >> 6);
+  U64 bit = (U64)1 << (x & 63);
+  if (g != '.')
+    *word |= bit;
+  else
+    *word &= ~bit;
+}
+
+static inline void oper_poke(Glyph *restrict gbuffer, Live_index *live_index,
+                             Usz height, Usz width, Usz y, Usz x, Isz delta_y,
+                             Isz delta_x, Glyph g) {
+  Isz y0 = (Isz)y + delta_y;
+  Isz x0 = (Isz)x + delta_x;
+  if (y0 < 0 || x0 < 0 || (Usz)y0 >= height || (Usz)x0 >= width)
+    return;
+  gbuffer[(Usz)y0 * width + (Usz)x0] = g;
+  live_index_set_cell(live_index, (Usz)y0, (Usz)x0, g);
+}
+
 static void oper_poke_and_stun(Glyph *restrict gbuffer, Mark *restrict mbuffer,
-                               Usz height, Usz width, Usz y, Usz x, Isz delta_y,
-                               Isz delta_x, Glyph g) {
+                               Live_index *live_index, Usz height, Usz width,
+                               Usz y, Usz x, Isz delta_y, Isz delta_x,
+                               Glyph g) {
   Isz y0 = (Isz)y + delta_y;
   Isz x0 = (Isz)x + delta_x;
   if (y0 < 0 || x0 < 0 || (Usz)y0 >= height || (Usz)x0 >= width)
@@ -105,12 +136,14 @@ static void oper_poke_and_stun(Glyph *restrict gbuffer, Mark *restrict mbuffer,
   Usz offs = (Usz)y0 * width + (Usz)x0;
   gbuffer[offs] = g;
   mbuffer[offs] |= Mark_flag_sleep;
+  live_index_set_cell(live_index, (Usz)y0, (Usz)x0, g);
 }
 
 // For anyone editing this in the future: the "no inline" here is deliberate.
 // You may think that inlining is always faster. Or even just letting the
-// compiler decide. You would be wrong. Try it. If you really want this VM to
-// run faster, you will need to use computed goto or assembly.
+// compiler decide. You would be wrong. Try it. The operators are dispatched
+// with computed goto by orca_run_threaded(), unless built with
+// FEAT_SWITCH_DISPATCH -- see ORCA_THREADED_DISPATCH.
 #define OPER_FUNCTION_ATTRIBS ORCA_NOINLINE static void
 
 #define BEGIN_OPERATOR(_oper_name)                                             \
@@ -135,14 +168,22 @@ static void oper_poke_and_stun(Glyph *restrict gbuffer, Mark *restrict mbuffer,
 #define PEEK(_delta_y, _delta_x)                                               \
   gbuffer_peek_relative(gbuffer, height, width, y, x, _delta_y, _delta_x)
 #define POKE(_delta_y, _delta_x, _glyph)                                       \
-  gbuffer_poke_relative(gbuffer, height, width, y, x, _delta_y, _delta_x,      \
-                        _glyph)
+  do {                                                                         \
+    if (!extra_params->marks_only)                                             \
+      oper_poke(gbuffer, extra_params->live_index, height, width, y, x,        \
+                _delta_y, _delta_x, _glyph);                                   \
+  } while (0)
 #define STUN(_delta_y, _delta_x)                                               \
   mbuffer_poke_relative_flags_or(mbuffer, height, width, y, x, _delta_y,       \
                                  _delta_x, Mark_flag_sleep)
 #define POKE_STUNNED(_delta_y, _delta_x, _glyph)                               \
-  oper_poke_and_stun(gbuffer, mbuffer, height, width, y, x, _delta_y,          \
-                     _delta_x, _glyph)
+  do {                                                                         \
+    if (extra_params->marks_only)                                              \
+      STUN(_delta_y, _delta_x);                                                \
+    else                                                                       \
+      oper_poke_and_stun(gbuffer, mbuffer, extra_params->live_index, height,   \
+                         width, y, x, _delta_y, _delta_x, _glyph);             \
+  } while (0)
 #define LOCK(_delta_y, _delta_x)                                               \
   mbuffer_poke_relative_flags_or(mbuffer, height, width, y, x, _delta_y,       \
                                  _delta_x, Mark_flag_lock)
@@ -161,6 +202,29 @@ static void oper_poke_and_stun(Glyph *restrict gbuffer, Mark *restrict mbuffer,
   if (!oper_has_neighboring_bang(gbuffer, height, width, y, x))                \
   return
 
+// For operators that have set all of their marks by this point, and only make
+// events or change their own state after it.
+#define STOP_IF_MARKS_ONLY                                                     \
+  if (extra_params->marks_only)                                                \
+  return
+
+// When the grid is run in bands, the operators whose reach depends on their
+// inputs check that they're staying in their own band before going further
+// down than the row below them. See orca_run_bands().
+static ORCA_FORCEINLINE bool oper_leaves_band(Oper_extra_params *extra_params,
+                                              Usz height, Usz y,
+                                              Usz delta_y) {
+  Usz y0 = y + delta_y;
+  if (ORCA_LIKELY(y0 < extra_params->band_y1 || y0 >= height))
+    return false;
+  extra_params->band_escaped = true;
+  return true;
+}
+
+#define STOP_IF_OUTSIDE_BAND(_delta_y)                                         \
+  if (oper_leaves_band(extra_params, height, y, (Usz)(_delta_y)))              \
+  return
+
 #define PORT(_delta_y, _delta_x, _flags)                                       \
   mbuffer_poke_relative_flags_or(mbuffer, height, width, y, x, _delta_y,       \
                                  _delta_x, (_flags) ^ Mark_flag_lock)
@@ -239,14 +303,23 @@ BEGIN_OPERATOR(movement)
   Isz y0 = (Isz)y + delta_y;
   Isz x0 = (Isz)x + delta_x;
   if (y0 >= (Isz)height || x0 >= (Isz)width || y0 < 0 || x0 < 0) {
-    gbuffer[y * width + x] = '*';
+    if (!extra_params->marks_only)
+      gbuffer[y * width + x] = '*';
     return;
   }
   Glyph *restrict g_at_dest = gbuffer + (Usz)y0 * width + (Usz)x0;
+  if (extra_params->marks_only) {
+    if (*g_at_dest == '.')
+      mbuffer[(Usz)y0 * width + (Usz)x0] |= Mark_flag_sleep;
+    return;
+  }
   if (*g_at_dest == '.') {
     *g_at_dest = This_oper_char;
     gbuffer[y * width + x] = '.';
     mbuffer[(Usz)y0 * width + (Usz)x0] |= Mark_flag_sleep;
+    live_index_set_cell(extra_params->live_index, (Usz)y0, (Usz)x0,
+                        This_oper_char);
+    live_index_set_cell(extra_params->live_index, y, x, '.');
   } else {
     gbuffer[y * width + x] = '*';
   }
@@ -464,6 +537,7 @@ BEGIN_OPERATOR(midicc)
   if (channel > 15)
     return;
   PORT(0, 0, OUT);
+  STOP_IF_MARKS_ONLY;
   Oevent_midi_cc *oe =
       (Oevent_midi_cc *)oevent_list_alloc_item(extra_params->oevent_list);
   oe->oevent_type = Oevent_type_midi_cc;
@@ -488,7 +562,10 @@ BEGIN_OPERATOR(comment)
 END_OPERATOR
 
 BEGIN_OPERATOR(bang)
+  if (extra_params->marks_only)
+    return;
   gbuffer_poke(gbuffer, height, width, y, x, '.');
+  live_index_set_cell(extra_params->live_index, y, x, '.');
 END_OPERATOR
 
 BEGIN_OPERATOR(midi)
@@ -524,6 +601,7 @@ BEGIN_OPERATOR(midi)
       vel_num = 127;
   }
   PORT(0, 0, OUT);
+  STOP_IF_MARKS_ONLY;
   Oevent_midi_note *oe =
       (Oevent_midi_note *)oevent_list_alloc_item(extra_params->oevent_list);
   oe->oevent_type = (U8)Oevent_type_midi_note;
@@ -593,78 +671,78 @@ END_OPERATOR
 // BOORCH's MIDIChord operator
 
 // First, define each chord array:
-static Usz chord_minor[] = {0, 3, 7};
-static Usz chord_major[] = {0, 4, 7};
-static Usz chord_minor7[] = {0, 3, 7, 10};
-static Usz chord_major7[] = {0, 4, 7, 11};
-static Usz chord_minor9[] = {0, 3, 7, 10, 14};
-static Usz chord_major9[] = {0, 4, 7, 11, 14};
-static Usz chord_dom7[] = {0, 4, 7, 10};
-static Usz chord_minor6[] = {0, 3, 7, 9};
-static Usz chord_major6[] = {0, 4, 7, 9};
-static Usz chord_sus2[] = {0, 2, 7};
-static Usz chord_sus4[] = {0, 5, 7};
-static Usz chord_minor_add9[] = {0, 3, 7, 14};
-static Usz chord_major_add9[] = {0, 4, 7, 14};
-static Usz chord_aug[] = {0, 4, 8};
-static Usz chord_aug7[] = {0, 4, 8, 10};
-static Usz chord_min_maj7[] = {0, 3, 7, 11};
-static Usz chord_dim[] = {0, 3, 6};
-static Usz chord_dim7[] = {0, 3, 6, 9};
-static Usz chord_half_dim[] = {0, 3, 6, 10};
-static Usz chord_min_6_9[] = {0, 3, 7, 9, 14};
-static Usz chord_maj_6_9[] = {0, 4, 7, 9, 14};
-static Usz chord_minor_first_inv[] = {0, 3, 10};
-static Usz chord_major_first_inv[] = {0, 4, 11};
-static Usz chord_minor_second_inv[] = {0, 3, 7, 12};
-static Usz chord_major_second_inv[] = {0, 4, 7, 12};
-static Usz chord_min7b5[] = {0, 3, 6, 11};
-static Usz chord_min11[] = {0, 3, 7, 10, 20};
-static Usz chord_dom9[] = {0, 4, 7, 10, 14};
-static Usz chord_dom7b9[] = {0, 4, 7, 10, 15};
-static Usz chord_dom7sharp9[] = {0, 4, 7, 10, 17};
-static Usz chord_maj7sharp11[] = {0, 4, 7, 11, 23};
-static Usz chord_min_add11[] = {0, 3, 7, 14, 20};
+static Usz const chord_minor[] = {0, 3, 7};
+static Usz const chord_major[] = {0, 4, 7};
+static Usz const chord_minor7[] = {0, 3, 7, 10};
+static Usz const chord_major7[] = {0, 4, 7, 11};
+static Usz const chord_minor9[] = {0, 3, 7, 10, 14};
+static Usz const chord_major9[] = {0, 4, 7, 11, 14};
+static Usz const chord_dom7[] = {0, 4, 7, 10};
+static Usz const chord_minor6[] = {0, 3, 7, 9};
+static Usz const chord_major6[] = {0, 4, 7, 9};
+static Usz const chord_sus2[] = {0, 2, 7};
+static Usz const chord_sus4[] = {0, 5, 7};
+static Usz const chord_minor_add9[] = {0, 3, 7, 14};
+static Usz const chord_major_add9[] = {0, 4, 7, 14};
+static Usz const chord_aug[] = {0, 4, 8};
+static Usz const chord_aug7[] = {0, 4, 8, 10};
+static Usz const chord_min_maj7[] = {0, 3, 7, 11};
+static Usz const chord_dim[] = {0, 3, 6};
+static Usz const chord_dim7[] = {0, 3, 6, 9};
+static Usz const chord_half_dim[] = {0, 3, 6, 10};
+static Usz const chord_min_6_9[] = {0, 3, 7, 9, 14};
+static Usz const chord_maj_6_9[] = {0, 4, 7, 9, 14};
+static Usz const chord_minor_first_inv[] = {0, 3, 10};
+static Usz const chord_major_first_inv[] = {0, 4, 11};
+static Usz const chord_minor_second_inv[] = {0, 3, 7, 12};
+static Usz const chord_major_second_inv[] = {0, 4, 7, 12};
+static Usz const chord_min7b5[] = {0, 3, 6, 11};
+static Usz const chord_min11[] = {0, 3, 7, 10, 20};
+static Usz const chord_dom9[] = {0, 4, 7, 10, 14};
+static Usz const chord_dom7b9[] = {0, 4, 7, 10, 15};
+static Usz const chord_dom7sharp9[] = {0, 4, 7, 10, 17};
+static Usz const chord_maj7sharp11[] = {0, 4, 7, 11, 23};
+static Usz const chord_min_add11[] = {0, 3, 7, 14, 20};
 
 // Then create an array-of-pointers to these chord arrays:
-static Usz *chords[] = {chord_minor,
-                        chord_major,
-                        chord_minor7,
-                        chord_major7,
-                        chord_minor9,
-                        chord_major9,
-                        chord_dom7,
-                        chord_minor6,
-                        chord_major6,
-                        chord_sus2,
-                        chord_sus4,
-                        chord_minor_add9,
-                        chord_major_add9,
-                        chord_aug,
-                        chord_aug7,
-                        chord_min_maj7,
-                        chord_dim,
-                        chord_dim7,
-                        chord_half_dim,
-                        chord_min_6_9,
-                        chord_maj_6_9,
-                        chord_minor_first_inv,
-                        chord_major_first_inv,
-                        chord_minor_second_inv,
-                        chord_major_second_inv,
-                        chord_min7b5,
-                        chord_min11,
-                        chord_dom9,
-                        chord_dom7b9,
-                        chord_dom7sharp9,
-                        chord_maj7sharp11,
-                        chord_min_add11};
+static Usz const *const chords[] = {chord_minor,
+                                    chord_major,
+                                    chord_minor7,
+                                    chord_major7,
+                                    chord_minor9,
+                                    chord_major9,
+                                    chord_dom7,
+                                    chord_minor6,
+                                    chord_major6,
+                                    chord_sus2,
+                                    chord_sus4,
+                                    chord_minor_add9,
+                                    chord_major_add9,
+                                    chord_aug,
+                                    chord_aug7,
+                                    chord_min_maj7,
+                                    chord_dim,
+                                    chord_dim7,
+                                    chord_half_dim,
+                                    chord_min_6_9,
+                                    chord_maj_6_9,
+                                    chord_minor_first_inv,
+                                    chord_major_first_inv,
+                                    chord_minor_second_inv,
+                                    chord_major_second_inv,
+                                    chord_min7b5,
+                                    chord_min11,
+                                    chord_dom9,
+                                    chord_dom7b9,
+                                    chord_dom7sharp9,
+                                    chord_maj7sharp11,
+                                    chord_min_add11};
 
 // Optionally, you could define how many chord arrays there are:
 static const size_t num_chords = sizeof(chords) / sizeof(chords[0]);
 
 // Chord lengths array matching the order of chords array
-static Usz chord_lengths[] = {
+static Usz const chord_lengths[] = {
     3, // chord_minor
     3, // chord_major
     4, // chord_minor7
@@ -706,6 +784,7 @@ BEGIN_OPERATOR(midichord)
   }
   PORT(0, 0, OUT); // Mark output immediately
   STOP_IF_NOT_BANGED;
+  STOP_IF_MARKS_ONLY;
 
   // Get chord type first to validate range
   Usz chord_idx = index_of(PEEK(0, 4));
@@ -738,7 +817,7 @@ BEGIN_OPERATOR(midichord)
     return;
 
   // Get pointer to the selected chord array and its length
-  Usz *chord = chords[chord_idx];
+  Usz const *chord = chords[chord_idx];
   Usz chord_len = chord_lengths[chord_idx];
 
   // Track highest note played so far
@@ -786,6 +865,7 @@ BEGIN_OPERATOR(midipb)
   }
   PORT(0, 0, OUT); // Mark output immediately
   STOP_IF_NOT_BANGED;
+  STOP_IF_MARKS_ONLY;
   Glyph channel_g = PEEK(0, 1);
   Glyph msb_g = PEEK(0, 2);
   Glyph lsb_g = PEEK(0, 3);
@@ -872,6 +952,7 @@ BEGIN_OPERATOR(generator)
   Isz out_x = (Isz)index_of(PEEK(0, -3));
   Isz out_y = (Isz)index_of(PEEK(0, -2)) + 1;
   Isz len = (Isz)index_of(PEEK(0, -1));
+  STOP_IF_OUTSIDE_BAND(out_y);
   PORT(0, -3, IN | PARAM); // x
   PORT(0, -2, IN | PARAM); // y
   PORT(0, -1, IN | PARAM); // len
@@ -907,13 +988,16 @@ BEGIN_OPERATOR(increment)
   POKE(1, 0, glyph_with_case(glyph_of(val), gb));
 END_OPERATOR
 
+enum { Jump_max_distance = 256 };
+
 BEGIN_OPERATOR(jump)
   LOWERCASE_REQUIRES_BANG;
   Glyph g = PEEK(-1, 0);
   if (g == This_oper_char)
     return;
   PORT(-1, 0, IN);
-  for (Isz i = 1; i <= 256; ++i) {
+  for (Isz i = 1; i <= Jump_max_distance; ++i) {
+    STOP_IF_OUTSIDE_BAND(i);
     if (PEEK(i, 0) != This_oper_char) {
       PORT(i, 0, OUT);
       POKE(i, 0, g);
@@ -975,6 +1059,7 @@ BEGIN_OPERATOR(offset)
   LOWERCASE_REQUIRES_BANG;
   Isz in_x = (Isz)index_of(PEEK(0, -2)) + 1;
   Isz in_y = (Isz)index_of(PEEK(0, -1));
+  STOP_IF_OUTSIDE_BAND(in_y);
   PORT(0, -1, IN | PARAM);
   PORT(0, -2, IN | PARAM);
   PORT(in_y, in_x, IN);
@@ -1008,6 +1093,7 @@ BEGIN_OPERATOR(query)
   Isz in_x = (Isz)index_of(PEEK(0, -1)) + 1;
 
   Isz out_x = 1 - len;
+  STOP_IF_OUTSIDE_BAND(in_y);
 
   // Mark parameter ports in new order
   PORT(0, -3, IN | PARAM); // len
@@ -1138,6 +1224,7 @@ BEGIN_OPERATOR(teleport)
   // If either offset is '.', treat as 0
   Usz out_y = out_y_g == '.' ? 0 : index_of(out_y_g);
   Usz out_x = out_x_g == '.' ? 0 : index_of(out_x_g);
+  STOP_IF_OUTSIDE_BAND(out_y);
 
   // Validate offsets based on the rules:
 
@@ -1204,62 +1291,62 @@ END_OPERATOR
 // BOORCH's new Scale OP
 
 // Scale intervals with base36 (Orca) to decimal conversion for C
-static Usz minor_scale[] = {0, 2, 3, 5, 7, 8, 10};            // "023578a"
-static Usz major_scale[] = {0, 2, 4, 5, 7, 9, 11};            // "024579b"
-static Usz minor_pentatonic_scale[] = {0, 3, 5, 7, 10};       // "0357a"
-static Usz major_pentatonic_scale[] = {0, 2, 4, 7, 9};        // "02479"
-static Usz blues_minor_scale[] = {0, 3, 5, 6, 7, 10};         // "03567a"
-static Usz blues_major_scale[] = {0, 2, 3, 4, 7, 9};          // "023479"
-static Usz phrygian_scale[] = {0, 1, 3, 5, 7, 8, 10};         // "013578a"
-static Usz lydian_scale[] = {0, 2, 4, 6, 7, 9, 11};           // "024679b"
-static Usz locrian_scale[] = {0, 1, 3, 5, 6, 8, 10};          // "013568a"
-static Usz super_locrian_scale[] = {0, 1, 3, 4, 6, 8, 10};    // "013468a"
-static Usz neapolitan_minor_scale[] = {0, 1, 3, 5, 7, 8, 11}; // "013578b"
-static Usz neapolitan_major_scale[] = {0, 1, 3, 5, 7, 9, 11}; // "013579b"
-static Usz hex_phrygian_scale[] = {0, 1, 3, 5, 8, 10};        // "01358a"
-static Usz whole_scale[] = {0, 2, 4, 6, 8, 10};               // "02468a"
-static Usz diminished_scale[] = {0, 1, 3, 4, 6, 7, 9, 10};    // "0134679a"
-static Usz pelog_scale[] = {0, 1, 3, 7, 8};                   // "01378"
-static Usz spanish_scale[] = {0, 1, 4, 5, 7, 8, 10};          // "014578a"
-static Usz bhairav_scale[] = {0, 1, 4, 5, 7, 8, 11};          // "014578b"
-static Usz ahirbhairav_scale[] = {0, 1, 4, 5, 7, 9, 10};      // "014579a"
-static Usz augmented2_scale[] = {0, 1, 4, 5, 8, 9};           // "014589"
-static Usz purvi_scale[] = {0, 1, 4, 6, 7, 8, 11};            // "014678b"
-static Usz marva_scale[] = {0, 1, 4, 6, 7, 9, 11};            // "014679b"
-static Usz enigmatic_scale[] = {0, 1, 4, 6, 8, 10, 11};       // "01468ab"
-static Usz scriabin_scale[] = {0, 1, 4, 7, 9};                // "01479"
-static Usz indian_scale[] = {0, 4, 5, 7, 10};                 // "0457a"
+static Usz const minor_scale[] = {0, 2, 3, 5, 7, 8, 10};            // "023578a"
+static Usz const major_scale[] = {0, 2, 4, 5, 7, 9, 11};            // "024579b"
+static Usz const minor_pentatonic_scale[] = {0, 3, 5, 7, 10};       // "0357a"
+static Usz const major_pentatonic_scale[] = {0, 2, 4, 7, 9};        // "02479"
+static Usz const blues_minor_scale[] = {0, 3, 5, 6, 7, 10};         // "03567a"
+static Usz const blues_major_scale[] = {0, 2, 3, 4, 7, 9};          // "023479"
+static Usz const phrygian_scale[] = {0, 1, 3, 5, 7, 8, 10};         // "013578a"
+static Usz const lydian_scale[] = {0, 2, 4, 6, 7, 9, 11};           // "024679b"
+static Usz const locrian_scale[] = {0, 1, 3, 5, 6, 8, 10};          // "013568a"
+static Usz const super_locrian_scale[] = {0, 1, 3, 4, 6, 8, 10};    // "013468a"
+static Usz const neapolitan_minor_scale[] = {0, 1, 3, 5, 7, 8, 11}; // "013578b"
+static Usz const neapolitan_major_scale[] = {0, 1, 3, 5, 7, 9, 11}; // "013579b"
+static Usz const hex_phrygian_scale[] = {0, 1, 3, 5, 8, 10};        // "01358a"
+static Usz const whole_scale[] = {0, 2, 4, 6, 8, 10};               // "02468a"
+static Usz const diminished_scale[] = {0, 1, 3, 4, 6, 7, 9, 10};    // "0134679a"
+static Usz const pelog_scale[] = {0, 1, 3, 7, 8};                   // "01378"
+static Usz const spanish_scale[] = {0, 1, 4, 5, 7, 8, 10};          // "014578a"
+static Usz const bhairav_scale[] = {0, 1, 4, 5, 7, 8, 11};          // "014578b"
+static Usz const ahirbhairav_scale[] = {0, 1, 4, 5, 7, 9, 10};      // "014579a"
+static Usz const augmented2_scale[] = {0, 1, 4, 5, 8, 9};           // "014589"
+static Usz const purvi_scale[] = {0, 1, 4, 6, 7, 8, 11};            // "014678b"
+static Usz const marva_scale[] = {0, 1, 4, 6, 7, 9, 11};            // "014679b"
+static Usz const enigmatic_scale[] = {0, 1, 4, 6, 8, 10, 11};       // "01468ab"
+static Usz const scriabin_scale[] = {0, 1, 4, 7, 9};                // "01479"
+static Usz const indian_scale[] = {0, 4, 5, 7, 10};                 // "0457a"
 
 // Scale array pointers matching the order above
-static Usz *scales[] = {minor_scale,
-                        major_scale,
-                        minor_pentatonic_scale,
-                        major_pentatonic_scale,
-                        blues_minor_scale,
-                        blues_major_scale,
-                        phrygian_scale,
-                        lydian_scale,
-                        locrian_scale,
-                        super_locrian_scale,
-                        neapolitan_minor_scale,
-                        neapolitan_major_scale,
-                        hex_phrygian_scale,
-                        whole_scale,
-                        diminished_scale,
-                        pelog_scale,
-                        spanish_scale,
-                        bhairav_scale,
-                        ahirbhairav_scale,
-                        augmented2_scale,
-                        purvi_scale,
-                        marva_scale,
-                        enigmatic_scale,
-                        scriabin_scale,
-                        indian_scale};
+static Usz const *const scales[] = {minor_scale,
+                                    major_scale,
+                                    minor_pentatonic_scale,
+                                    major_pentatonic_scale,
+                                    blues_minor_scale,
+                                    blues_major_scale,
+                                    phrygian_scale,
+                                    lydian_scale,
+                                    locrian_scale,
+                                    super_locrian_scale,
+                                    neapolitan_minor_scale,
+                                    neapolitan_major_scale,
+                                    hex_phrygian_scale,
+                                    whole_scale,
+                                    diminished_scale,
+                                    pelog_scale,
+                                    spanish_scale,
+                                    bhairav_scale,
+                                    ahirbhairav_scale,
+                                    augmented2_scale,
+                                    purvi_scale,
+                                    marva_scale,
+                                    enigmatic_scale,
+                                    scriabin_scale,
+                                    indian_scale};
 
 // Scale lengths matching the order above
-static Usz scale_lengths[] = {7, 7, 5, 5, 6, 6, 7, 7, 7, 7, 7, 7, 6,
-                              6, 8, 5, 7, 7, 7, 6, 7, 7, 7, 5, 5};
+static Usz const scale_lengths[] = {7, 7, 5, 5, 6, 6, 7, 7, 7, 7, 7, 7, 6, 6, 8,
+                                    5, 7, 7, 7, 6, 7, 7, 7, 5, 5};
 
 BEGIN_OPERATOR(scale)
   PORT(0, 1, IN);   // Octave input
@@ -1344,6 +1431,7 @@ BEGIN_OPERATOR(midipoly)
   }
   PORT(0, 0, OUT); // Mark output immediately
   STOP_IF_NOT_BANGED;
+  STOP_IF_MARKS_ONLY;
   Glyph channel_g = PEEK(0, 1);
   Glyph octave_g = PEEK(0, 2);
   Glyph note_gs[3] = {PEEK(0, 3), PEEK(0, 4), PEEK(0, 5)};
@@ -1401,42 +1489,44 @@ END_OPERATOR
 
 // BOORCH's new MidiArpeggiator
 // Arpeggio patterns
-static Usz arp00[] = {1, 2, 3};          // up
-static Usz arp01[] = {3, 2, 1};          // down
-static Usz arp02[] = {1, 3, 2};          // converge up
-static Usz arp03[] = {3, 1, 2};          // converge down
-static Usz arp04[] = {2, 1, 3};          // diverge up
-static Usz arp05[] = {2, 3, 1};          // diverge down
-static Usz arp06[] = {1, 2, 3, 2};       // up bounce triangle
-static Usz arp07[] = {3, 2, 1, 2};       // down bounce triangle
-static Usz arp08[] = {1, 2, 3, 3, 2, 1}; // up bounce sine
-static Usz arp09[] = {3, 2, 1, 1, 2, 3}; // down bounce sine
-static Usz arp10[] = {1, 2, 3, 0};       // up with rest
-static Usz arp11[] = {3, 2, 1, 0};       // down with rest
-static Usz arp12[] = {1, 3, 2, 0};       // converge up with rest
-static Usz arp13[] = {3, 1, 2, 0};       // converge down with rest
-static Usz arp14[] = {2, 1, 3, 0};       // diverge up with rest
-static Usz arp15[] = {2, 3, 1, 0};       // diverge down with rest
-static Usz arp16[] = {1, 2, 3, 2, 0};    // up bounce triangle with rest
-static Usz arp17[] = {3, 2, 1, 2, 0};    // down bounce triangle with rest
-static Usz arp18[] = {1, 0, 2, 3, 0};    // riff
-static Usz arp19[] = {1, 0, 3, 2, 0};    // riff
-static Usz arp20[] = {1, 2, 0, 3, 0};    // riff
-static Usz arp21[] = {1, 3, 0, 2, 0};    // riff
-static Usz arp22[] = {1, 2, 0, 1, 3};    // riff
-static Usz arp23[] = {1, 3, 0, 1, 2};    // riff
-static Usz arp24[] = {1, 2, 0, 1, 3, 0}; // riff
-static Usz arp25[] = {1, 0, 2, 1, 0, 3}; // riff
-static Usz arp26[] = {1, 0, 3, 1, 0, 2}; // riff
+static Usz const arp00[] = {1, 2, 3};          // up
+static Usz const arp01[] = {3, 2, 1};          // down
+static Usz const arp02[] = {1, 3, 2};          // converge up
+static Usz const arp03[] = {3, 1, 2};          // converge down
+static Usz const arp04[] = {2, 1, 3};          // diverge up
+static Usz const arp05[] = {2, 3, 1};          // diverge down
+static Usz const arp06[] = {1, 2, 3, 2};       // up bounce triangle
+static Usz const arp07[] = {3, 2, 1, 2};       // down bounce triangle
+static Usz const arp08[] = {1, 2, 3, 3, 2, 1}; // up bounce sine
+static Usz const arp09[] = {3, 2, 1, 1, 2, 3}; // down bounce sine
+static Usz const arp10[] = {1, 2, 3, 0};       // up with rest
+static Usz const arp11[] = {3, 2, 1, 0};       // down with rest
+static Usz const arp12[] = {1, 3, 2, 0};       // converge up with rest
+static Usz const arp13[] = {3, 1, 2, 0};       // converge down with rest
+static Usz const arp14[] = {2, 1, 3, 0};       // diverge up with rest
+static Usz const arp15[] = {2, 3, 1, 0};       // diverge down with rest
+static Usz const arp16[] = {1, 2, 3, 2, 0};    // up bounce triangle with rest
+static Usz const arp17[] = {3, 2, 1, 2, 0};    // down bounce triangle with rest
+static Usz const arp18[] = {1, 0, 2, 3, 0};    // riff
+static Usz const arp19[] = {1, 0, 3, 2, 0};    // riff
+static Usz const arp20[] = {1, 2, 0, 3, 0};    // riff
+static Usz const arp21[] = {1, 3, 0, 2, 0};    // riff
+static Usz const arp22[] = {1, 2, 0, 1, 3};    // riff
+static Usz const arp23[] = {1, 3, 0, 1, 2};    // riff
+static Usz const arp24[] = {1, 2, 0, 1, 3, 0}; // riff
+static Usz const arp25[] = {1, 0, 2, 1, 0, 3}; // riff
+static Usz const arp26[] = {1, 0, 3, 1, 0, 2}; // riff
 
 // Arpeggio pattern pointers
-static Usz *arpPatterns[] = {arp00, arp01, arp02, arp03, arp04, arp05, arp06,
-                             arp07, arp08, arp09, arp10, arp11, arp12, arp13,
-                             arp14, arp15, arp16, arp17, arp18, arp19, arp20,
-                             arp21, arp22, arp23, arp24, arp25, arp26};
+static Usz const *const arpPatterns[] = {arp00, arp01, arp02, arp03, arp04,
+                                         arp05, arp06, arp07, arp08, arp09,
+                                         arp10, arp11, arp12, arp13, arp14,
+                                         arp15, arp16, arp17, arp18, arp19,
+                                         arp20, arp21, arp22, arp23, arp24,
+                                         arp25, arp26};
 
 // Lengths of each arpeggio pattern
-static size_t arpPatternLengths[] = {
+static size_t const arpPatternLengths[] = {
     sizeof(arp00) / sizeof(arp00[0]), sizeof(arp01) / sizeof(arp01[0]),
     sizeof(arp02) / sizeof(arp02[0]), sizeof(arp03) / sizeof(arp03[0]),
     sizeof(arp04) / sizeof(arp04[0]), sizeof(arp05) / sizeof(arp05[0]),
@@ -1472,6 +1562,7 @@ BEGIN_OPERATOR(midiarpeggiator)
   PORT(0, 0, OUT); // Mark output immediately
 
   STOP_IF_NOT_BANGED;
+  STOP_IF_MARKS_ONLY;
 
   Usz arp_pattern_index = index_of(PEEK(0, -3));
   Usz current_position = index_of(PEEK(0, -2));
@@ -1533,7 +1624,7 @@ BEGIN_OPERATOR(midiarpeggiator)
     current_octave = 9;
 
   // Select the note to play from the pattern
-  Usz *current_pattern =
+  Usz const *current_pattern =
       arpPatterns[arp_pattern_index %
                   (sizeof(arpPatterns) / sizeof(arpPatterns[0]))];
   Usz note_to_play_index =
@@ -1585,26 +1676,23 @@ BEGIN_OPERATOR(midiarpeggiator)
 END_OPERATOR
 
 // BOORCH's new Random Unique
-#define MAX_SEQUENCE_SIZE 36 // For values 0-9 and A-Z
-
-typedef struct {
-  Usz sequence[MAX_SEQUENCE_SIZE];
-  Usz current_index;
-  Usz sequence_size;
-  bool initialized;
-  Usz last_min; // Add these to detect range changes
-  Usz last_max; // and force reinitialization
-} Unique_random_state;
-
-static Unique_random_state unique_random_state = {0};
+// xorshift32. Not good, but it only shuffles a few dozen values, and unlike
+// rand() it belongs to one VM.
+static U32 orca_vm_random(Orca_vm *vm) {
+  U32 x = vm->random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  vm->random_state = x;
+  return x;
+}
 
-static void shuffle_sequence(Usz *array, Usz n) {
+static void shuffle_sequence(Orca_vm *vm, Usz *array, Usz n) {
   if (n <= 1)
     return;
 
   for (Usz i = n - 1; i > 0; i--) {
-    // Use existing random generator from ORCA
-    Usz j = (Usz)(((U32)rand()) % (i + 1));
+    Usz j = (Usz)(orca_vm_random(vm) % (i + 1));
     // Swap
     Usz temp = array[i];
     array[i] = array[j];
@@ -1612,29 +1700,28 @@ static void shuffle_sequence(Usz *array, Usz n) {
   }
 }
 
-static void initialize_sequence(Usz min, Usz max) {
-  unique_random_state.sequence_size = (max >= min) ? (max - min + 1) : 0;
-  if (unique_random_state.sequence_size > MAX_SEQUENCE_SIZE) {
-    unique_random_state.sequence_size = MAX_SEQUENCE_SIZE;
+static void initialize_sequence(Orca_vm *vm, Usz min, Usz max) {
+  Unique_random_state *state = &vm->unique_random;
+  state->sequence_size = (max >= min) ? (max - min + 1) : 0;
+  if (state->sequence_size > Unique_random_sequence_max) {
+    state->sequence_size = Unique_random_sequence_max;
   }
 
   // Fill sequence with values from min to max
-  for (Usz i = 0; i < unique_random_state.sequence_size; i++) {
-    unique_random_state.sequence[i] = min + i;
+  for (Usz i = 0; i < state->sequence_size; i++) {
+    state->sequence[i] = min + i;
   }
 
-  shuffle_sequence(unique_random_state.sequence,
-                   unique_random_state.sequence_size);
-  unique_random_state.current_index = 0;
+  shuffle_sequence(vm, state->sequence, state->sequence_size);
+  state->current_index = 0;
 }
 
-void reset_last_unique_value(void) { unique_random_state.initialized = false; }
-
 BEGIN_OPERATOR(randomunique)
   LOWERCASE_REQUIRES_BANG;
   PORT(0, -1, IN | PARAM); // Min
   PORT(0, 1, IN);          // Max
   PORT(1, 0, OUT);         // Output
+  STOP_IF_MARKS_ONLY;
 
   Glyph min_glyph = PEEK(0, -1);
   Glyph max_glyph = PEEK(0, 1);
@@ -1653,25 +1740,24 @@ BEGIN_OPERATOR(randomunique)
   }
 
   // Initialize or reinitialize if needed
-  if (!unique_random_state.initialized ||
-      unique_random_state.current_index >= unique_random_state.sequence_size ||
-      min != unique_random_state.last_min ||
-      max != unique_random_state.last_max) {
-    initialize_sequence(min, max);
-    unique_random_state.initialized = true;
-    unique_random_state.last_min = min;
-    unique_random_state.last_max = max;
+  Orca_vm *vm = extra_params->vm;
+  Unique_random_state *state = &vm->unique_random;
+  if (!state->initialized || state->current_index >= state->sequence_size ||
+      min != state->last_min || max != state->last_max) {
+    initialize_sequence(vm, min, max);
+    state->initialized = true;
+    state->last_min = min;
+    state->last_max = max;
   }
 
   // Get next value from sequence
-  Usz result = unique_random_state.sequence[unique_random_state.current_index];
-  unique_random_state.current_index++;
+  Usz result = state->sequence[state->current_index];
+  state->current_index++;
 
   // Reshuffle if we've used all values
-  if (unique_random_state.current_index >= unique_random_state.sequence_size) {
-    shuffle_sequence(unique_random_state.sequence,
-                     unique_random_state.sequence_size);
-    unique_random_state.current_index = 0;
+  if (state->current_index >= state->sequence_size) {
+    shuffle_sequence(vm, state->sequence, state->sequence_size);
+    state->current_index = 0;
   }
 
   POKE(1, 0, glyph_of(result));
@@ -1679,7 +1765,7 @@ END_OPERATOR
 
 // BOORCH's BOUNCER OP
 // Predefined waveform sequences
-static const char *waveforms[] = {
+static char const *const waveforms[] = {
     // Triangle (0)
     "00112233445566778899aabbccddeeffgghhiijjkkllmmnnooppqqrrstuvwxyzzyxwvutsrr"
     "qqppoonnmmllkkjjiihhggffeeddccbbaa99887766554433221100",
@@ -1707,14 +1793,22 @@ static const char *waveforms[] = {
 
 #define WAVE_LENGTH 128
 
-typedef struct {
-  Usz current_index; // Current position in waveform
-  bool initialized;
-  Usz last_rate;  // Track rate changes
-  Usz last_shape; // Track shape changes
-} Bouncer_state;
-
-static Bouncer_state bouncer_states[4096] = {0};
+// Returns NULL, leaving the bouncers unallocated, if they couldn't be.
+static Bouncer_state *vm_bouncer_state(Orca_vm *vm, Usz height, Usz width,
+                                       Usz y, Usz x) {
+  if (!vm->bouncers || vm->bouncers_height != height ||
+      vm->bouncers_width != width) {
+    free(vm->bouncers);
+    vm->bouncers = calloc(height * width, sizeof(Bouncer_state));
+    if (!vm->bouncers) {
+      vm->bouncers_height = vm->bouncers_width = 0;
+      return NULL;
+    }
+    vm->bouncers_height = height;
+    vm->bouncers_width = width;
+  }
+  return vm->bouncers + y * width + x;
+}
 
 BEGIN_OPERATOR(bouncer)
   PORT(0, -2, IN | PARAM); // Start value (a)
@@ -1722,6 +1816,7 @@ BEGIN_OPERATOR(bouncer)
   PORT(0, 1, IN);          // Rate (ticks per cycle)
   PORT(0, 2, IN);          // Shape (0-7 for different waveforms)
   PORT(1, 0, OUT);
+  STOP_IF_MARKS_ONLY;
 
   Glyph start_g = PEEK(0, -2);
   Glyph end_g = PEEK(0, -1);
@@ -1731,8 +1826,10 @@ BEGIN_OPERATOR(bouncer)
   if (start_g == '.' || end_g == '.')
     return;
 
-  Usz state_idx = y * width + x;
-  Bouncer_state *state = &bouncer_states[state_idx];
+  Bouncer_state *state =
+      vm_bouncer_state(extra_params->vm, height, width, y, x);
+  if (!state)
+    return;
 
   Usz start = index_of(start_g);
   Usz end = index_of(end_g);
@@ -1745,13 +1842,13 @@ BEGIN_OPERATOR(bouncer)
       rate != state->last_rate || shape != state->last_shape) {
     state->current_index = 0;
     state->initialized = true;
-    state->last_rate = rate;
-    state->last_shape = shape;
+    state->last_rate = (U8)rate;
+    state->last_shape = (U8)shape;
   }
 
   // Only advance if rate > 0
   if (rate > 0 && rate_g != '.') {
-    state->current_index = (state->current_index + rate) % WAVE_LENGTH;
+    state->current_index = (U8)((state->current_index + rate) % WAVE_LENGTH);
   }
 
   // Get raw waveform value first
@@ -1775,45 +1872,1154 @@ BEGIN_OPERATOR(bouncer)
   POKE(1, 0, glyph_of(output_value));
 END_OPERATOR
 
-//////// Run simulation
+//////// VM state
 
-void orca_run(Glyph *restrict gbuf, Mark *restrict mbuf, Usz height, Usz width,
-              Usz tick_number, Oevent_list *oevent_list, Usz random_seed) {
-  Glyph vars_slots[Glyphs_index_count];
-  memset(vars_slots, '.', sizeof(vars_slots));
-  Oper_extra_params extras;
-  extras.vars_slots = &vars_slots[0];
-  extras.oevent_list = oevent_list;
-  extras.random_seed = random_seed;
+void orca_vm_init(Orca_vm *vm) {
+  memset(&vm->unique_random, 0, sizeof(vm->unique_random));
+  vm->bouncers = NULL;
+  vm->bouncers_height = vm->bouncers_width = 0;
+  vm->random_state = UINT32_C(2463534242); // xorshift32 can't start at 0
+}
+
+void orca_vm_deinit(Orca_vm *vm) { free(vm->bouncers); }
+
+void orca_vm_reset(Orca_vm *vm) {
+  orca_vm_deinit(vm);
+  orca_vm_init(vm);
+}
+
+//////// Live cell index
+
+void live_index_init(Live_index *li) { *li = (Live_index){0}; }
 
+void live_index_deinit(Live_index *li) { free(li->bits); }
+
+void live_index_invalidate(Live_index *li) { li->is_valid = false; }
+
+void live_index_rebuild(Live_index *li, Glyph const *gbuf, Usz height,
+                        Usz width) {
+  Usz row_words = (width + 63) / 64;
+  Usz needed = height * row_words;
+  if (li->capacity < needed) {
+    li->bits = realloc(li->bits, needed * sizeof(U64));
+    li->capacity = needed;
+  }
+  li->height = height;
+  li->width = width;
+  li->row_words = row_words;
+  li->is_valid = true;
+  if (needed == 0)
+    return;
+  memset(li->bits, 0, needed * sizeof(U64));
   for (Usz iy = 0; iy < height; ++iy) {
     Glyph const *glyph_row = gbuf + iy * width;
-    Mark const *mark_row = mbuf + iy * width;
+    U64 *bits_row = li->bits + iy * row_words;
     for (Usz ix = 0; ix < width; ++ix) {
-      Glyph glyph_char = glyph_row[ix];
-      if (ORCA_LIKELY(glyph_char == '.'))
-        continue;
-      Mark cell_flags = mark_row[ix] & (Mark_flag_lock | Mark_flag_sleep);
-      if (cell_flags & (Mark_flag_lock | Mark_flag_sleep))
-        continue;
-      switch (glyph_char) {
+      if (glyph_row[ix] != '.')
+        bits_row[ix >> 6] |= (U64)1 << (ix & 63);
+    }
+  }
+}
+
+void live_index_update_rect(Live_index *li, Glyph const *gbuf, Usz height,
+                            Usz width, Usz y, Usz x, Usz rect_h, Usz rect_w) {
+  // If it's stale or the wrong size, it's going to be rebuilt before it gets
+  // used, so there's nothing to update.
+  if (!li->is_valid || li->height != height || li->width != width)
+    return;
+  if (y >= height || x >= width)
+    return;
+  if (height - y < rect_h)
+    rect_h = height - y;
+  if (width - x < rect_w)
+    rect_w = width - x;
+  for (Usz iy = y, end_y = y + rect_h; iy < end_y; ++iy) {
+    Glyph const *glyph_row = gbuf + iy * width;
+    for (Usz ix = x, end_x = x + rect_w; ix < end_x; ++ix) {
+      live_index_set_cell(li, iy, ix, glyph_row[ix]);
+    }
+  }
+}
+
+//////// Run simulation
+
+// The threaded dispatch loop needs labels as values (computed goto), which
+// gcc and clang have. Build with FEAT_SWITCH_DISPATCH to use the plain switch
+// loop instead. Both visit cells in the same order and must produce the same
+// results; 'tool check' compares them.
+#if defined(FEAT_SWITCH_DISPATCH) ||                                          \
+    !(defined(__GNUC__) || defined(__clang__))
+#define ORCA_THREADED_DISPATCH 0
+#else
+#define ORCA_THREADED_DISPATCH 1
+#endif
+
+// Bit i is set if cell i of the run is an operator that gets to do something
+// this tick: it's not '.', and it's not locked or sleeping. `count` must be 64
+// or less. Uses AVX2 or SSE2 when the compiler is targeting them.
+static ORCA_FORCEINLINE U64 runnable_cells_mask(Glyph const *gbuf_run,
+                                                Mark const *mbuf_run,
+                                                Usz count) {
+  U64 result = 0;
+  Usz i = 0;
+#if defined(__AVX2__)
+  __m256i const dots = _mm256_set1_epi8('.');
+  __m256i const halts = _mm256_set1_epi8(Mark_flag_lock | Mark_flag_sleep);
+  __m256i const zero = _mm256_setzero_si256();
+  for (; i + 32 <= count; i += 32) {
+    __m256i g = _mm256_loadu_si256((__m256i const *)(gbuf_run + i));
+    __m256i m = _mm256_loadu_si256((__m256i const *)(mbuf_run + i));
+    __m256i is_dot = _mm256_cmpeq_epi8(g, dots);
+    __m256i is_free = _mm256_cmpeq_epi8(_mm256_and_si256(m, halts), zero);
+    U32 lanes = (U32)_mm256_movemask_epi8(_mm256_andnot_si256(is_dot, is_free));
+    result |= (U64)lanes << i;
+  }
+#elif defined(__SSE2__)
+  __m128i const dots = _mm_set1_epi8('.');
+  __m128i const halts = _mm_set1_epi8(Mark_flag_lock | Mark_flag_sleep);
+  __m128i const zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i g = _mm_loadu_si128((__m128i const *)(gbuf_run + i));
+    __m128i m = _mm_loadu_si128((__m128i const *)(mbuf_run + i));
+    __m128i is_dot = _mm_cmpeq_epi8(g, dots);
+    __m128i is_free = _mm_cmpeq_epi8(_mm_and_si128(m, halts), zero);
+    U32 lanes = (U32)_mm_movemask_epi8(_mm_andnot_si128(is_dot, is_free));
+    result |= (U64)lanes << i;
+  }
+#endif
+  for (; i < count; ++i) {
+    if (gbuf_run[i] != '.' &&
+        !(mbuf_run[i] & (Mark_flag_lock | Mark_flag_sleep)))
+      result |= (U64)1 << i;
+  }
+  return result;
+}
+
+// The cells in word `iw` of row `iy` which orca_run may visit, starting from
+// the lowest set bit: those in `keep` which are live according to
+// `live_index` (or all of them, if it's NULL) and runnable right now. This has
+// to be asked again after each operator runs, since the operator may have
+// written, locked or stunned cells further along.
+//
+// With the index, most words only have a bit or two set, and checking the
+// marks of those cells one at a time beats scanning all 64. In that case only
+// the lowest set bit is guaranteed to be runnable, which is all the caller
+// looks at before asking again.
+static ORCA_FORCEINLINE U64 run_word_mask(Glyph const *gbuf, Mark const *mbuf,
+                                          Usz width, Live_index const *li,
+                                          Usz iy, Usz iw, U64 keep) {
+  Usz x0 = iw * 64;
+  Glyph const *gbuf_run = gbuf + iy * width + x0;
+  Mark const *mbuf_run = mbuf + iy * width + x0;
+  U64 bits = keep;
+  if (li) {
+    bits &= li->bits[iy * li->row_words + iw];
+    if (orca_popcount64(bits) <= 8) {
+      while (bits && (mbuf_run[orca_ctz64(bits)] &
+                      (Mark_flag_lock | Mark_flag_sleep)))
+        bits &= bits - 1;
+      return bits;
+    }
+  }
+  Usz count = width - x0 < 64 ? width - x0 : 64;
+  return bits & runnable_cells_mask(gbuf_run, mbuf_run, count);
+}
+
+// No operator writes marks further below itself than this. (J is the one
+// that reaches furthest.)
+enum { Mark_reach_below = Jump_max_distance };
+
+// orca_run clears the marks left over from the previous tick as it goes,
+// instead of making a separate pass over the whole buffer first. Before row
+// `iy` is scanned, every row that an operator in it or above it could mark has
+// to be clear, so the clearing runs Mark_reach_below rows ahead of the scan.
+// On big grids, the rows are then still in cache when the scan gets to them.
+// When the grid is run in bands, nothing outside of rows [y0, y1) marks cells
+// inside of it, so each band only clears its own rows.
+static ORCA_FORCEINLINE void mbuf_clear_ahead_of_row(Mark *mbuf, Usz width,
+                                                     Usz y0, Usz y1, Usz iy) {
+  if (iy == y0) {
+    Usz rows = y1 - y0 < Mark_reach_below + 1 ? y1 - y0 : Mark_reach_below + 1;
+    memset(mbuf + y0 * width, 0, rows * width * sizeof(Mark));
+  } else if (iy + Mark_reach_below < y1) {
+    memset(mbuf + (iy + Mark_reach_below) * width, 0, width * sizeof(Mark));
+  }
+}
+
+// Only called for cells from run_word_mask(), so the cell is never '.', and
+// never locked or sleeping. (Except by the marker, which runs cells again
+// whatever their marks are now. See orca_marker_update.)
+static ORCA_FORCEINLINE void
+orca_run_cell(Glyph *restrict gbuf, Mark *restrict mbuf, Usz height, Usz width,
+              Usz iy, Usz ix, Usz tick_number, Oper_extra_params *extras) {
+  Glyph glyph_char = gbuf[iy * width + ix];
+  Mark cell_flags = Mark_flag_none;
+  switch (glyph_char) {
 #define UNIQUE_CASE(_oper_char, _oper_name)                                    \
   case _oper_char:                                                             \
     oper_behavior_##_oper_name(gbuf, mbuf, height, width, iy, ix, tick_number, \
-                               &extras, cell_flags, glyph_char);               \
+                               extras, cell_flags, glyph_char);                \
     break;
 
 #define ALPHA_CASE(_upper_oper_char, _oper_name)                               \
   case _upper_oper_char:                                                       \
   case (char)(_upper_oper_char | 1 << 5):                                      \
     oper_behavior_##_oper_name(gbuf, mbuf, height, width, iy, ix, tick_number, \
-                               &extras, cell_flags, glyph_char);               \
+                               extras, cell_flags, glyph_char);                \
     break;
-        UNIQUE_OPERATORS(UNIQUE_CASE)
-        ALPHA_OPERATORS(ALPHA_CASE)
+    UNIQUE_OPERATORS(UNIQUE_CASE)
+    ALPHA_OPERATORS(ALPHA_CASE)
 #undef UNIQUE_CASE
 #undef ALPHA_CASE
+  }
+}
+
+#if ORCA_THREADED_DISPATCH
+// Each operator behavior, listed once. The labels in the dispatch table are
+// generated from UNIQUE_OPERATORS and ALPHA_OPERATORS, so if something is
+// missing here, the compiler will complain about an undefined label.
+#define OPERATOR_BEHAVIORS(_)                                                  \
+  _(midicc)                                                                    \
+  _(comment)                                                                   \
+  _(midi)                                                                      \
+  _(bang)                                                                      \
+  _(bouncer)                                                                   \
+  _(midichord)                                                                 \
+  _(midipb)                                                                    \
+  _(scale)                                                                     \
+  _(midipoly)                                                                  \
+  _(randomunique)                                                              \
+  _(midiarpeggiator)                                                           \
+  _(add)                                                                       \
+  _(subtract)                                                                  \
+  _(clock)                                                                     \
+  _(delay)                                                                     \
+  _(movement)                                                                  \
+  _(if)                                                                        \
+  _(generator)                                                                 \
+  _(halt)                                                                      \
+  _(increment)                                                                 \
+  _(jump)                                                                      \
+  _(konkat)                                                                    \
+  _(lesser)                                                                    \
+  _(multiply)                                                                  \
+  _(offset)                                                                    \
+  _(push)                                                                      \
+  _(query)                                                                     \
+  _(random)                                                                    \
+  _(track)                                                                     \
+  _(uclid)                                                                     \
+  _(variable)                                                                  \
+  _(teleport)                                                                  \
+  _(yump)                                                                      \
+  _(lerp)
+
+// Same visiting order and same operator calls as orca_run_cell() in a loop,
+// but every handler ends by finding the next live cell and jumping straight
+// to its handler through the table, so each operator gets its own indirect
+// branch instead of all of them sharing the one from the switch. Labels as
+// values and range designators are GNU extensions, hence the pragmas.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Woverride-init"
+static void orca_run_threaded(Glyph *restrict gbuf, Mark *restrict mbuf,
+                              Usz height, Usz width, Usz y0, Usz y1,
+                              Usz tick_number, Oper_extra_params *extras) {
+#define THREADED_UNIQUE_ENTRY(_oper_char, _oper_name)                          \
+  [(U8)_oper_char] = &&oper_##_oper_name,
+#define THREADED_ALPHA_ENTRY(_upper_oper_char, _oper_name)                     \
+  [(U8)_upper_oper_char] = &&oper_##_oper_name,                                \
+  [(U8)(_upper_oper_char | 1 << 5)] = &&oper_##_oper_name,
+  static void *const dispatch_table[256] = {
+      [0 ... 255] = &&oper_none,
+      UNIQUE_OPERATORS(THREADED_UNIQUE_ENTRY)
+      ALPHA_OPERATORS(THREADED_ALPHA_ENTRY)};
+#undef THREADED_UNIQUE_ENTRY
+#undef THREADED_ALPHA_ENTRY
+  if (y0 >= y1 || width == 0)
+    return;
+  Live_index const *live_index = extras->live_index;
+  Usz row_words = (width + 63) / 64;
+  Usz iy = y0, iw = 0, ix = 0, bit = 0;
+  U64 bits;
+  Glyph glyph_char;
+  // run_word_mask() leaves out locked and sleeping cells.
+  Mark const cell_flags = Mark_flag_none;
+
+#define THREADED_ROW_WORD(_keep)                                               \
+  run_word_mask(gbuf, mbuf, width, live_index, iy, iw, _keep)
+#define THREADED_DISPATCH()                                                    \
+  do {                                                                         \
+    bit = orca_ctz64(bits);                                                    \
+    ix = iw * 64 + bit;                                                        \
+    glyph_char = gbuf[iy * width + ix];                                        \
+    goto *dispatch_table[(U8)glyph_char];                                      \
+  } while (0)
+// The operator may have written to cells further along in this word, so
+// reload it instead of just clearing the bit we visited. Shifting by 64 would
+// be undefined, hence the two steps.
+#define THREADED_NEXT()                                                        \
+  do {                                                                         \
+    bits = THREADED_ROW_WORD(~(((U64)1 << bit << 1) - 1));                     \
+    if (ORCA_LIKELY(bits != 0))                                                \
+      THREADED_DISPATCH();                                                     \
+    goto next_word;                                                            \
+  } while (0)
+
+  mbuf_clear_ahead_of_row(mbuf, width, y0, y1, y0);
+  bits = THREADED_ROW_WORD(~(U64)0);
+  goto check_word;
+next_word:
+  if (++iw == row_words) {
+    iw = 0;
+    if (++iy == y1)
+      return;
+    mbuf_clear_ahead_of_row(mbuf, width, y0, y1, iy);
+  }
+  bits = THREADED_ROW_WORD(~(U64)0);
+check_word:
+  if (!bits)
+    goto next_word;
+  THREADED_DISPATCH();
+
+oper_none:
+  THREADED_NEXT();
+
+#define THREADED_HANDLER(_oper_name)                                           \
+  oper_##_oper_name:                                                           \
+  oper_behavior_##_oper_name(gbuf, mbuf, height, width, iy, ix, tick_number,   \
+                             extras, cell_flags, glyph_char);                  \
+  THREADED_NEXT();
+  OPERATOR_BEHAVIORS(THREADED_HANDLER)
+#undef THREADED_HANDLER
+#undef THREADED_ROW_WORD
+#undef THREADED_DISPATCH
+#undef THREADED_NEXT
+}
+#pragma GCC diagnostic pop
+#endif
+
+// Runs rows [y0, y1) of the grid, in order.
+static void orca_run_rows(Glyph *restrict gbuf, Mark *restrict mbuf,
+                          Usz height, Usz width, Usz y0, Usz y1,
+                          Usz tick_number, Oper_extra_params *extras) {
+#if ORCA_THREADED_DISPATCH
+  orca_run_threaded(gbuf, mbuf, height, width, y0, y1, tick_number, extras);
+#else
+  Live_index const *live_index = extras->live_index;
+  Usz row_words = (width + 63) / 64;
+  for (Usz iy = y0; iy < y1; ++iy) {
+    mbuf_clear_ahead_of_row(mbuf, width, y0, y1, iy);
+    for (Usz iw = 0; iw < row_words; ++iw) {
+      U64 bits =
+          run_word_mask(gbuf, mbuf, width, live_index, iy, iw, ~(U64)0);
+      while (bits) {
+        Usz bit = orca_ctz64(bits);
+        orca_run_cell(gbuf, mbuf, height, width, iy, iw * 64 + bit,
+                      tick_number, extras);
+        // The operator may have written to cells further along in this word,
+        // so reload it instead of just clearing the bit we visited. Shifting
+        // by 64 would be undefined, hence the two steps.
+        bits = run_word_mask(gbuf, mbuf, width, live_index, iy, iw,
+                             ~(((U64)1 << bit << 1) - 1));
       }
     }
   }
+#endif
+}
+
+// How far above and below itself an operator can reach when it runs, with any
+// inputs at all: rows it peeks, pokes or marks. Lowercase operators, and the
+// others that wait for a bang, look for one in the rows above and below.
+// Glyphs that aren't operators reach nothing.
+typedef struct {
+  U8 above;
+  bool shares_state; // Uses the $ sequence or the V and K variables
+  bool from_inputs;  // How far down it reaches depends on its inputs
+  // The row above or below is only looked at for a bang, and nothing is
+  // written or marked there.
+  bool bang_above, bang_below;
+  U16 below;
+} Oper_reach;
+
+#define REACH(_above, _below) {_above, false, false, false, false, _below}
+// Looks for a bang next to it. Marks the row below if `_marks_below`.
+#define BANGED_REACH(_marks_below) {1, false, false, true, !(_marks_below), 1}
+#define ALPHA_REACH(_upper_oper_char, _upper_above, _below, _shares_state,    \
+                    _from_inputs)                                              \
+  [_upper_oper_char] = {_upper_above, _shares_state, _from_inputs,             \
+                        false,        false,         _below},                  \
+  [_upper_oper_char | 1 << 5] = {1,                                            \
+                                 _shares_state,                                \
+                                 _from_inputs,                                 \
+                                 (_upper_above) == 0,                          \
+                                 (_below) < 1,                                 \
+                                 (_below) < 1 ? 1 : (_below)}
+static Oper_reach const oper_reach_table[128] = {
+    ['!'] = BANGED_REACH(false),
+    ['%'] = BANGED_REACH(false),
+    [':'] = BANGED_REACH(false),
+    [';'] = BANGED_REACH(true),
+    ['='] = BANGED_REACH(false),
+    ['?'] = BANGED_REACH(false),
+    ['^'] = REACH(0, 1),
+    ['|'] = BANGED_REACH(false),
+    ['$'] = {1, true, false, true, false, 1},
+    ['&'] = BANGED_REACH(false),
+    ALPHA_REACH('A', 0, 1, false, false),
+    ALPHA_REACH('B', 0, 1, false, false),
+    ALPHA_REACH('C', 0, 1, false, false),
+    ALPHA_REACH('D', 0, 1, false, false),
+    ALPHA_REACH('E', 0, 0, false, false),
+    ALPHA_REACH('F', 0, 1, false, false),
+    ALPHA_REACH('G', 0, 36, false, true),
+    ALPHA_REACH('H', 0, 1, false, false),
+    ALPHA_REACH('I', 0, 1, false, false),
+    ALPHA_REACH('J', 1, Jump_max_distance, false, true),
+    ALPHA_REACH('K', 0, 1, true, false),
+    ALPHA_REACH('L', 0, 1, false, false),
+    ALPHA_REACH('M', 0, 1, false, false),
+    ALPHA_REACH('N', 1, 0, false, false),
+    ALPHA_REACH('O', 0, 35, false, true),
+    ALPHA_REACH('P', 0, 1, false, false),
+    ALPHA_REACH('Q', 0, 35, false, true),
+    ALPHA_REACH('R', 0, 1, false, false),
+    ALPHA_REACH('S', 0, 1, false, false),
+    ALPHA_REACH('T', 0, 1, false, false),
+    ALPHA_REACH('U', 0, 1, false, false),
+    ALPHA_REACH('V', 0, 1, true, false),
+    ALPHA_REACH('W', 0, 0, false, false),
+    ALPHA_REACH('X', 0, 35, false, true),
+    ALPHA_REACH('Y', 0, 0, false, false),
+    ALPHA_REACH('Z', 0, 1, false, false),
+};
+#undef REACH
+#undef BANGED_REACH
+#undef ALPHA_REACH
+
+// How far below itself the operator at `y`, `x` will reach if its inputs
+// don't change before it runs. If they do, it checks for itself with
+// STOP_IF_OUTSIDE_BAND.
+static Usz oper_reach_from_inputs(Glyph const *gbuf, Usz height, Usz width,
+                                  Usz y, Usz x, Glyph g) {
+  Glyph const *gp = gbuf + y * width + x;
+  Usz at_least = glyph_is_lowercase(g) ? 1 : 0;
+  Usz below;
+  switch (glyph_lowered_unsafe(g)) {
+  case 'g':
+    below = x >= 2 ? index_of(gp[-2]) + 1 : 1;
+    break;
+  case 'j':
+    // Only the top of a chain does anything. (If it becomes the top during
+    // the tick, it checks.)
+    if (y > 0 && gp[-(Isz)width] == g)
+      return 1;
+    for (below = 1; below < Jump_max_distance && y + below < height; ++below) {
+      if (gp[below * width] != g)
+        break;
+    }
+    return below;
+  case 'o':
+    below = x >= 1 ? index_of(gp[-1]) : 0;
+    at_least = 1;
+    break;
+  case 'q':
+    below = x >= 2 ? index_of(gp[-2]) : 0;
+    at_least = 1;
+    break;
+  case 'x':
+    below = x >= 2 ? index_of(gp[-2]) : 0;
+    break;
+  default:
+    below = 0;
+    break;
+  }
+  return below < at_least ? at_least : below;
+}
+
+struct Orca_band_row {
+  Usz cells;          // Glyphs other than '.'
+  Usz reach_end;      // One past the lowest row its operators can reach
+  bool reaches_above; // Something in it can reach the row above
+};
+
+struct Orca_band_job {
+  Glyph *gbuf;
+  Mark *mbuf;
+  Usz height, width, tick_number;
+  Oper_extra_params const *extras;
+};
+
+typedef struct {
+  Usz shared_y0, shared_y1; // Rows with operators that share state
+  bool has_bouncer;
+  bool careful;    // Assume the worst about inputs
+  bool marks_only; // Leave out rows only looked at for a bang. See orca_marker
+} Band_plan_info;
+
+// Fills in `row` for row `iy`, which has live cells at the set bits of
+// `bits`, starting from column `x0`.
+static ORCA_FORCEINLINE void band_row_add_word(struct Orca_band_row *row,
+                                               Band_plan_info *info,
+                                               Glyph const *gbuf, Usz height,
+                                               Usz width, Usz iy, Usz x0,
+                                               U64 bits) {
+  Glyph const *gline = gbuf + iy * width;
+  Usz reach_end = row->reach_end;
+  bool reaches_above = false, shares_state = false, has_bouncer = false;
+  row->cells += orca_popcount64(bits);
+  for (; bits != 0; bits &= bits - 1) {
+    Usz ix = x0 + orca_ctz64(bits);
+    Glyph g = gline[ix];
+    Oper_reach reach = oper_reach_table[(U8)g & 0x7f];
+    Usz below = reach.below;
+    if (info->marks_only && reach.bang_below)
+      below = 0;
+    if (reach.from_inputs && !info->careful)
+      below = oper_reach_from_inputs(gbuf, height, width, iy, ix, g);
+    if (iy + below + 1 > reach_end)
+      reach_end = iy + below + 1;
+    if (reach.above != 0 && !(info->marks_only && reach.bang_above))
+      reaches_above = true;
+    shares_state |= reach.shares_state;
+    has_bouncer |= g == ';';
+  }
+  row->reach_end = reach_end;
+  row->reaches_above |= reaches_above;
+  info->has_bouncer |= has_bouncer;
+  if (shares_state) {
+    if (iy < info->shared_y0)
+      info->shared_y0 = iy;
+    info->shared_y1 = iy + 1;
+  }
+}
+
+// Fills in `rows` for every row of the grid, and returns the number of live
+// cells. `info->careful` has to be set first.
+static Usz band_rows_fill(struct Orca_band_row *rows, Band_plan_info *info,
+                          Glyph const *gbuf, Usz height, Usz width,
+                          Live_index const *li) {
+  Usz total_cells = 0;
+  info->shared_y0 = height;
+  info->shared_y1 = 0;
+  info->has_bouncer = false;
+  for (Usz iy = 0; iy < height; ++iy) {
+    struct Orca_band_row *row = rows + iy;
+    *row = (struct Orca_band_row){.reach_end = iy + 1};
+    if (li) {
+      U64 const *bits_row = li->bits + iy * li->row_words;
+      for (Usz iw = 0; iw < li->row_words; ++iw) {
+        if (bits_row[iw] != 0)
+          band_row_add_word(row, info, gbuf, height, width, iy, iw * 64,
+                            bits_row[iw]);
+      }
+    } else {
+      Glyph const *gline = gbuf + iy * width;
+      for (Usz x0 = 0; x0 < width; x0 += 64) {
+        Usz count = width - x0 < 64 ? width - x0 : 64;
+        U64 bits = 0;
+        for (Usz i = 0; i < count; ++i) {
+          if (gline[x0 + i] != '.')
+            bits |= (U64)1 << i;
+        }
+        if (bits != 0)
+          band_row_add_word(row, info, gbuf, height, width, iy, x0, bits);
+      }
+    }
+    total_cells += row->cells;
+  }
+  return total_cells;
+}
+
+// The operators that run during a tick are the ones that are in the grid when
+// it starts, since anything an operator writes is locked or stunned for the
+// rest of the tick. So the bands can be worked out up front. Returns the
+// number of bands, which is 1 if the grid can't be split, or if there isn't
+// the memory to plan it.
+static Usz band_pool_plan(Orca_band_pool *pool, Glyph const *gbuf, Usz height,
+                          Usz width, Live_index const *li,
+                          Band_plan_info *info) {
+  Usz max_bands = pool->thread_count < height ? pool->thread_count : height;
+  if (max_bands < 2)
+    return 1;
+  if (pool->rows_capacity < height) {
+    struct Orca_band_row *rows =
+        realloc(pool->rows, height * sizeof(struct Orca_band_row));
+    if (!rows)
+      return 1;
+    pool->rows = rows;
+    pool->rows_capacity = height;
+  }
+  struct Orca_band_row *rows = pool->rows;
+  info->careful = pool->careful_ticks > 0;
+  info->marks_only = false;
+  Usz total_cells = band_rows_fill(rows, info, gbuf, height, width, li);
+  if (total_cells == 0)
+    return 1;
+  if (pool->bands_capacity < max_bands) {
+    Orca_band *bands = realloc(pool->bands, max_bands * sizeof(Orca_band));
+    if (!bands)
+      return 1;
+    pool->bands = bands;
+    for (Usz i = pool->bands_capacity; i < max_bands; ++i) {
+      oevent_list_init(&pool->bands[i].oevent_list);
+    }
+    pool->bands_capacity = max_bands;
+  }
+  // Cut before row `iy` once the band has its share of the cells, if nothing
+  // above reaches down into it and nothing in it reaches up.
+  Orca_band *bands = pool->bands;
+  Usz cells_per_band = (total_cells + max_bands - 1) / max_bands;
+  Usz band_count = 0, band_y0 = 0, band_cells = 0, reach_end = 0;
+  for (Usz iy = 0; iy < height; ++iy) {
+    struct Orca_band_row const *row = rows + iy;
+    if (band_cells >= cells_per_band && reach_end <= iy &&
+        !row->reaches_above && band_count + 1 < max_bands) {
+      bands[band_count].y0 = band_y0;
+      bands[band_count].y1 = iy;
+      ++band_count;
+      band_y0 = iy;
+      band_cells = 0;
+    }
+    band_cells += row->cells;
+    if (row->reach_end > reach_end)
+      reach_end = row->reach_end;
+  }
+  bands[band_count].y0 = band_y0;
+  bands[band_count].y1 = height;
+  ++band_count;
+  // The $ sequence and the variables are the same for the whole grid, and
+  // each read or write depends on the ones before it. If more than one band
+  // uses them, those bands and everything in between get run as one.
+  if (info->shared_y0 < info->shared_y1) {
+    Usz first = 0, last = band_count - 1;
+    while (bands[first].y1 <= info->shared_y0)
+      ++first;
+    while (bands[last].y0 >= info->shared_y1)
+      --last;
+    if (first < last) {
+      bands[first].y1 = bands[last].y1;
+      for (Usz i = last + 1; i < band_count; ++i) {
+        bands[first + i - last].y0 = bands[i].y0;
+        bands[first + i - last].y1 = bands[i].y1;
+      }
+      band_count -= last - first;
+    }
+  }
+  return band_count;
+}
+
+static void band_pool_run_band(struct Orca_band_job const *job,
+                               Orca_band *band) {
+  Oper_extra_params extras = *job->extras;
+  extras.oevent_list = &band->oevent_list;
+  extras.band_y1 = band->y1;
+  extras.band_escaped = false;
+  oevent_list_clear(&band->oevent_list);
+  orca_run_rows(job->gbuf, job->mbuf, job->height, job->width, band->y0,
+                band->y1, job->tick_number, &extras);
+  band->escaped = extras.band_escaped;
+}
+
+// Runs bands until there are none left to start. Must be called with the
+// pool's lock held, which is released while each band runs.
+static void band_pool_work(Orca_band_pool *pool) {
+  struct Orca_band_job const *job = pool->job;
+  while (pool->next_band < pool->band_count) {
+    Orca_band *band = pool->bands + pool->next_band++;
+    pthread_mutex_unlock(&pool->lock);
+    band_pool_run_band(job, band);
+    pthread_mutex_lock(&pool->lock);
+    if (++pool->bands_finished == pool->band_count)
+      pthread_cond_signal(&pool->done_cond);
+  }
+}
+
+static void *band_pool_worker_main(void *arg) {
+  Orca_band_pool *pool = arg;
+  U64 generation = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->quit && pool->generation == generation)
+      pthread_cond_wait(&pool->work_cond, &pool->lock);
+    if (pool->quit)
+      break;
+    generation = pool->generation;
+    band_pool_work(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+void orca_band_pool_init(Orca_band_pool *pool, Usz thread_count) {
+  *pool = (Orca_band_pool){0};
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+  pool->thread_count = 1;
+  if (thread_count < 2)
+    return;
+  pool->threads = malloc((thread_count - 1) * sizeof(pthread_t));
+  if (!pool->threads)
+    return;
+  for (Usz i = 0; i < thread_count - 1; ++i) {
+    if (pthread_create(pool->threads + i, NULL, band_pool_worker_main, pool))
+      break;
+    ++pool->thread_count;
+  }
+}
+
+void orca_band_pool_deinit(Orca_band_pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+  for (Usz i = 0; i < pool->thread_count - 1; ++i) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+  for (Usz i = 0; i < pool->bands_capacity; ++i) {
+    oevent_list_deinit(&pool->bands[i].oevent_list);
+  }
+  free(pool->bands);
+  free(pool->rows);
+  free(pool->gbuf_backup);
+  free(pool->bouncers_backup);
+  free(pool->threads);
+}
+
+// After an operator tries to leave its band, bands are planned as if every
+// operator's inputs could change to anything during the tick, for this many
+// ticks. And when a tick can't be split, the next few don't try, up to this
+// many.
+enum { Band_careful_ticks = 64, Band_max_skip_ticks = 64 };
+
+// Bands are planned from where operators' inputs point at the start of the
+// tick, so the tick is started over from a copy if one of them changes enough
+// to point into another band. Returns false, with everything as it was, if
+// the tick has to be run in one piece.
+static bool orca_run_bands(Orca_band_pool *pool, Glyph *restrict gbuf,
+                           Mark *restrict mbuf, Usz height, Usz width,
+                           Usz tick_number, Oper_extra_params *extras) {
+  if (pool->skip_ticks > 0) {
+    --pool->skip_ticks;
+    return false;
+  }
+  Band_plan_info info;
+  Usz band_count = band_pool_plan(pool, gbuf, height, width,
+                                  extras->live_index, &info);
+  if (pool->careful_ticks > 0)
+    --pool->careful_ticks;
+  if (band_count < 2) {
+    pool->skip_ticks = pool->skip_backoff;
+    if (pool->skip_backoff == 0)
+      pool->skip_backoff = 1;
+    else if (pool->skip_backoff < Band_max_skip_ticks)
+      pool->skip_backoff *= 2;
+    return false;
+  }
+  pool->skip_backoff = 0;
+  Orca_vm *vm = extras->vm;
+  // Bouncers each have their own state, but it's allocated the first time
+  // one runs. Do that now, instead of from whichever thread gets there first.
+  Usz cells = height * width;
+  if (info.has_bouncer) {
+    if (!vm_bouncer_state(vm, height, width, 0, 0))
+      return false;
+    if (pool->bouncers_backup_capacity < cells) {
+      Bouncer_state *backup =
+          realloc(pool->bouncers_backup, cells * sizeof(Bouncer_state));
+      if (!backup)
+        return false;
+      pool->bouncers_backup = backup;
+      pool->bouncers_backup_capacity = cells;
+    }
+    memcpy(pool->bouncers_backup, vm->bouncers, cells * sizeof(Bouncer_state));
+  }
+  if (!info.careful) {
+    if (pool->gbuf_backup_capacity < cells) {
+      Glyph *backup = realloc(pool->gbuf_backup, cells * sizeof(Glyph));
+      if (!backup)
+        return false;
+      pool->gbuf_backup = backup;
+      pool->gbuf_backup_capacity = cells;
+    }
+    memcpy(pool->gbuf_backup, gbuf, cells * sizeof(Glyph));
+  }
+  Unique_random_state unique_random = vm->unique_random;
+  U32 random_state = vm->random_state;
+
+  struct Orca_band_job job = {gbuf, mbuf, height, width, tick_number, extras};
+  pthread_mutex_lock(&pool->lock);
+  pool->job = &job;
+  pool->band_count = band_count;
+  pool->next_band = 0;
+  pool->bands_finished = 0;
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->work_cond);
+  band_pool_work(pool);
+  while (pool->bands_finished < band_count)
+    pthread_cond_wait(&pool->done_cond, &pool->lock);
+  pool->job = NULL;
+  pthread_mutex_unlock(&pool->lock);
+
+  bool escaped = false;
+  for (Usz i = 0; i < band_count; ++i) {
+    escaped |= pool->bands[i].escaped;
+  }
+  if (escaped) {
+    // Can't happen when careful, since nothing can reach further than that.
+    assert(!info.careful);
+    memcpy(gbuf, pool->gbuf_backup, cells * sizeof(Glyph));
+    if (info.has_bouncer)
+      memcpy(vm->bouncers, pool->bouncers_backup,
+             cells * sizeof(Bouncer_state));
+    vm->unique_random = unique_random;
+    vm->random_state = random_state;
+    memset(extras->vars_slots, '.', Glyphs_index_count * sizeof(Glyph));
+    if (extras->live_index)
+      live_index_rebuild(extras->live_index, gbuf, height, width);
+    pool->careful_ticks = Band_careful_ticks;
+    return false;
+  }
+  // Each band's events are in the order the serial run would have made them,
+  // and the bands are in order from the top.
+  for (Usz i = 0; i < band_count; ++i) {
+    oevent_list_append(&pool->bands[i].oevent_list, extras->oevent_list);
+  }
+  return true;
+}
+
+void orca_run(Glyph *restrict gbuf, Mark *restrict mbuf, Usz height, Usz width,
+              Usz tick_number, Oevent_list *oevent_list, Usz random_seed,
+              Orca_vm *vm, Live_index *live_index,
+              Orca_band_pool *band_pool) {
+  Glyph vars_slots[Glyphs_index_count];
+  memset(vars_slots, '.', sizeof(vars_slots));
+  Oper_extra_params extras;
+  extras.vars_slots = &vars_slots[0];
+  extras.oevent_list = oevent_list;
+  extras.random_seed = random_seed;
+  extras.vm = vm;
+  extras.live_index = live_index;
+  extras.band_y1 = height;
+  extras.band_escaped = false;
+  extras.marks_only = false;
+
+  if (live_index && (!live_index->is_valid || live_index->height != height ||
+                     live_index->width != width))
+    live_index_rebuild(live_index, gbuf, height, width);
+  if (band_pool && orca_run_bands(band_pool, gbuf, mbuf, height, width,
+                                   tick_number, &extras))
+    return;
+  orca_run_rows(gbuf, mbuf, height, width, 0, height, tick_number, &extras);
+}
+
+//////// Marking without running
+
+// Operators run only for their marks don't write glyphs, and no operator's
+// marks depend on the tick number or on the variables.
+static void mark_extras_init(Oper_extra_params *extras, Glyph *vars_slots,
+                             Usz height, Live_index *live_index) {
+  memset(vars_slots, '.', Glyphs_index_count * sizeof(Glyph));
+  extras->vars_slots = vars_slots;
+  extras->oevent_list = NULL;
+  extras->random_seed = 0;
+  extras->vm = NULL;
+  extras->live_index = live_index;
+  extras->band_y1 = height;
+  extras->band_escaped = false;
+  extras->marks_only = true;
+}
+
+// Sets the marks in rows [y0, y1) that running them would, with every
+// operator behaving as if nothing it writes gets written. The marks from
+// operators outside of those rows aren't included.
+static void orca_mark_rows(Glyph const *gbuf, Mark *mbuf, Usz height,
+                           Usz width, Usz y0, Usz y1, Live_index *live_index) {
+  Glyph vars_slots[Glyphs_index_count];
+  Oper_extra_params extras;
+  mark_extras_init(&extras, vars_slots, height, live_index);
+  orca_run_rows((Glyph *)gbuf, mbuf, height, width, y0, y1, 0, &extras);
+}
+
+// Clears the rows of `mbuf` from `*cleared_end` up to `end`, or to the bottom
+// of the grid. The reach of a row can go past it.
+static void marks_clear_to(Mark *mbuf, Usz height, Usz width, Usz *cleared_end,
+                           Usz end) {
+  if (end > height)
+    end = height;
+  if (end <= *cleared_end)
+    return;
+  memset(mbuf + *cleared_end * width, 0,
+         (end - *cleared_end) * width * sizeof(Mark));
+  *cleared_end = end;
+}
+
+// Marks row `iy` the way orca_run_rows() runs it. Sets the bits in `ran` for
+// the cells it ran, and fills in `row` for just those. If `cleared_end` isn't
+// NULL, the rows that each operator can mark are cleared before it runs, as
+// far as they haven't been already.
+static void mark_row(Glyph const *gbuf, Mark *mbuf, Usz height, Usz width,
+                     Usz iy, U64 *ran, struct Orca_band_row *row,
+                     Usz *cleared_end, Oper_extra_params *extras) {
+  Live_index const *live_index = extras->live_index;
+  Usz row_words = (width + 63) / 64;
+  Band_plan_info info;
+  info.shared_y0 = height;
+  info.shared_y1 = 0;
+  info.has_bouncer = false;
+  info.careful = false; // Nothing changes the inputs while marking
+  info.marks_only = true;
+  *row = (struct Orca_band_row){.reach_end = iy + 1};
+  for (Usz iw = 0; iw < row_words; ++iw) {
+    U64 ran_word = 0;
+    U64 bits = run_word_mask(gbuf, mbuf, width, live_index, iy, iw, ~(U64)0);
+    while (bits) {
+      Usz bit = orca_ctz64(bits);
+      ran_word |= (U64)1 << bit;
+      band_row_add_word(row, &info, gbuf, height, width, iy, iw * 64,
+                        (U64)1 << bit);
+      if (cleared_end)
+        marks_clear_to(mbuf, height, width, cleared_end, row->reach_end);
+      orca_run_cell((Glyph *)gbuf, mbuf, height, width, iy, iw * 64 + bit, 0,
+                    extras);
+      bits = run_word_mask(gbuf, mbuf, width, live_index, iy, iw,
+                           ~(((U64)1 << bit << 1) - 1));
+    }
+    ran[iw] = ran_word;
+  }
+}
+
+// Runs the cells in row `iy` at the set bits of `ran` again, whatever their
+// marks are now, so that they set the same marks as when they ran.
+static void mark_row_again(Glyph const *gbuf, Mark *mbuf, Usz height,
+                           Usz width, Usz iy, U64 const *ran,
+                           Oper_extra_params *extras) {
+  Usz row_words = (width + 63) / 64;
+  for (Usz iw = 0; iw < row_words; ++iw) {
+    for (U64 bits = ran[iw]; bits != 0; bits &= bits - 1) {
+      orca_run_cell((Glyph *)gbuf, mbuf, height, width, iy,
+                    iw * 64 + orca_ctz64(bits), 0, extras);
+    }
+  }
+}
+
+void orca_marker_init(Orca_marker *mk) { *mk = (Orca_marker){0}; }
+
+void orca_marker_deinit(Orca_marker *mk) {
+  free(mk->glyphs);
+  free(mk->marks);
+  free(mk->old_marks);
+  free(mk->ran);
+  free(mk->old_ran);
+  free(mk->rows);
+  free(mk->old_rows);
+}
+
+void orca_marker_invalidate(Orca_marker *mk) { mk->is_valid = false; }
+
+// Returns false if there isn't enough memory. Whatever was grown is kept.
+static bool marker_reserve(Orca_marker *mk, Usz height, Usz width) {
+  Usz cells = height * width, words = height * ((width + 63) / 64);
+  if (mk->cells_capacity < cells) {
+    Glyph *glyphs = realloc(mk->glyphs, cells * sizeof(Glyph));
+    if (!glyphs)
+      return false;
+    mk->glyphs = glyphs;
+    Mark *marks = realloc(mk->marks, cells * sizeof(Mark));
+    if (!marks)
+      return false;
+    mk->marks = marks;
+    marks = realloc(mk->old_marks, cells * sizeof(Mark));
+    if (!marks)
+      return false;
+    mk->old_marks = marks;
+    mk->cells_capacity = cells;
+  }
+  if (mk->words_capacity < words) {
+    U64 *ran = realloc(mk->ran, words * sizeof(U64));
+    if (!ran)
+      return false;
+    mk->ran = ran;
+    ran = realloc(mk->old_ran, words * sizeof(U64));
+    if (!ran)
+      return false;
+    mk->old_ran = ran;
+    mk->words_capacity = words;
+  }
+  if (mk->rows_capacity < height) {
+    struct Orca_band_row *rows =
+        realloc(mk->rows, height * sizeof(struct Orca_band_row));
+    if (!rows)
+      return false;
+    mk->rows = rows;
+    rows = realloc(mk->old_rows, height * sizeof(struct Orca_band_row));
+    if (!rows)
+      return false;
+    mk->old_rows = rows;
+    mk->rows_capacity = height;
+  }
+  return true;
+}
+
+static void marker_mark_all(Orca_marker *mk, Glyph const *gbuf, Mark *mbuf,
+                            Usz height, Usz width, Live_index *live_index) {
+  Usz row_words = (width + 63) / 64;
+  Glyph vars_slots[Glyphs_index_count];
+  Oper_extra_params extras;
+  mark_extras_init(&extras, vars_slots, height, live_index);
+  for (Usz iy = 0; iy < height; ++iy) {
+    mbuf_clear_ahead_of_row(mbuf, width, 0, height, iy);
+    mark_row(gbuf, mbuf, height, width, iy, mk->ran + iy * row_words,
+             mk->rows + iy, NULL, &extras);
+  }
+  memcpy(mk->glyphs, gbuf, height * width * sizeof(Glyph));
+}
+
+// Whether the marks the operators above row `iy` leave on the rows from `iy`
+// down are the same as before the update. The new ones are in `mk->marks`.
+// The old ones are worked out in `mk->old_marks`, by running the operators
+// that ran before again on the old glyphs. Rows [old_y0, iy) have been marked
+// again, and what they were before is in `mk->old_ran` and `mk->old_rows`.
+static bool marker_carry_is_same(Orca_marker *mk, Usz height, Usz width,
+                                 Usz iy, Usz old_y0, Usz *cleared_end,
+                                 Oper_extra_params *extras) {
+  Usz row_words = (width + 63) / 64;
+  Usz from = iy > Mark_reach_below ? iy - Mark_reach_below : 0;
+  Usz end = iy;
+  for (Usz y = from; y < iy; ++y) {
+    Usz old_end =
+        y >= old_y0 ? mk->old_rows[y].reach_end : mk->rows[y].reach_end;
+    if (old_end > end)
+      end = old_end;
+    if (mk->rows[y].reach_end > end)
+      end = mk->rows[y].reach_end;
+  }
+  if (end > height)
+    end = height;
+  if (end == iy)
+    return true;
+  marks_clear_to(mk->marks, height, width, cleared_end, end);
+  Mark *old_marks = mk->old_marks;
+  memset(old_marks + iy * width, 0, (end - iy) * width * sizeof(Mark));
+  for (Usz y = from; y < iy; ++y) {
+    if (y >= old_y0) {
+      if (mk->old_rows[y].reach_end > iy)
+        mark_row_again(mk->glyphs, old_marks, height, width, y,
+                       mk->old_ran + y * row_words, extras);
+    } else if (mk->rows[y].reach_end > iy) {
+      mark_row_again(mk->glyphs, old_marks, height, width, y,
+                     mk->ran + y * row_words, extras);
+    }
+  }
+  return memcmp(mk->marks + iy * width, old_marks + iy * width,
+                (end - iy) * width * sizeof(Mark)) == 0;
+}
+
+// Marks again after rows [y0, y1) have changed. Nothing above the first row
+// with operators that ran and can reach the changed rows (or look at them for
+// a bang) runs any differently. So the rows from there down are marked again
+// in order, into scratch marks, after putting back the marks left on them by
+// the operators above that ran. Going on down, everything from row `iy` on
+// runs the same as before once the marks left on those rows by the operators
+// above `iy` are the same as they were. That's checked at rows further and
+// further apart, until it holds or the grid runs out, and only the rows above
+// it are copied into `mbuf`.
+static void marker_mark_window(Orca_marker *mk, Glyph const *gbuf, Mark *mbuf,
+                               Usz height, Usz width, Usz y0, Usz y1,
+                               Live_index *live_index) {
+  Usz row_words = (width + 63) / 64;
+  Usz win_y0 = y0;
+  for (Usz iy = y0 > Mark_reach_below + 1 ? y0 - Mark_reach_below - 1 : 0;
+       iy < y0; ++iy) {
+    if (mk->rows[iy].reach_end >= y0) {
+      win_y0 = iy;
+      break;
+    }
+  }
+  Glyph vars_slots[Glyphs_index_count];
+  Oper_extra_params extras;
+  mark_extras_init(&extras, vars_slots, height, live_index);
+  // The operators in the first row can mark the row above it.
+  Usz top = win_y0 > 0 ? win_y0 - 1 : 0, cleared_end = top;
+  Mark *marks = mk->marks;
+  for (Usz iy = top > Mark_reach_below ? top - Mark_reach_below : 0;
+       iy < win_y0; ++iy) {
+    Usz reach_end = mk->rows[iy].reach_end;
+    if (reach_end <= top)
+      continue;
+    marks_clear_to(marks, height, width, &cleared_end, reach_end);
+    mark_row_again(gbuf, marks, height, width, iy, mk->ran + iy * row_words,
+                   &extras);
+  }
+  // Each row is checked at least as far as the one below the changed rows,
+  // which looks up at them for a bang, or to see if it's the top of a J
+  // chain.
+  Usz win_y1 = win_y0, check_y = y1 + 1;
+  for (;;) {
+    U64 *ran = mk->ran + win_y1 * row_words;
+    memcpy(mk->old_ran + win_y1 * row_words, ran, row_words * sizeof(U64));
+    mk->old_rows[win_y1] = mk->rows[win_y1];
+    marks_clear_to(marks, height, width, &cleared_end, win_y1 + 1);
+    mark_row(gbuf, marks, height, width, win_y1, ran, mk->rows + win_y1,
+             &cleared_end, &extras);
+    if (++win_y1 == height)
+      break;
+    if (win_y1 == check_y) {
+      if (marker_carry_is_same(mk, height, width, win_y1, win_y0, &cleared_end,
+                               &extras))
+        break;
+      check_y = y1 + 2 * (win_y1 - y1);
+    }
+  }
+  // The operators in the row below can mark the last row, too.
+  if (win_y1 < height && mk->rows[win_y1].reaches_above)
+    mark_row_again(gbuf, marks, height, width, win_y1,
+                   mk->ran + win_y1 * row_words, &extras);
+  memcpy(mbuf + top * width, marks + top * width,
+         (win_y1 - top) * width * sizeof(Mark));
+  memcpy(mk->glyphs + y0 * width, gbuf + y0 * width,
+         (y1 - y0) * width * sizeof(Glyph));
+}
+
+void orca_marker_update(Orca_marker *mk, Glyph const *gbuf, Mark *mbuf,
+                        Usz height, Usz width, Usz y0, Usz y1,
+                        Live_index *live_index) {
+  if (live_index && (!live_index->is_valid || live_index->height != height ||
+                     live_index->width != width))
+    live_index_rebuild(live_index, gbuf, height, width);
+  if (!marker_reserve(mk, height, width)) {
+    // Mark the whole grid without keeping track, and start over next time.
+    mk->is_valid = false;
+    orca_mark_rows(gbuf, mbuf, height, width, 0, height, live_index);
+    return;
+  }
+  if (y1 > height)
+    y1 = height;
+  // Rows that are the same as before are left out.
+  bool is_same_size =
+      mk->is_valid && mk->height == height && mk->width == width;
+  while (is_same_size && y0 < y1 &&
+         memcmp(mk->glyphs + y0 * width, gbuf + y0 * width,
+                width * sizeof(Glyph)) == 0)
+    ++y0;
+  while (is_same_size && y1 > y0 &&
+         memcmp(mk->glyphs + (y1 - 1) * width, gbuf + (y1 - 1) * width,
+                width * sizeof(Glyph)) == 0)
+    --y1;
+  if (is_same_size && y0 == y1)
+    return;
+  // Past half of the grid, the rows around the changes are most of it, and
+  // it's quicker to just start over.
+  if (is_same_size && (y1 - y0) * 2 <= height) {
+    marker_mark_window(mk, gbuf, mbuf, height, width, y0, y1, live_index);
+    return;
+  }
+  marker_mark_all(mk, gbuf, mbuf, height, width, live_index);
+  mk->height = height;
+  mk->width = width;
+  mk->is_valid = true;
 }
@@ -1,13 +1,145 @@
 #pragma once
 #include "base.h"
 #include "vmio.h"
+#include <pthread.h>
 
+// Bitset of the cells in a glyph buffer which hold something other than '.',
+// one row of 64-bit words per grid row. When one is passed to orca_run(), the
+// VM only visits the cells which have their bit set, and it keeps the bits up
+// to date as operators write to the grid. Anything else which writes to the
+// glyph buffer between ticks (like a text editor) needs to report the change
+// with live_index_update_rect(), or call live_index_invalidate() to have the
+// whole thing rebuilt at the start of the next tick.
+typedef struct {
+  U64 *bits;
+  Usz height, width, row_words, capacity;
+  bool is_valid;
+} Live_index;
+
+void live_index_init(Live_index *li);
+void live_index_deinit(Live_index *li);
+void live_index_invalidate(Live_index *li);
+void live_index_rebuild(Live_index *li, Glyph const *gbuf, Usz height,
+                        Usz width);
+void live_index_update_rect(Live_index *li, Glyph const *gbuf, Usz height,
+                            Usz width, Usz y, Usz x, Usz rect_h, Usz rect_w);
+
+enum { Unique_random_sequence_max = 36 }; // For values 0-9 and A-Z
+
+typedef struct {
+  Usz sequence[Unique_random_sequence_max];
+  Usz current_index;
+  Usz sequence_size;
+  bool initialized;
+  Usz last_min; // Add these to detect range changes
+  Usz last_max; // and force reinitialization
+} Unique_random_state;
+
+// Kept small, since there's one for every cell in the grid.
+typedef struct {
+  U8 current_index; // Current position in waveform
+  bool initialized;
+  U8 last_rate;  // Track rate changes
+  U8 last_shape; // Track shape changes
+} Bouncer_state;
+
+// State that some operators carry over from one tick to the next. Each grid
+// being run needs its own, so that VMs running at the same time (on different
+// threads, even) don't affect each other. Per-cell state is only allocated
+// once an operator needs it, and it's sized to the grid. If the grid changes
+// size, that state starts over.
+typedef struct {
+  Unique_random_state unique_random; // Shared by every $ in the grid
+  Bouncer_state *bouncers;           // Indexed by y * width + x
+  Usz bouncers_height, bouncers_width;
+  U32 random_state; // For shuffling the $ sequence
+} Orca_vm;
+
+void orca_vm_init(Orca_vm *vm);
+void orca_vm_deinit(Orca_vm *vm);
+// Forgets all operator state, as if the grid was being run for the first
+// time.
+void orca_vm_reset(Orca_vm *vm);
+
+typedef struct {
+  Usz y0, y1;              // Rows [y0, y1)
+  Oevent_list oevent_list; // Moved to the caller's list after the tick
+  bool escaped;            // An operator in it tried to reach another band
+} Orca_band;
+
+// Threads for orca_run() to spread a tick over. Before each tick, the grid is
+// cut into horizontal bands at rows which no operator can read, write or mark
+// across, given the operators in the grid at that point and where their
+// inputs point them. The bands then run at the same time, which gives the
+// same results as running the whole grid top to bottom. If there are no such
+// rows, the tick runs on the calling thread as usual. If an operator's inputs
+// change during the tick so that it would reach into another band, the tick
+// is started over and run on the calling thread.
+typedef struct {
+  pthread_t *threads; // thread_count - 1 of them; orca_run() is the other one
+  Usz thread_count;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond, done_cond;
+  Orca_band *bands;
+  Usz band_count, bands_capacity;
+  struct Orca_band_row *rows; // Per-row summary used to place the cuts
+  Usz rows_capacity;
+  // Copies to start the tick over from, if it goes wrong
+  Glyph *gbuf_backup;
+  Bouncer_state *bouncers_backup;
+  Usz gbuf_backup_capacity, bouncers_backup_capacity;
+  Usz careful_ticks;
+  Usz skip_ticks, skip_backoff; // For grids that can't be split
+  // The tick being run. Guarded by `lock`.
+  struct Orca_band_job const *job;
+  Usz next_band, bands_finished;
+  U64 generation;
+  bool quit;
+} Orca_band_pool;
+
+// `thread_count` includes the thread that calls orca_run(). If starting a
+// thread fails, the pool makes do with the ones it has.
+void orca_band_pool_init(Orca_band_pool *pool, Usz thread_count);
+void orca_band_pool_deinit(Orca_band_pool *pool);
+
+// Keeps the marks for a grid that isn't running up to date as it's edited, so
+// that the ports, locks and stuns can be shown. Instead of running a tick on a
+// copy of the grid, each operator sets its marks as if nothing it writes gets
+// written: no glyphs are changed, no events are made, and no operator state is
+// touched. The glyphs the marks are for are kept, along with which operators
+// ran, and when some rows have changed, only the operators that can reach them
+// are run again, along with the ones below that run differently because of it.
+typedef struct {
+  Glyph *glyphs;
+  Mark *marks, *old_marks; // Scratch, for the rows being marked again
+  // The operators that ran, a bit per cell and 64 to a word, and how far the
+  // ones in each row reach. The old ones are what they were before the rows
+  // being marked again were.
+  U64 *ran, *old_ran;
+  struct Orca_band_row *rows, *old_rows;
+  Usz height, width, cells_capacity, words_capacity, rows_capacity;
+  bool is_valid;
+} Orca_marker;
+
+void orca_marker_init(Orca_marker *mk);
+void orca_marker_deinit(Orca_marker *mk);
+// Call after anything else writes to the marks, like running a tick. The next
+// update then marks the whole grid.
+void orca_marker_invalidate(Orca_marker *mk);
+// Brings the marks in `mbuf` up to date with the glyphs in `gbuf`, which has
+// to be the same mark buffer as last time unless the marker was invalidated.
+// Only rows [y0, y1) of the grid may have changed since the last update. `y1`
+// may be past the end of the grid. `live_index` may be NULL.
+void orca_marker_update(Orca_marker *mk, Glyph const *gbuf, Mark *mbuf,
+                        Usz height, Usz width, Usz y0, Usz y1,
+                        Live_index *live_index);
+
+// The marks in `mbuffer` from any previous run are cleared by orca_run as it
+// goes. `live_index` may be NULL, in which case every cell is visited.
+// `band_pool` may be NULL, in which case the tick runs on the calling thread.
 void orca_run(Glyph *restrict gbuffer, Mark *restrict mbuffer, Usz height,
               Usz width, Usz tick_number, Oevent_list *oevent_list,
-              Usz random_seed);
-
-// BOORCH
-extern Usz last_random_unique;
-void reset_last_unique_value(void);
+              Usz random_seed, Orca_vm *vm, Live_index *live_index,
+              Orca_band_pool *band_pool);
 
 void midi_panic(Oevent_list *oevent_list);
@@ -0,0 +1,392 @@
+#include "snapshot.h"
+
+//////// Snapshot encoding
+//
+// All numbers are unsigned LEB128 varints, except where noted.
+//
+//   "ORCS" version(byte)
+//   tick_num random_seed height width
+//   glyphs: a list of pieces, until height * width glyphs have been given.
+//     Each starts with n = (count << 1) | is_literal. A literal piece is
+//     followed by `count` glyph bytes. Otherwise it's followed by one glyph
+//     byte, repeated `count` times.
+//   unique random: initialized(byte) current_index sequence_size last_min
+//     last_max, then sequence_size values
+//   random_state: 4 bytes, little-endian
+//   bouncers: count, then for each: the number of cells skipped since the
+//     previous one, and current_index last_rate last_shape (bytes)
+
+enum {
+  Snapshot_version = 1,
+  Snapshot_min_run = 3, // Shorter runs of the same glyph are left in literals
+};
+
+static char const snapshot_magic[4] = {'O', 'R', 'C', 'S'};
+
+void orca_snapshot_init(Orca_snapshot *snap) {
+  snap->data = NULL;
+  snap->size = 0;
+  snap->capacity = 0;
+  snap->tick_num = 0;
+}
+
+void orca_snapshot_deinit(Orca_snapshot *snap) { free(snap->data); }
+
+static void snap_put_bytes(Orca_snapshot *snap, void const *bytes, Usz count) {
+  Usz size = snap->size;
+  if (snap->capacity - size < count) {
+    Usz capacity = orca_round_up_power2(size + count);
+    if (capacity < 256)
+      capacity = 256;
+    snap->data = realloc(snap->data, capacity);
+    snap->capacity = capacity;
+  }
+  memcpy(snap->data + size, bytes, count);
+  snap->size = size + count;
+}
+
+static void snap_put_byte(Orca_snapshot *snap, U8 byte) {
+  snap_put_bytes(snap, &byte, 1);
+}
+
+static void snap_put_varint(Orca_snapshot *snap, U64 value) {
+  U8 bytes[10];
+  Usz count = 0;
+  do {
+    U8 byte = (U8)(value & 0x7Fu);
+    value >>= 7;
+    bytes[count++] = value ? (U8)(byte | 0x80u) : byte;
+  } while (value);
+  snap_put_bytes(snap, bytes, count);
+}
+
+static void snap_put_glyphs(Orca_snapshot *snap, Glyph const *gbuf,
+                            Usz count) {
+  Usz i = 0, literal_start = 0;
+  while (i < count) {
+    Glyph g = gbuf[i];
+    Usz run = 1;
+    while (i + run < count && gbuf[i + run] == g)
+      ++run;
+    if (run < Snapshot_min_run) {
+      i += run;
+      continue;
+    }
+    if (i > literal_start) {
+      snap_put_varint(snap, (U64)(i - literal_start) << 1 | 1u);
+      snap_put_bytes(snap, gbuf + literal_start, i - literal_start);
+    }
+    snap_put_varint(snap, (U64)run << 1);
+    snap_put_byte(snap, (U8)g);
+    i += run;
+    literal_start = i;
+  }
+  if (count > literal_start) {
+    snap_put_varint(snap, (U64)(count - literal_start) << 1 | 1u);
+    snap_put_bytes(snap, gbuf + literal_start, count - literal_start);
+  }
+}
+
+void orca_snapshot_save(Orca_snapshot *snap, Field const *field,
+                        Orca_vm const *vm, Usz tick_num, Usz random_seed) {
+  Usz height = field->height, width = field->width;
+  snap->size = 0;
+  snap->tick_num = tick_num;
+  snap_put_bytes(snap, snapshot_magic, sizeof snapshot_magic);
+  snap_put_byte(snap, Snapshot_version);
+  snap_put_varint(snap, tick_num);
+  snap_put_varint(snap, random_seed);
+  snap_put_varint(snap, height);
+  snap_put_varint(snap, width);
+  snap_put_glyphs(snap, field->buffer, height * width);
+  Unique_random_state const *ur = &vm->unique_random;
+  snap_put_byte(snap, ur->initialized ? 1 : 0);
+  snap_put_varint(snap, ur->current_index);
+  snap_put_varint(snap, ur->sequence_size);
+  snap_put_varint(snap, ur->last_min);
+  snap_put_varint(snap, ur->last_max);
+  for (Usz i = 0; i < ur->sequence_size; ++i) {
+    snap_put_varint(snap, ur->sequence[i]);
+  }
+  U32 rs = vm->random_state;
+  U8 rs_bytes[4] = {(U8)rs, (U8)(rs >> 8), (U8)(rs >> 16), (U8)(rs >> 24)};
+  snap_put_bytes(snap, rs_bytes, sizeof rs_bytes);
+  // Bouncer state for a grid of a different size would be thrown away by the
+  // next tick, so it's the same as having none.
+  Bouncer_state const *bouncers = vm->bouncers;
+  Usz bouncer_count = 0;
+  if (bouncers && vm->bouncers_height == height &&
+      vm->bouncers_width == width) {
+    for (Usz i = 0; i < height * width; ++i) {
+      bouncer_count += bouncers[i].initialized;
+    }
+  }
+  snap_put_varint(snap, bouncer_count);
+  for (Usz i = 0, next = 0; bouncer_count > 0; ++i) {
+    Bouncer_state const *b = bouncers + i;
+    if (!b->initialized)
+      continue;
+    snap_put_varint(snap, i - next);
+    U8 fields[3] = {b->current_index, b->last_rate, b->last_shape};
+    snap_put_bytes(snap, fields, sizeof fields);
+    next = i + 1;
+    --bouncer_count;
+  }
+}
+
+//////// Snapshot decoding
+
+typedef struct {
+  U8 const *p, *end;
+  bool ok;
+} Snap_reader;
+
+static U8 const *snap_get_bytes(Snap_reader *r, Usz count) {
+  if (!r->ok || (Usz)(r->end - r->p) < count) {
+    r->ok = false;
+    return NULL;
+  }
+  U8 const *bytes = r->p;
+  r->p += count;
+  return bytes;
+}
+
+static U8 snap_get_byte(Snap_reader *r) {
+  U8 const *byte = snap_get_bytes(r, 1);
+  return byte ? *byte : 0;
+}
+
+static U64 snap_get_varint(Snap_reader *r) {
+  U64 value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    U8 byte = snap_get_byte(r);
+    value |= (U64)(byte & 0x7Fu) << shift;
+    if (!(byte & 0x80u))
+      return value;
+  }
+  r->ok = false;
+  return 0;
+}
+
+// Fails if the value is more than `max`.
+static Usz snap_get_usz(Snap_reader *r, Usz max) {
+  U64 value = snap_get_varint(r);
+  if (value > max) {
+    r->ok = false;
+    return 0;
+  }
+  return (Usz)value;
+}
+
+static void snap_get_glyphs(Snap_reader *r, Glyph *gbuf, Usz count) {
+  Usz filled = 0;
+  while (r->ok && filled < count) {
+    U64 piece = snap_get_varint(r);
+    U64 piece_count = piece >> 1;
+    if (piece_count == 0 || piece_count > count - filled) {
+      r->ok = false;
+      break;
+    }
+    Usz n = (Usz)piece_count;
+    if (piece & 1u) {
+      U8 const *bytes = snap_get_bytes(r, n);
+      if (bytes)
+        memcpy(gbuf + filled, bytes, n);
+    } else {
+      memset(gbuf + filled, snap_get_byte(r), n);
+    }
+    filled += n;
+  }
+}
+
+bool orca_snapshot_load(Orca_snapshot const *snap, Field *field, Orca_vm *vm,
+                        Usz *out_tick_num, Usz *out_random_seed) {
+  Snap_reader r = {snap->data, snap->data + snap->size, true};
+  U8 const *magic = snap_get_bytes(&r, sizeof snapshot_magic);
+  if (!magic || memcmp(magic, snapshot_magic, sizeof snapshot_magic) ||
+      snap_get_byte(&r) != Snapshot_version)
+    return false;
+  Usz tick_num = snap_get_usz(&r, SIZE_MAX);
+  Usz random_seed = snap_get_usz(&r, SIZE_MAX);
+  Usz height = snap_get_usz(&r, ORCA_Y_MAX);
+  Usz width = snap_get_usz(&r, ORCA_X_MAX);
+  if (!r.ok)
+    return false;
+  // Decode into temporaries first, so that bad data doesn't leave the field
+  // and VM half-loaded.
+  Usz cells = height * width;
+  Glyph *gbuf = malloc(cells ? cells : 1);
+  if (!gbuf)
+    return false;
+  snap_get_glyphs(&r, gbuf, cells);
+  Unique_random_state ur;
+  memset(&ur, 0, sizeof ur);
+  ur.initialized = snap_get_byte(&r) != 0;
+  ur.current_index = snap_get_usz(&r, Unique_random_sequence_max);
+  ur.sequence_size = snap_get_usz(&r, Unique_random_sequence_max);
+  ur.last_min = snap_get_usz(&r, SIZE_MAX);
+  ur.last_max = snap_get_usz(&r, SIZE_MAX);
+  if (ur.current_index > ur.sequence_size)
+    r.ok = false;
+  for (Usz i = 0; r.ok && i < ur.sequence_size; ++i) {
+    ur.sequence[i] = snap_get_usz(&r, SIZE_MAX);
+  }
+  U8 const *rs_bytes = snap_get_bytes(&r, 4);
+  U32 random_state = 0;
+  if (rs_bytes)
+    random_state = (U32)rs_bytes[0] | (U32)rs_bytes[1] << 8 |
+                   (U32)rs_bytes[2] << 16 | (U32)rs_bytes[3] << 24;
+  if (random_state == 0) // xorshift32 would be stuck
+    r.ok = false;
+  Usz bouncer_count = snap_get_usz(&r, cells);
+  Bouncer_state *bouncers = NULL;
+  if (r.ok && bouncer_count > 0) {
+    bouncers = calloc(cells, sizeof(Bouncer_state));
+    if (!bouncers)
+      r.ok = false;
+  }
+  for (Usz i = 0, next = 0; r.ok && i < bouncer_count; ++i) {
+    Usz index = next + snap_get_usz(&r, cells - next - 1);
+    U8 const *fields = snap_get_bytes(&r, 3);
+    if (!fields)
+      break;
+    Bouncer_state *b = bouncers + index;
+    b->current_index = fields[0];
+    b->initialized = true;
+    b->last_rate = fields[1];
+    b->last_shape = fields[2];
+    next = index + 1;
+    if (next == cells && i + 1 < bouncer_count)
+      r.ok = false;
+  }
+  if (!r.ok || r.p != r.end) {
+    free(gbuf);
+    free(bouncers);
+    return false;
+  }
+  field_resize_raw(field, height, width);
+  memcpy(field->buffer, gbuf, cells * sizeof(Glyph));
+  free(gbuf);
+  orca_vm_reset(vm);
+  vm->unique_random = ur;
+  vm->random_state = random_state;
+  if (bouncers) {
+    vm->bouncers = bouncers;
+    vm->bouncers_height = height;
+    vm->bouncers_width = width;
+  }
+  *out_tick_num = tick_num;
+  *out_random_seed = random_seed;
+  return true;
+}
+
+//////// Checkpoints
+
+void orca_checkpoints_init(Orca_checkpoints *cps, Usz interval, Usz limit) {
+  cps->snapshots = NULL;
+  cps->count = 0;
+  cps->capacity = 0;
+  cps->interval = interval > 0 ? interval : 1;
+  cps->limit = limit > 2 ? limit : 2;
+}
+
+void orca_checkpoints_deinit(Orca_checkpoints *cps) {
+  for (Usz i = 0; i < cps->capacity; ++i) {
+    orca_snapshot_deinit(cps->snapshots + i);
+  }
+  free(cps->snapshots);
+}
+
+// Dropped snapshots are moved past `count` instead of freed, so their buffers
+// get reused.
+static void checkpoints_thin_out(Orca_checkpoints *cps) {
+  Usz interval = cps->interval * 2, kept = 0;
+  for (Usz i = 0; i < cps->count; ++i) {
+    if (cps->snapshots[i].tick_num % interval)
+      continue;
+    Orca_snapshot tmp = cps->snapshots[kept];
+    cps->snapshots[kept] = cps->snapshots[i];
+    cps->snapshots[i] = tmp;
+    ++kept;
+  }
+  cps->count = kept;
+  cps->interval = interval;
+}
+
+void orca_checkpoints_maybe_save(Orca_checkpoints *cps, Field const *field,
+                                 Orca_vm const *vm, Usz tick_num,
+                                 Usz random_seed) {
+  while (cps->count >= cps->limit)
+    checkpoints_thin_out(cps);
+  if (tick_num % cps->interval)
+    return;
+  // Usually it goes at the end.
+  Usz i = cps->count;
+  while (i > 0 && cps->snapshots[i - 1].tick_num >= tick_num)
+    --i;
+  if (i == cps->count || cps->snapshots[i].tick_num != tick_num) {
+    if (cps->count == cps->capacity) {
+      Usz capacity = cps->capacity ? cps->capacity * 2 : 16;
+      cps->snapshots =
+          realloc(cps->snapshots, capacity * sizeof(Orca_snapshot));
+      for (Usz j = cps->capacity; j < capacity; ++j) {
+        orca_snapshot_init(cps->snapshots + j);
+      }
+      cps->capacity = capacity;
+    }
+    Orca_snapshot spare = cps->snapshots[cps->count];
+    memmove(cps->snapshots + i + 1, cps->snapshots + i,
+            (cps->count - i) * sizeof(Orca_snapshot));
+    cps->snapshots[i] = spare;
+    ++cps->count;
+  }
+  orca_snapshot_save(cps->snapshots + i, field, vm, tick_num, random_seed);
+}
+
+void orca_checkpoints_forget_from(Orca_checkpoints *cps, Usz tick_num) {
+  while (cps->count > 0 && cps->snapshots[cps->count - 1].tick_num >= tick_num)
+    --cps->count;
+}
+
+//////// Seeking
+
+bool orca_seek(Orca_checkpoints *cps, Usz target_tick, Field *field,
+               Mbuf_reusable *mbuf_r, Oevent_list *scratch_oevent_list,
+               Orca_vm *vm, Live_index *live_index, Orca_band_pool *band_pool,
+               Usz *tick_num, Usz *random_seed) {
+  Orca_snapshot const *from = NULL;
+  for (Usz i = cps->count; i > 0; --i) {
+    if (cps->snapshots[i - 1].tick_num <= target_tick) {
+      from = cps->snapshots + i - 1;
+      break;
+    }
+  }
+  Usz current = *tick_num;
+  if (current <= target_tick && (!from || from->tick_num <= current))
+    from = NULL; // Running forward from here is quickest
+  else if (!from)
+    return false;
+  Usz tick = current;
+  bool loaded = false;
+  if (from) {
+    if (!orca_snapshot_load(from, field, vm, &tick, random_seed))
+      return false;
+    loaded = true;
+    if (live_index)
+      live_index_invalidate(live_index);
+    mbuf_reusable_ensure_size(mbuf_r, field->height, field->width);
+    memset(mbuf_r->buffer, 0,
+           (Usz)field->height * (Usz)field->width * sizeof(Mark));
+  }
+  // Saving can move the checkpoints around, so `from` isn't used past here.
+  Usz height = field->height, width = field->width, first_tick = tick;
+  for (; tick < target_tick; ++tick) {
+    if (!loaded || tick != first_tick)
+      orca_checkpoints_maybe_save(cps, field, vm, tick, *random_seed);
+    oevent_list_clear(scratch_oevent_list);
+    orca_run(field->buffer, mbuf_r->buffer, height, width, tick,
+             scratch_oevent_list, *random_seed, vm, live_index, band_pool);
+  }
+  *tick_num = tick;
+  return true;
+}
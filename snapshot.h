@@ -0,0 +1,67 @@
+#pragma once
+#include "base.h"
+#include "field.h"
+#include "sim.h"
+
+// Everything needed to pick up running a grid from a given tick and get the
+// same results as if it had been run from the start: the glyphs, the tick
+// number, the random seed, and the operator state in Orca_vm. (The marks
+// aren't included -- they get cleared and rebuilt by every tick anyway.)
+//
+// The state is packed into a byte buffer. Runs of the same glyph, like the
+// empty parts of a grid, are stored as a count, and per-cell operator state is
+// only stored for the cells that have some.
+typedef struct {
+  U8 *data;
+  Usz size, capacity;
+  Usz tick_num; // Also stored in `data`, kept here for searching
+} Orca_snapshot;
+
+void orca_snapshot_init(Orca_snapshot *snap);
+void orca_snapshot_deinit(Orca_snapshot *snap);
+void orca_snapshot_save(Orca_snapshot *snap, Field const *field,
+                        Orca_vm const *vm, Usz tick_num, Usz random_seed);
+// Returns false, without changing anything, if the snapshot data is bad.
+// Otherwise `field` is resized and filled in, and `vm` is replaced.
+bool orca_snapshot_load(Orca_snapshot const *snap, Field *field, Orca_vm *vm,
+                        Usz *out_tick_num, Usz *out_random_seed);
+
+enum {
+  Orca_checkpoint_interval_default = 64,
+  Orca_checkpoint_limit_default = 256,
+};
+
+// Snapshots taken every `interval` ticks while a grid runs, sorted by tick.
+// When there would be more than `limit` of them, every other one is dropped
+// and the interval is doubled, so that a long session keeps checkpoints
+// spread over all of it without using more and more memory.
+typedef struct {
+  Orca_snapshot *snapshots;
+  Usz count, capacity;
+  Usz interval, limit;
+} Orca_checkpoints;
+
+void orca_checkpoints_init(Orca_checkpoints *cps, Usz interval, Usz limit);
+void orca_checkpoints_deinit(Orca_checkpoints *cps);
+// Call before running the tick `tick_num`. Saves a checkpoint if it's time
+// for one.
+void orca_checkpoints_maybe_save(Orca_checkpoints *cps, Field const *field,
+                                 Orca_vm const *vm, Usz tick_num,
+                                 Usz random_seed);
+// Drops the checkpoints at or after `tick_num`. Call this when the grid is
+// changed by something other than the VM, since the later checkpoints no
+// longer match what running the grid would give.
+void orca_checkpoints_forget_from(Orca_checkpoints *cps, Usz tick_num);
+
+// Brings the grid and the VM to where they would be just before running the
+// tick `target_tick`. If that's ahead of `*tick_num`, the grid is run forward
+// from where it is. Otherwise, or if a checkpoint is closer, the nearest
+// checkpoint at or before `target_tick` is loaded and run forward from there.
+// Checkpoints are saved along the way. Output events from the ticks that are
+// run are thrown away, and the marks in `mbuf_r` are left from the last one
+// run (or cleared, if none was). Returns false, without changing anything, if
+// there's no way to reach `target_tick`.
+bool orca_seek(Orca_checkpoints *cps, Usz target_tick, Field *field,
+               Mbuf_reusable *mbuf_r, Oevent_list *scratch_oevent_list,
+               Orca_vm *vm, Live_index *live_index, Orca_band_pool *band_pool,
+               Usz *tick_num, Usz *random_seed);
@@ -2,15 +2,6 @@
 #include "base.h"
 #include <ncurses.h>
 
-#if (defined(__GNUC__) || defined(__clang__)) && defined(__has_attribute)
-#if __has_attribute(format)
-#define ORCA_TERM_UTIL_PRINTF(...) __attribute__((format(printf, __VA_ARGS__)))
-#endif
-#endif
-#ifndef ORCA_TERM_UTIL_PRINTF
-#define ORCA_TERM_UTIL_PRINTF(...)
-#endif
-
 #define CTRL_PLUS(c) ((c)&037)
 
 struct oso;
@@ -127,7 +118,7 @@ void qblock_set_title(Qblock *qb, char const *title);
 
 Qmsg *qmsg_push(int height, int width);
 Qmsg *qmsg_printf_push(char const *title, char const *fmt, ...)
-    ORCA_TERM_UTIL_PRINTF(2, 3);
+    ORCA_PRINTF(2, 3);
 WINDOW *qmsg_window(Qmsg *qm);
 void qmsg_set_title(Qmsg *qm, char const *title);
 void qmsg_set_dismiss_mode(Qmsg *qm, Qmsg_dismiss_mode mode);
@@ -143,7 +134,7 @@ int qmenu_id(Qmenu const *qm);
 void qmenu_set_title(Qmenu *qm, char const *title);
 void qmenu_add_choice(Qmenu *qm, int id, char const *text);
 void qmenu_add_printf(Qmenu *qm, int id, char const *fmt, ...)
-    ORCA_TERM_UTIL_PRINTF(3, 4);
+    ORCA_PRINTF(3, 4);
 void qmenu_add_spacer(Qmenu *qm);
 void qmenu_set_current_item(Qmenu *qm, int id);
 void qmenu_push_to_nav(Qmenu *qm);
@@ -165,5 +156,3 @@ bool qform_get_single_text_line(Qform const *qf, struct oso **out);
 struct oso *qform_get_nonempty_single_line_input(Qform *qf);
 
 extern Qnav_stack qnav_stack;
-
-#undef ORCA_TERM_UTIL_PRINTF
@@ -3,31 +3,25 @@
 #include "gbuffer.h"
 #include "osc_out.h"
 #include "oso.h"
+#include "player.h"
 #include "sim.h"
+#include "snapshot.h"
 #include "sysmisc.h"
 #include "term_util.h"
 #include "vmio.h"
 #include <getopt.h>
 #include <locale.h>
+#include <poll.h>
 
 #define SOKOL_IMPL
 #include "sokol_time.h"
 #undef SOKOL_IMPL
 
-#ifdef FEAT_PORTMIDI
-#include <portmidi.h>
-#endif
-
 #if NCURSES_VERSION_PATCH < 20081122
 int _nc_has_mouse(void);
 #define has_mouse _nc_has_mouse
 #endif
 
-#define TIME_DEBUG 0
-#if TIME_DEBUG
-static int spin_track_timeout = 0;
-#endif
-
 #define staticni ORCA_NOINLINE static
 
 staticni void usage(void) { // clang-format off
@@ -35,15 +29,27 @@ fprintf(stderr,
 "Usage: orca [options] [file]\n\n"
 "General options:\n"
 "    --undo-limit <number>  Set the maximum number of undo steps.\n"
-"                           If you plan to work with large files,\n"
-"                           set this to a low number.\n"
 "                           Default: 100\n"
+"    --undo-memory <MiB>    Set the most memory the undo steps can\n"
+"                           use. The oldest ones are forgotten to\n"
+"                           stay under it, but the last one is kept.\n"
+"                           Default: 64\n"
 "    --initial-size <nxn>   When creating a new grid file, use these\n"
 "                           starting dimensions.\n"
 "    --bpm <number>         Set the tempo (beats per minute).\n"
 "                           Default: 120\n"
 "    --seed <number>        Set the seed for the random function.\n"
 "                           Default: 1\n"
+"    --bands <number>       Run each timestep on up to this many\n"
+"                           threads, by splitting the grid into\n"
+"                           horizontal bands that don't affect each\n"
+"                           other. Only worth it for very big grids.\n"
+"                           Default: 1\n"
+"    --max-fps <number>     Draw the grid at most this many times a\n"
+"                           second. Ticks that come faster are\n"
+"                           shown together, and counted in the HUD.\n"
+"                           0 draws after every tick.\n"
+"                           Default: 60\n"
 "    -h or --help           Print this message and exit.\n"
 "\n"
 "OSC/MIDI options:\n"
@@ -51,6 +57,24 @@ fprintf(stderr,
 "        Attempt to reduce timing jitter of outgoing MIDI and OSC\n"
 "        messages. Uses more CPU time. May have no effect.\n"
 "\n"
+"    --midi-lookahead <number>\n"
+"        Delay PortMidi output by this many milliseconds, and time\n"
+"        each message from when its step was due, so that delays of\n"
+"        up to that long in running a step don't cause jitter.\n"
+"        0 sends each message as soon as it's ready.\n"
+"        Default: 1\n"
+"\n"
+"    --osc-bundles\n"
+"        Send the OSC messages from each step together, in one OSC\n"
+"        bundle timetagged with when the step was due, instead of as a\n"
+"        UDP datagram each. Bundles too big for one datagram are split.\n"
+"        Not every OSC receiver understands bundles.\n"
+"\n"
+"    --osc-extra-dest <[host:]port>\n"
+"        When OSC output is on, also send everything to this host and\n"
+"        port. Can be given more than once. Each message is encoded\n"
+"        once and the same bytes are sent to every destination.\n"
+"\n"
 "    --osc-midi-bidule <path>\n"
 "        Set MIDI to be sent via OSC formatted for Plogue Bidule.\n"
 "        The path argument is the path of the Plogue OSC MIDI device.\n"
@@ -66,6 +90,7 @@ typedef enum {
   Glyph_class_movement,
   Glyph_class_numeric,
   Glyph_class_bang,
+  Glyph_class_count,
 } Glyph_class;
 
 static Glyph_class glyph_class_of(Glyph glyph) {
@@ -107,8 +132,7 @@ static Glyph_class glyph_class_of(Glyph glyph) {
   return Glyph_class_unknown;
 }
 
-static attr_t term_attrs_of_cell(Glyph g, Mark m) {
-  Glyph_class gclass = glyph_class_of(g);
+static attr_t term_attrs_of_cell(Glyph_class gclass, Mark m) {
   attr_t attr = A_normal;
   switch (gclass) {
   case Glyph_class_unknown:
@@ -131,6 +155,8 @@ static attr_t term_attrs_of_cell(Glyph g, Mark m) {
   case Glyph_class_bang:
     attr = A_bold | Cdef_normal;
     break;
+  case Glyph_class_count:
+    break;
   }
   if (gclass != Glyph_class_comment) {
     if ((m & (Mark_flag_lock | Mark_flag_input)) ==
@@ -154,6 +180,31 @@ static attr_t term_attrs_of_cell(Glyph g, Mark m) {
   return attr;
 }
 
+// The mark flags that term_attrs_of_cell() looks at.
+enum {
+  Cell_attrs_mark_mask = Mark_flag_input | Mark_flag_output |
+                         Mark_flag_haste_input | Mark_flag_lock,
+};
+
+// The class of every glyph, and term_attrs_of_cell() for every class and
+// mark, so that drawing a cell takes two lookups instead of a pile of
+// branches. Filled in by cell_attrs_init().
+static U8 glyph_class_table[256];
+static attr_t cell_attrs_table[Glyph_class_count][Cell_attrs_mark_mask + 1];
+
+staticni void cell_attrs_init(void) {
+  for (Usz i = 0; i < 256; ++i)
+    glyph_class_table[i] = (U8)glyph_class_of((Glyph)i);
+  for (Usz c = 0; c < Glyph_class_count; ++c) {
+    for (Usz m = 0; m <= Cell_attrs_mark_mask; ++m)
+      cell_attrs_table[c][m] = term_attrs_of_cell((Glyph_class)c, (Mark)m);
+  }
+}
+
+static ORCA_FORCEINLINE attr_t cell_attrs(Glyph g, Mark m) {
+  return cell_attrs_table[glyph_class_table[(U8)g]][m & Cell_attrs_mark_mask];
+}
+
 typedef enum {
   Ged_input_mode_normal = 0,
   Ged_input_mode_append,
@@ -303,94 +354,306 @@ staticni void draw_grid_cursor(WINDOW *win, int draw_y, int draw_x, int draw_h,
   }
 }
 
+// The undo history keeps one whole copy of the grid, `top`, as it was when
+// the last step was pushed. Each step before that is a delta that turns the
+// grid of the step after it back into its own: for each row that changed, the
+// span from the first to the last changed cell, with the glyphs it had. If the
+// grid was resized in between, the delta is the whole old grid instead.
+//
+// The history is limited to `limit` steps and `budget` bytes, counting `top`.
+// The oldest steps are dropped to stay under both, but the newest one is
+// always kept.
+//
+// So that pushing and popping don't have to compare or copy the whole grid,
+// the history also keeps the range of rows the live grid can differ from `top`
+// in. Whatever edits the grid marks the rows it's about to change, after
+// pushing, with undo_history_mark_rows(), or undo_history_mark_all() if it
+// could change any of them. Running a tick can change any row too, which the
+// history notices from the player's count of ticks run. (Not from the tick
+// number, which resetting, seeking and undoing all move backwards.)
+typedef struct {
+  U16 y, x, len;
+} Undo_span;
+
 typedef struct Undo_node {
-  Field field;
-  Usz tick_num;
   struct Undo_node *prev, *next;
+  Usz tick_num;
+  U16 height, width;
+  bool is_whole; // `glyphs` is the whole grid, with no spans
+  Usz span_count;
+  Usz size; // Bytes, including this
+  Undo_span *spans;
+  Glyph *glyphs;
 } Undo_node;
 
 typedef struct {
   Undo_node *first, *last;
-  Usz count, limit;
+  Field top;
+  Usz top_tick_num;
+  bool has_top;
+  Usz count, limit; // `count` includes `top`
+  Usz size, budget; // Bytes
+  // The live grid can only differ from `top` in rows [dirty_y0, dirty_y1), if
+  // `*ticks_run` is still `dirty_ticks_run`.
+  Usz dirty_y0, dirty_y1;
+  U64 const *ticks_run;
+  U64 dirty_ticks_run;
+  // Where a delta is collected before it's copied into a node of its own size
+  Undo_span *scratch_spans;
+  Glyph *scratch_glyphs;
+  Usz scratch_spans_cap, scratch_glyphs_cap;
 } Undo_history;
 
-static void undo_history_init(Undo_history *hist, Usz limit) {
+// `ticks_run` is the count of ticks run on the live grid, which has to only
+// ever go up.
+static void undo_history_init(Undo_history *hist, Usz limit, Usz budget,
+                              U64 const *ticks_run) {
   *hist = (Undo_history){0};
+  field_init(&hist->top);
   hist->limit = limit;
+  hist->budget = budget;
+  hist->ticks_run = ticks_run;
 }
 static void undo_history_deinit(Undo_history *hist) {
   Undo_node *a = hist->first;
   while (a) {
     Undo_node *b = a->next;
-    field_deinit(&a->field);
     free(a);
     a = b;
   }
+  field_deinit(&hist->top);
+  free(hist->scratch_spans);
+  free(hist->scratch_glyphs);
+}
+
+static void undo_history_mark_rows(Undo_history *hist, Usz y, Usz h) {
+  if (h == 0)
+    return;
+  if (hist->dirty_y0 >= hist->dirty_y1) {
+    hist->dirty_y0 = y;
+    hist->dirty_y1 = y + h;
+    return;
+  }
+  if (y < hist->dirty_y0)
+    hist->dirty_y0 = y;
+  if (y + h > hist->dirty_y1)
+    hist->dirty_y1 = y + h;
+}
+
+static void undo_history_mark_all(Undo_history *hist) {
+  hist->dirty_y0 = 0;
+  hist->dirty_y1 = SIZE_MAX;
+}
+
+// The rows of a live grid the size of `top` that can differ from it.
+static void undo_history_dirty_rows(Undo_history const *hist, Usz *out_y0,
+                                    Usz *out_y1) {
+  Usz height = hist->top.height;
+  if (*hist->ticks_run != hist->dirty_ticks_run) {
+    *out_y0 = 0;
+    *out_y1 = height;
+    return;
+  }
+  *out_y0 = hist->dirty_y0;
+  *out_y1 = hist->dirty_y1 < height ? hist->dirty_y1 : height;
+}
+
+static Undo_node *undo_node_alloc(Usz span_count, Usz glyph_count,
+                                  Usz tick_num, Field const *field) {
+  Usz size = sizeof(Undo_node) + span_count * sizeof(Undo_span) + glyph_count;
+  Undo_node *node = malloc(size);
+  if (!node)
+    return NULL;
+  node->prev = node->next = NULL;
+  node->tick_num = tick_num;
+  node->height = (U16)field->height;
+  node->width = (U16)field->width;
+  node->is_whole = false;
+  node->span_count = span_count;
+  node->size = size;
+  node->spans = (Undo_span *)(node + 1);
+  node->glyphs = (Glyph *)(node->spans + span_count);
+  return node;
+}
+
+// Makes the delta that turns `field` back into `top`, and makes `top` the
+// same as `field`. Only the rows that can differ are compared, in one pass
+// that collects the spans in the scratch space.
+staticni Undo_node *undo_history_make_delta(Undo_history *hist,
+                                            Field *field) {
+  Field *top = &hist->top;
+  Usz height = top->height, width = top->width;
+  if (height != field->height || width != field->width) {
+    Undo_node *node =
+        undo_node_alloc(0, height * width, hist->top_tick_num, top);
+    if (!node)
+      return NULL;
+    node->is_whole = true;
+    memcpy(node->glyphs, top->buffer, height * width);
+    field_copy(field, top);
+    return node;
+  }
+  Usz y0, y1;
+  undo_history_dirty_rows(hist, &y0, &y1);
+  Usz span_count = 0, glyph_count = 0;
+  for (Usz iy = y0; iy < y1; ++iy) {
+    Glyph const *a = top->buffer + iy * width;
+    Glyph const *b = field->buffer + iy * width;
+    if (memcmp(a, b, width) == 0)
+      continue;
+    Usz x0 = 0, x1 = width;
+    while (a[x0] == b[x0])
+      ++x0;
+    while (a[x1 - 1] == b[x1 - 1])
+      --x1;
+    Usz len = x1 - x0;
+    if (span_count == hist->scratch_spans_cap) {
+      Usz cap = span_count < 16 ? 16 : orca_round_up_power2(span_count + 1);
+      hist->scratch_spans =
+          realloc(hist->scratch_spans, cap * sizeof(Undo_span));
+      hist->scratch_spans_cap = cap;
+    }
+    if (hist->scratch_glyphs_cap - glyph_count < len) {
+      Usz cap = orca_round_up_power2(glyph_count + len);
+      hist->scratch_glyphs = realloc(hist->scratch_glyphs, cap);
+      hist->scratch_glyphs_cap = cap;
+    }
+    hist->scratch_spans[span_count++] =
+        (Undo_span){.y = (U16)iy, .x = (U16)x0, .len = (U16)len};
+    memcpy(hist->scratch_glyphs + glyph_count, a + x0, len);
+    glyph_count += len;
+  }
+  Undo_node *node =
+      undo_node_alloc(span_count, glyph_count, hist->top_tick_num, top);
+  if (!node)
+    return NULL;
+  if (span_count > 0) {
+    memcpy(node->spans, hist->scratch_spans, span_count * sizeof(Undo_span));
+    memcpy(node->glyphs, hist->scratch_glyphs, glyph_count);
+  }
+  for (Usz i = 0; i < span_count; ++i) {
+    Undo_span span = node->spans[i];
+    Usz offset = (Usz)span.y * width + span.x;
+    memcpy(top->buffer + offset, field->buffer + offset, span.len);
+  }
+  return node;
+}
+
+// Turns `field` back into what it was before the node's changes.
+staticni void undo_node_apply(Undo_node const *node, Field *field) {
+  if (node->is_whole) {
+    field_resize_raw(field, node->height, node->width);
+    memcpy(field->buffer, node->glyphs, (Usz)node->height * node->width);
+    return;
+  }
+  Glyph const *glyphs = node->glyphs;
+  for (Usz i = 0; i < node->span_count; ++i) {
+    Undo_span span = node->spans[i];
+    memcpy(field->buffer + (Usz)span.y * field->width + span.x, glyphs,
+           span.len);
+    glyphs += span.len;
+  }
+}
+
+static void undo_history_drop_first(Undo_history *hist) {
+  Undo_node *first = hist->first;
+  hist->first = first->next;
+  if (hist->first)
+    hist->first->prev = NULL;
+  else
+    hist->last = NULL;
+  hist->size -= first->size;
+  --hist->count;
+  free(first);
 }
 
 staticni bool undo_history_push(Undo_history *hist, Field *field,
                                 Usz tick_num) {
   if (hist->limit == 0)
     return false;
-  Undo_node *new_node;
-  if (hist->count == hist->limit) {
-    new_node = hist->first;
-    if (new_node == hist->last) {
-      hist->first = NULL;
-      hist->last = NULL;
-    } else {
-      hist->first = new_node->next;
-      hist->first->prev = NULL;
-    }
-  } else {
-    new_node = malloc(sizeof(Undo_node));
-    if (!new_node)
+  if (hist->has_top) {
+    Usz old_top_size = (Usz)hist->top.height * hist->top.width;
+    Undo_node *node = undo_history_make_delta(hist, field);
+    if (!node)
       return false;
-    ++hist->count;
-    field_init(&new_node->field);
-  }
-  field_copy(field, &new_node->field);
-  new_node->tick_num = tick_num;
-  if (hist->last) {
-    hist->last->next = new_node;
-    new_node->prev = hist->last;
+    node->prev = hist->last;
+    if (hist->last)
+      hist->last->next = node;
+    else
+      hist->first = node;
+    hist->last = node;
+    hist->size -= old_top_size;
+    hist->size += node->size;
   } else {
-    hist->first = new_node;
-    hist->last = new_node;
-    new_node->prev = NULL;
-  }
-  new_node->next = NULL;
-  hist->last = new_node;
+    field_copy(field, &hist->top);
+    hist->has_top = true;
+  }
+  hist->top_tick_num = tick_num;
+  hist->dirty_y0 = hist->dirty_y1 = 0;
+  hist->dirty_ticks_run = *hist->ticks_run;
+  hist->size += (Usz)field->height * field->width;
+  ++hist->count;
+  while (hist->first &&
+         (hist->count > hist->limit || hist->size > hist->budget))
+    undo_history_drop_first(hist);
   return true;
 }
 
+// Makes `field` the same as `top`, copying only the rows that can differ.
+staticni void undo_history_restore_top(Undo_history *hist, Field *field,
+                                       Usz *tick_num) {
+  Field *top = &hist->top;
+  if (field->height != top->height || field->width != top->width) {
+    field_copy(top, field);
+  } else {
+    Usz y0, y1;
+    undo_history_dirty_rows(hist, &y0, &y1);
+    if (y0 < y1)
+      memcpy(field->buffer + y0 * top->width, top->buffer + y0 * top->width,
+             (y1 - y0) * top->width);
+  }
+  *tick_num = hist->top_tick_num;
+  hist->dirty_y0 = hist->dirty_y1 = 0;
+  hist->dirty_ticks_run = *hist->ticks_run;
+}
+
 staticni void undo_history_pop(Undo_history *hist, Field *out_field,
                                Usz *out_tick_num) {
+  if (!hist->has_top)
+    return;
+  undo_history_restore_top(hist, out_field, out_tick_num);
+  hist->size -= (Usz)hist->top.height * hist->top.width;
+  --hist->count;
   Undo_node *last = hist->last;
-  if (!last)
+  if (!last) {
+    hist->has_top = false;
     return;
-  field_copy(&last->field, out_field);
-  *out_tick_num = last->tick_num;
-  if (hist->first == last) {
-    hist->first = NULL;
-    hist->last = NULL;
-  } else {
-    Undo_node *new_last = last->prev;
-    new_last->next = NULL;
-    hist->last = new_last;
   }
-  field_deinit(&last->field);
+  // `top` goes back a step, and the live grid now differs from it where the
+  // delta does.
+  undo_node_apply(last, &hist->top);
+  if (last->is_whole)
+    undo_history_mark_all(hist);
+  else if (last->span_count > 0)
+    undo_history_mark_rows(hist, last->spans[0].y,
+                           last->spans[last->span_count - 1].y + 1u -
+                               last->spans[0].y);
+  hist->top_tick_num = last->tick_num;
+  hist->size -= last->size;
+  hist->size += (Usz)hist->top.height * hist->top.width;
+  hist->last = last->prev;
+  if (hist->last)
+    hist->last->next = NULL;
+  else
+    hist->first = NULL;
   free(last);
-  --hist->count;
 }
 
 staticni void undo_history_apply(Undo_history *hist, Field *out_field,
                                  Usz *out_tick_num) {
-  Undo_node *last = hist->last;
-  if (!last)
+  if (!hist->has_top)
     return;
-  field_copy(&last->field, out_field);
-  *out_tick_num = last->tick_num;
+  undo_history_restore_top(hist, out_field, out_tick_num);
 }
 
 static Usz undo_history_count(Undo_history *hist) { return hist->count; }
@@ -464,7 +727,8 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
                        char const *filename, Usz field_h, Usz field_w,
                        Usz ruler_spacing_y, Usz ruler_spacing_x, Usz tick_num,
                        Usz bpm, Ged_cursor const *ged_cursor,
-                       Ged_input_mode input_mode, Usz activity_counter) {
+                       Ged_input_mode input_mode, Usz activity_counter,
+                       Usz merged_ticks) {
   (void)height;
   (void)width;
   enum { Tabstop = 8 };
@@ -478,6 +742,11 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
   wprintw(win, "%zu", bpm);
   advance_faketab(win, win_x, Tabstop);
   print_activity_indicator(win, activity_counter);
+  if (merged_ticks) {
+    // Ticks that came too fast to each get a frame of their own.
+    advance_faketab(win, win_x, Tabstop);
+    wprintw(win, "%zu merged", merged_ticks);
+  }
   wmove(win, win_y + 1, win_x);
   wprintw(win, "%zu,%zu", ged_cursor->x, ged_cursor->y);
   advance_faketab(win, win_x, Tabstop);
@@ -506,12 +775,65 @@ staticni void draw_hud(WINDOW *win, int win_y, int win_x, int height, int width,
   waddstr(win, filename);
 }
 
+// The glyph and mark of each cell that draw_glyphs_grid() last drew, so that
+// the next time around it only has to redraw the cells that have changed. This
+// only works while the window still has what was drawn in it. Anything that
+// erases the window has to call grid_shadow_invalidate(), and anything that
+// draws over part of the grid has to mark those cells as stale.
+typedef struct {
+  Glyph *glyphs;
+  Mark *marks;
+  Usz rows, cols, capacity;
+  Usz offset_y, offset_x;
+  // The rest of what the drawing depends on. See ged_grid_shadow_begin().
+  int draw_h, draw_w, scroll_y, scroll_x;
+  Usz field_h, field_w, ruler_spacing_y, ruler_spacing_x;
+  bool use_fancy_dots, use_fancy_rulers, is_valid;
+} Grid_shadow;
+
+// Not a mark the VM ever sets, so a cell with it never looks unchanged.
+enum { Grid_shadow_mark_stale = 1 << 7 };
+
+static void grid_shadow_init(Grid_shadow *gs) {
+  gs->glyphs = NULL;
+  gs->marks = NULL;
+  gs->rows = gs->cols = gs->capacity = 0;
+  gs->offset_y = gs->offset_x = 0;
+  gs->is_valid = false;
+}
+static void grid_shadow_deinit(Grid_shadow *gs) {
+  free(gs->glyphs);
+  free(gs->marks);
+}
+static void grid_shadow_invalidate(Grid_shadow *gs) { gs->is_valid = false; }
+// Marks the cells in a rectangle of the field, if they're on screen, as
+// needing to be redrawn.
+staticni void grid_shadow_mark_stale(Grid_shadow *gs, Usz y, Usz x, Usz h,
+                                     Usz w) {
+  Usz y0 = y > gs->offset_y ? y - gs->offset_y : 0;
+  Usz x0 = x > gs->offset_x ? x - gs->offset_x : 0;
+  Usz y1 = y + h > gs->offset_y ? y + h - gs->offset_y : 0;
+  Usz x1 = x + w > gs->offset_x ? x + w - gs->offset_x : 0;
+  if (y1 > gs->rows)
+    y1 = gs->rows;
+  if (x1 > gs->cols)
+    x1 = gs->cols;
+  if (y0 >= y1 || x0 >= x1)
+    return;
+  for (Usz iy = y0; iy < y1; ++iy)
+    memset(gs->marks + iy * gs->cols + x0, Grid_shadow_mark_stale, x1 - x0);
+}
+
+// Only the runs of cells that differ from what's in `shadow` are drawn. If
+// the shadow doesn't have the same number of rows and columns as what's
+// visible, it's resized and everything is drawn.
 staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
                                int draw_w, Glyph const *restrict gbuffer,
                                Mark const *restrict mbuffer, Usz field_h,
                                Usz field_w, Usz offset_y, Usz offset_x,
                                Usz ruler_spacing_y, Usz ruler_spacing_x,
-                               bool use_fancy_dots, bool use_fancy_rulers) {
+                               bool use_fancy_dots, bool use_fancy_rulers,
+                               Grid_shadow *shadow) {
   assert(draw_y >= 0 && draw_x >= 0);
   assert(draw_h >= 0 && draw_w >= 0);
   enum { Bufcount = 4096 };
@@ -531,6 +853,20 @@ staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
     cols = Bufcount;
   if (rows == 0 || cols == 0)
     return;
+  bool draw_all = shadow->rows != rows || shadow->cols != cols;
+  if (draw_all) {
+    Usz count = rows * cols;
+    if (count > shadow->capacity) {
+      Usz capacity = orca_round_up_power2(count);
+      shadow->glyphs = realloc(shadow->glyphs, capacity * sizeof(Glyph));
+      shadow->marks = realloc(shadow->marks, capacity * sizeof(Mark));
+      shadow->capacity = capacity;
+    }
+    shadow->rows = rows;
+    shadow->cols = cols;
+  }
+  shadow->offset_y = offset_y;
+  shadow->offset_x = offset_x;
   bool use_rulers = ruler_spacing_y != 0 && ruler_spacing_x != 0;
   chtype bullet = use_fancy_dots ? ACS_BULLET : '.';
   enum { T = 1 << 0, B = 1 << 1, L = 1 << 2, R = 1 << 3 };
@@ -553,30 +889,48 @@ staticni void draw_glyphs_grid(WINDOW *win, int draw_y, int draw_x, int draw_h,
     Usz line_offset = (offset_y + iy) * field_w + offset_x;
     Glyph const *g_row = gbuffer + line_offset;
     Mark const *m_row = mbuffer + line_offset;
+    Glyph *sg_row = shadow->glyphs + iy * cols;
+    Mark *sm_row = shadow->marks + iy * cols;
+    if (!draw_all && memcmp(g_row, sg_row, cols * sizeof(Glyph)) == 0 &&
+        memcmp(m_row, sm_row, cols * sizeof(Mark)) == 0)
+      continue;
     bool use_y_ruler = use_rulers && (iy + offset_y) % ruler_spacing_y == 0;
-    for (Usz ix = 0; ix < cols; ++ix) {
-      Glyph g = g_row[ix];
-      Mark m = m_row[ix];
-      chtype ch;
-      if (g == '.') {
-        if (use_y_ruler && (ix + offset_x) % ruler_spacing_x == 0) {
-          int p = 0; // clang-format off
-          if (iy + offset_y     == 0      ) p |= T;
-          if (iy + offset_y + 1 == field_h) p |= B;
-          if (ix + offset_x     == 0      ) p |= L;
-          if (ix + offset_x + 1 == field_w) p |= R;
-          ch = rs[p]; // clang-format on
+    Usz ix = 0;
+    for (;;) {
+      if (!draw_all) {
+        while (ix < cols && g_row[ix] == sg_row[ix] && m_row[ix] == sm_row[ix])
+          ++ix;
+      }
+      if (ix == cols)
+        break;
+      Usz run_start = ix;
+      for (; ix < cols; ++ix) {
+        Glyph g = g_row[ix];
+        Mark m = m_row[ix];
+        if (!draw_all && g == sg_row[ix] && m == sm_row[ix])
+          break;
+        sg_row[ix] = g;
+        sm_row[ix] = m;
+        chtype ch;
+        if (g == '.') {
+          if (use_y_ruler && (ix + offset_x) % ruler_spacing_x == 0) {
+            int p = 0; // clang-format off
+            if (iy + offset_y     == 0      ) p |= T;
+            if (iy + offset_y + 1 == field_h) p |= B;
+            if (ix + offset_x     == 0      ) p |= L;
+            if (ix + offset_x + 1 == field_w) p |= R;
+            ch = rs[p]; // clang-format on
+          } else {
+            ch = bullet;
+          }
         } else {
-          ch = bullet;
+          ch = (chtype)g;
         }
-      } else {
-        ch = (chtype)g;
+        chbuffer[ix - run_start] = ch | cell_attrs(g, m);
       }
-      attr_t attrs = term_attrs_of_cell(g, m);
-      chbuffer[ix] = ch | attrs;
+      wmove(win, draw_y + (int)iy, draw_x + (int)run_start);
+      waddchnstr(win, chbuffer, (int)(ix - run_start));
     }
-    wmove(win, draw_y + (int)iy, draw_x);
-    waddchnstr(win, chbuffer, (int)cols);
   }
 }
 
@@ -584,7 +938,8 @@ staticni void draw_glyphs_grid_scrolled(
     WINDOW *win, int draw_y, int draw_x, int draw_h, int draw_w,
     Glyph const *restrict gbuffer, Mark const *restrict mbuffer, Usz field_h,
     Usz field_w, int scroll_y, int scroll_x, Usz ruler_spacing_y,
-    Usz ruler_spacing_x, bool use_fancy_dots, bool use_fancy_rulers) {
+    Usz ruler_spacing_x, bool use_fancy_dots, bool use_fancy_rulers,
+    Grid_shadow *shadow) {
   if (scroll_y < 0) {
     draw_y += -scroll_y;
     scroll_y = 0;
@@ -596,7 +951,7 @@ staticni void draw_glyphs_grid_scrolled(
   draw_glyphs_grid(win, draw_y, draw_x, draw_h, draw_w, gbuffer, mbuffer,
                    field_h, field_w, (Usz)scroll_y, (Usz)scroll_x,
                    ruler_spacing_y, ruler_spacing_x, use_fancy_dots,
-                   use_fancy_rulers);
+                   use_fancy_rulers, shadow);
 }
 
 static void ged_cursor_confine(Ged_cursor *tc, Usz height, Usz width) {
@@ -608,10 +963,48 @@ static void ged_cursor_confine(Ged_cursor *tc, Usz height, Usz width) {
     tc->x = width - 1;
 }
 
-staticni void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list) {
+staticni void draw_oevent_list(WINDOW *win, Oevent_list const *oevent_list,
+                              Player_output_stats const *stats,
+                              Player_clock_stats const *clock_stats,
+                              Oosc_dev const *oosc_dev) {
   wmove(win, 0, 0);
   int win_h = getmaxy(win);
   wprintw(win, "Count: %d", (int)oevent_list->count);
+  U64 sent = stats->sent;
+  wprintw(win,
+          "\tSent: %llu\tDropped: %llu\tLatency: %llu us (avg %llu, max %llu)",
+          (unsigned long long)sent, (unsigned long long)stats->overflows,
+          (unsigned long long)(stats->latency_last_ns / 1000),
+          (unsigned long long)(sent ? stats->latency_sum_ns / sent / 1000 : 0),
+          (unsigned long long)(stats->latency_max_ns / 1000));
+  if (win_h > 1) {
+    U64 deadlines = clock_stats->deadlines;
+    U64 late_avg_ns = deadlines ? clock_stats->late_sum_ns / deadlines : 0;
+    wmove(win, 1, 0);
+    wprintw(win, "Clock late: %llu us (avg %llu, max %llu)\tResyncs: %llu",
+            (unsigned long long)(clock_stats->late_last_ns / 1000),
+            (unsigned long long)(late_avg_ns / 1000),
+            (unsigned long long)(clock_stats->late_max_ns / 1000),
+            (unsigned long long)clock_stats->resyncs);
+    wprintw(win,
+            "\tUDP queue: %llu (max %llu)\tPartial sends: %llu"
+            "\tSend errors: %llu",
+            (unsigned long long)stats->udp_depth_last,
+            (unsigned long long)stats->udp_depth_max,
+            (unsigned long long)stats->udp_partial_sends,
+            (unsigned long long)stats->udp_send_errors);
+  }
+  Usz dest_count = oosc_dev ? oosc_dev_dest_count(oosc_dev) : 0;
+  for (Usz i = 0; i < dest_count; ++i) {
+    int cury = getcury(win);
+    if (cury + 1 >= win_h)
+      return;
+    wmove(win, cury + 1, 0);
+    wprintw(win, "OSC dest %d\t%s\t%s\tSend errors: %llu", (int)i,
+            oosc_dev_dest_name(oosc_dev, i),
+            oosc_dev_dest_is_enabled(oosc_dev, i) ? "on" : "off",
+            (unsigned long long)oosc_dev_dest_send_errors(oosc_dev, i));
+  }
   for (Usz i = 0, num_events = oevent_list->count; i < num_events; ++i) {
     int cury = getcury(win);
     if (cury + 1 >= win_h)
@@ -667,6 +1060,7 @@ staticni void ged_resize_grid(Field *field, Mbuf_reusable *mbr, Usz new_height,
                               Undo_history *undo_hist, Ged_cursor *ged_cursor) {
   assert(new_height > 0 && new_width > 0);
   undo_history_push(undo_hist, field, tick_num);
+  undo_history_mark_all(undo_hist);
   field_copy(field, scratch_field);
   field_resize_raw(field, new_height, new_width);
   // junky copies until i write a smarter thing
@@ -729,616 +1123,167 @@ staticni bool ged_resize_grid_snap_ruler(Field *field, Mbuf_reusable *mbr,
   return true;
 }
 
-typedef enum {
-  Midi_mode_type_null,
-  Midi_mode_type_osc_bidule,
-#ifdef FEAT_PORTMIDI
-  Midi_mode_type_portmidi,
-#endif
-} Midi_mode_type;
-
-typedef struct {
-  Midi_mode_type type;
-} Midi_mode_any;
-
+// Keeps the grid from being drawn more than once every `min_frame_ns`, however
+// fast the ticks come. Ticks run while a frame is held back are all shown by
+// the next one, and counted in `merged_ticks`. While a frame is held back,
+// `is_holding` is set, and the clock thread doesn't wake the UI thread, which
+// is going to wake up for the frame anyway.
 typedef struct {
-  Midi_mode_type type;
-  char const *path;
-} Midi_mode_osc_bidule;
-
-#ifdef FEAT_PORTMIDI
-typedef struct {
-  Midi_mode_type type;
-  PmDeviceID device_id;
-  PortMidiStream *stream;
-} Midi_mode_portmidi;
-// Not sure whether it's OK to call Pm_Terminate() without having a successful
-// call to Pm_Initialize() -- let's just treat it with tweezers.
-static bool portmidi_is_initialized = false;
-#endif
-
-typedef union {
-  Midi_mode_any any;
-  Midi_mode_osc_bidule osc_bidule;
-#ifdef FEAT_PORTMIDI
-  Midi_mode_portmidi portmidi;
-#endif
-} Midi_mode;
-
-void midi_mode_init_null(Midi_mode *mm) { mm->any.type = Midi_mode_type_null; }
-void midi_mode_init_osc_bidule(Midi_mode *mm, char const *path) {
-  mm->osc_bidule.type = Midi_mode_type_osc_bidule;
-  mm->osc_bidule.path = path;
-}
-#ifdef FEAT_PORTMIDI
-enum {
-  Portmidi_artificial_latency = 1,
-};
-struct {
-  U64 clock_base;
-  bool did_init;
-} portmidi_global_data;
-static PmTimestamp portmidi_timestamp_now(void) {
-  if (!portmidi_global_data.did_init) {
-    portmidi_global_data.did_init = true;
-    portmidi_global_data.clock_base = stm_now();
-  }
-  return (PmTimestamp)(stm_ms(stm_since(portmidi_global_data.clock_base)));
-}
-static PmTimestamp portmidi_timeproc(void *time_info) {
-  (void)time_info;
-  return portmidi_timestamp_now();
-}
-static PmError portmidi_init_if_necessary(void) {
-  if (portmidi_is_initialized)
-    return 0;
-  PmError e = Pm_Initialize();
-  if (e)
-    return e;
-  portmidi_is_initialized = true;
-  return 0;
-}
-staticni PmError midi_mode_init_portmidi(Midi_mode *mm, PmDeviceID dev_id) {
-  PmError e = portmidi_init_if_necessary();
-  if (e)
-    goto fail;
-  e = Pm_OpenOutput(&mm->portmidi.stream, dev_id, NULL, 128, portmidi_timeproc,
-                    NULL, Portmidi_artificial_latency);
-  if (e)
-    goto fail;
-  mm->portmidi.type = Midi_mode_type_portmidi;
-  mm->portmidi.device_id = dev_id;
-  return pmNoError;
-fail:
-  midi_mode_init_null(mm);
-  return e;
-}
-// Returns true on success. todo currently output only
-staticni bool portmidi_find_device_id_by_name(char const *name, Usz namelen,
-                                              PmError *out_pmerror,
-                                              PmDeviceID *out_id) {
-  *out_pmerror = portmidi_init_if_necessary();
-  if (*out_pmerror)
-    return false;
-  int num = Pm_CountDevices();
-  for (int i = 0; i < num; ++i) {
-    PmDeviceInfo const *info = Pm_GetDeviceInfo(i);
-    if (!info || !info->output)
-      continue;
-    Usz len = strlen(info->name);
-    if (len != namelen)
-      continue;
-    if (strncmp(name, info->name, namelen) == 0) {
-      *out_id = i;
-      return true;
-    }
-  }
-  return false;
-}
-static bool portmidi_find_name_of_device_id(PmDeviceID id, PmError *out_pmerror,
-                                            oso **out_name) {
-  *out_pmerror = portmidi_init_if_necessary();
-  if (*out_pmerror)
-    return false;
-  int num = Pm_CountDevices();
-  if (id < 0 || id >= num)
-    return false;
-  PmDeviceInfo const *info = Pm_GetDeviceInfo(id);
-  if (!info || !info->output)
-    return false;
-  osoput(out_name, info->name);
-  return true;
-}
-#endif
-staticni void midi_mode_deinit(Midi_mode *mm) {
-  switch (mm->any.type) {
-  case Midi_mode_type_null:
-  case Midi_mode_type_osc_bidule:
-    break;
-#ifdef FEAT_PORTMIDI
-  case Midi_mode_type_portmidi:
-    // Because PortMidi seems to work correctly ony more platforms when using
-    // its timing stuff, we are using it. And because we are using it, and
-    // because it may be buffering events for sending 'later', we might have
-    // pending outgoing MIDI events. We'll need to wait until they finish being
-    // before calling Pm_Close, otherwise users could have problems like MIDI
-    // notes being stuck on. This is slow and blocking, but not much we can do
-    // about it right now.
-    //
-    // TODO use nansleep on platforms that support it.
-    for (U64 start = stm_now();
-         stm_ms(stm_since(start)) <= (double)Portmidi_artificial_latency;)
-      sleep(0);
-    Pm_Close(mm->portmidi.stream);
-    break;
-#endif
-  }
-}
+  U64 min_frame_ns, last_frame_ns;
+  Usz frames, merged_ticks;
+  Usz last_tick_num; // The tick_num when the last frame was drawn
+  bool is_holding;
+} Ged_frames;
 
 typedef struct {
-  Field field;
+  Player player;
   Field scratch_field;
   Field clipboard_field;
-  Mbuf_reusable mbuf_r;
+  Orca_marker marker;
+  Usz remark_y0, remark_y1; // Rows edited since the marker last saw the grid
   Undo_history undo_hist;
-  Oevent_list oevent_list;
-  Oevent_list scratch_oevent_list;
-  Susnote_list susnote_list;
+  Grid_shadow grid_shadow;
   Ged_cursor ged_cursor;
-  Usz tick_num;
   Usz ruler_spacing_y, ruler_spacing_x;
   Ged_input_mode input_mode;
-  Usz bpm;
-  U64 clock;
-  double accum_secs;
-  double time_to_next_note_off;
-  Oosc_dev *oosc_dev;
-  Midi_mode midi_mode;
-  Usz activity_counter;
-  Usz random_seed;
+  Ged_frames frames;
   Usz drag_start_y, drag_start_x;
   int win_h, win_w;
   int softmargin_y, softmargin_x;
   int grid_h;
   int grid_scroll_y, grid_scroll_x; // not sure if i like this being int
-  U8 midi_bclock_sixths;            // 0..5, holds 6th of the quarter note step
   bool needs_remarking : 1;
   bool is_draw_dirty : 1;
-  bool is_playing : 1;
-  bool midi_bclock : 1;
   bool draw_event_list : 1;
   bool is_mouse_down : 1;
   bool is_mouse_dragging : 1;
   bool is_hud_visible : 1;
 } Ged;
 
-static void ged_init(Ged *a, Usz undo_limit, Usz init_bpm, Usz init_seed) {
-  field_init(&a->field);
+static bool ged_is_draw_dirty(Ged *a) {
+  return a->is_draw_dirty || a->needs_remarking || a->player.has_new_tick;
+}
+
+// Rows [y, y + h) of the grid have been edited, or are about to be, so the
+// marks have to be worked out again around them.
+static void ged_remark_rows(Ged *a, Usz y, Usz h) {
+  if (a->remark_y0 >= a->remark_y1) {
+    a->remark_y0 = y;
+    a->remark_y1 = y + h;
+  } else {
+    if (y < a->remark_y0)
+      a->remark_y0 = y;
+    if (y + h > a->remark_y1)
+      a->remark_y1 = y + h;
+  }
+  a->needs_remarking = true;
+}
+
+static void ged_remark_all(Ged *a) {
+  a->remark_y0 = 0;
+  a->remark_y1 = SIZE_MAX;
+  a->needs_remarking = true;
+}
+
+// For when rows [y, y + h) of the grid are about to be edited. Checkpoints
+// from this tick on were taken of a grid that running this one won't lead to,
+// so they're dropped.
+staticni bool ged_push_undo(Ged *a, Usz y, Usz h) {
+  orca_checkpoints_forget_from(&a->player.checkpoints, a->player.tick_num);
+  bool pushed =
+      undo_history_push(&a->undo_hist, &a->player.field, a->player.tick_num);
+  undo_history_mark_rows(&a->undo_hist, y, h);
+  ged_remark_rows(a, y, h);
+  return pushed;
+}
+
+enum {
+  // With no clock thread, or for a resize signal that lands just before the
+  // UI thread starts waiting, the longest the UI thread waits for input.
+  Ui_max_wait_ms = 100,
+};
+
+// Waits, without the lock, for input on stdin, for the clock thread to run a
+// tick, or for `timeout_ms` to pass.
+staticni void ged_wait_for_input(Ged *a, int timeout_ms) {
+  int wake_fd = a->player.clock.wake_fds[0];
+  struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+  if (poll(fds, wake_fd != -1 ? 2 : 1, timeout_ms) > 0 && fds[1].revents) {
+    char buf[64];
+    while (read(wake_fd, buf, sizeof buf) > 0) {
+    }
+  }
+}
+
+// Called by the UI thread with the lock held, when there's something to draw.
+// Returns false if it's too soon after the last frame, and lowers `*timeout_ms`
+// to when it won't be.
+staticni bool ged_frame_is_due(Ged *a, int *timeout_ms) {
+  Ged_frames *fr = &a->frames;
+  U64 now = clock_now_ns(), next = fr->last_frame_ns + fr->min_frame_ns;
+  if (fr->min_frame_ns == 0 || now >= next) {
+    fr->is_holding = false;
+    a->player.clock.wants_wakeups = true;
+    return true;
+  }
+  U64 ms = (next - now + 999999) / 1000000;
+  if (*timeout_ms > (int)ms)
+    *timeout_ms = (int)ms;
+  fr->is_holding = true;
+  a->player.clock.wants_wakeups = false;
+  return false;
+}
+
+static void ged_frame_drawn(Ged *a) {
+  Ged_frames *fr = &a->frames;
+  fr->last_frame_ns = clock_now_ns();
+  ++fr->frames;
+  // Going back, or jumping ahead while paused, isn't merging.
+  if (a->player.is_playing && a->player.tick_num > fr->last_tick_num + 1)
+    fr->merged_ticks += a->player.tick_num - fr->last_tick_num - 1;
+  fr->last_tick_num = a->player.tick_num;
+  fr->is_holding = false;
+  a->player.clock.wants_wakeups = true;
+}
+
+static void ged_init(Ged *a, Usz undo_limit, Usz undo_budget, Usz init_bpm,
+                     Usz init_seed, Usz band_threads, bool strict_timing,
+                     Usz max_fps) {
+  player_init(&a->player, init_bpm, init_seed, band_threads, strict_timing);
+  a->player.clock.wants_wakeups = true;
   field_init(&a->scratch_field);
   field_init(&a->clipboard_field);
-  mbuf_reusable_init(&a->mbuf_r);
-  undo_history_init(&a->undo_hist, undo_limit);
-  oevent_list_init(&a->oevent_list);
-  oevent_list_init(&a->scratch_oevent_list);
-  susnote_list_init(&a->susnote_list);
+  orca_marker_init(&a->marker);
+  undo_history_init(&a->undo_hist, undo_limit, undo_budget,
+                    &a->player.ticks_run);
+  grid_shadow_init(&a->grid_shadow);
   ged_cursor_init(&a->ged_cursor);
-  a->tick_num = 0;
   a->ruler_spacing_y = a->ruler_spacing_x = 8;
   a->input_mode = Ged_input_mode_normal;
-  a->bpm = init_bpm;
-  a->clock = 0;
-  a->accum_secs = 0.0;
-  a->time_to_next_note_off = 1.0;
-  a->oosc_dev = NULL;
-  midi_mode_init_null(&a->midi_mode);
-  a->activity_counter = 0;
-  a->random_seed = init_seed;
   a->drag_start_y = a->drag_start_x = 0;
   a->win_h = a->win_w = 0;
   a->softmargin_y = a->softmargin_x = 0;
   a->grid_h = 0;
   a->grid_scroll_y = a->grid_scroll_x = 0;
-  a->midi_bclock_sixths = 0;
+  a->remark_y0 = a->remark_y1 = 0;
   a->needs_remarking = true;
   a->is_draw_dirty = false;
-  a->is_playing = false;
-  a->midi_bclock = false;
   a->draw_event_list = false;
   a->is_mouse_down = false;
   a->is_mouse_dragging = false;
   a->is_hud_visible = false;
+  a->frames = (Ged_frames){0};
+  a->frames.min_frame_ns = max_fps ? (U64)1000000000 / max_fps : 0;
 }
 
+// Mustn't be called with the lock held.
 static void ged_deinit(Ged *a) {
-  field_deinit(&a->field);
+  player_deinit(&a->player); // Stops the ticks before anything is freed
   field_deinit(&a->scratch_field);
   field_deinit(&a->clipboard_field);
-  mbuf_reusable_deinit(&a->mbuf_r);
+  orca_marker_deinit(&a->marker);
   undo_history_deinit(&a->undo_hist);
-  oevent_list_deinit(&a->oevent_list);
-  oevent_list_deinit(&a->scratch_oevent_list);
-  susnote_list_deinit(&a->susnote_list);
-  if (a->oosc_dev)
-    oosc_dev_destroy(a->oosc_dev);
-  midi_mode_deinit(&a->midi_mode);
-}
-
-static bool ged_is_draw_dirty(Ged *a) {
-  return a->is_draw_dirty || a->needs_remarking;
-}
-
-staticni void send_midi_3bytes(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
-                               int status, int byte1, int byte2) {
-  switch (midi_mode->any.type) {
-  case Midi_mode_type_null:
-    break;
-  case Midi_mode_type_osc_bidule: {
-    if (!oosc_dev)
-      break;
-    oosc_send_int32s(oosc_dev, midi_mode->osc_bidule.path,
-                     (int[]){status, byte1, byte2}, 3);
-    break;
-  }
-#ifdef FEAT_PORTMIDI
-  case Midi_mode_type_portmidi: {
-    // timestamp is totally fake, to prevent problems with some MIDI systems
-    // getting angry if there's no timestamping info.
-    //
-    // Eventually, we will want to create real timestamps based on a real orca
-    // clock, instead of ad-hoc at the last moment like this. When we do that,
-    // we'll need to thread the timestamping/timing info through the function
-    // calls, instead of creating it at the last moment here. (This timestamp
-    // is actually 'useless', because it doesn't convey any additional
-    // information. But if we don't provide it, at least to PortMidi, some
-    // people's MIDI setups may malfunction and have terrible timing problems.)
-    PmTimestamp pm_timestamp = portmidi_timestamp_now();
-    PmError pme = Pm_WriteShort(midi_mode->portmidi.stream, pm_timestamp,
-                                Pm_Message(status, byte1, byte2));
-    (void)pme;
-    break;
-  }
-#endif
-  }
-}
-
-static void send_midi_chan_msg(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
-                               int type /*0..15*/, int chan /*0.. 15*/,
-                               int byte1 /*0..127*/, int byte2 /*0..127*/) {
-  send_midi_3bytes(oosc_dev, midi_mode, type << 4 | chan, byte1, byte2);
-}
-
-static void send_midi_byte(Oosc_dev *oosc_dev, Midi_mode const *midi_mode,
-                           int x) {
-  // PortMidi wants 0 and 0 for the unused bytes. Likewise, Bidule's
-  // MIDI-via-OSC won't accept the message unless there are at least all 3
-  // bytes, with the second 2 set to zero.
-  send_midi_3bytes(oosc_dev, midi_mode, x, 0, 0);
-}
-
-staticni void //
-send_midi_note_offs(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
-                    Susnote const *start, Susnote const *end) {
-  for (; start != end; ++start) {
-#if 0
-    float under = start->remaining;
-    if (under < 0.0) {
-      fprintf(stderr, "cutoff slop: %f\n", under);
-    }
-#endif
-    U16 chan_note = start->chan_note;
-    send_midi_chan_msg(oosc_dev, midi_mode, 0x8, chan_note >> 8,
-                       chan_note & 0xFF, 0);
-  }
-}
-
-static void send_control_message(Oosc_dev *oosc_dev, char const *osc_address) {
-  if (!oosc_dev)
-    return;
-  oosc_send_int32s(oosc_dev, osc_address, NULL, 0);
-}
-
-static void send_num_message(Oosc_dev *oosc_dev, char const *osc_address,
-                             I32 num) {
-  if (!oosc_dev)
-    return;
-  I32 nums[1];
-  nums[0] = num;
-  oosc_send_int32s(oosc_dev, osc_address, nums, ORCA_ARRAY_COUNTOF(nums));
-}
-
-staticni void apply_time_to_sustained_notes(Oosc_dev *oosc_dev,
-                                            Midi_mode *midi_mode,
-                                            double time_elapsed,
-                                            Susnote_list *susnote_list,
-                                            double *next_note_off_deadline) {
-  Usz start_removed, end_removed;
-  susnote_list_advance_time(susnote_list, time_elapsed, &start_removed,
-                            &end_removed, next_note_off_deadline);
-  if (ORCA_UNLIKELY(start_removed != end_removed)) {
-    Susnote const *restrict susnotes_off = susnote_list->buffer;
-    send_midi_note_offs(oosc_dev, midi_mode, susnotes_off + start_removed,
-                        susnotes_off + end_removed);
-  }
-}
-
-staticni void ged_stop_all_sustained_notes(Ged *a) {
-  Susnote_list *sl = &a->susnote_list;
-  send_midi_note_offs(a->oosc_dev, &a->midi_mode, sl->buffer,
-                      sl->buffer + sl->count);
-  susnote_list_clear(sl);
-  a->time_to_next_note_off = 1.0;
-}
-
-// The way orca handles MIDI sustains, timing, and overlapping note-ons (plus
-// the 'mono' thing being added) has changed multiple times over time. Now we
-// are in a situation where this function is a complete mess and needs an
-// overhaul. If you see something in the function below and think, "wait, that
-// seems redundant/weird", that's because it is, not because there's a good
-// reason.
-
-staticni void send_output_events(Oosc_dev *oosc_dev, Midi_mode *midi_mode,
-                                 Usz bpm, Susnote_list *susnote_list,
-                                 Oevent const *events, Usz count) {
-  enum { Midi_on_capacity = 512 };
-  typedef struct {
-    U8 channel;
-    U8 note_number;
-    U8 velocity;
-  } Midi_note_on;
-  typedef struct {
-    U8 note_number;
-    U8 velocity;
-    U8 duration;
-  } Midi_mono_on;
-  Midi_note_on midi_note_ons[Midi_on_capacity];
-  Midi_mono_on midi_mono_ons[16]; // Keep only a single one per channel
-  Susnote new_susnotes[Midi_on_capacity];
-  Usz midi_note_count = 0;
-  Usz monofied_chans = 0; // bitset of channels with new mono notes
-  double frame_secs = 60.0 / (double)bpm / 4.0;
-
-  for (Usz i = 0; i < count; ++i) {
-    Oevent const *e = events + i;
-    switch ((Oevent_types)e->any.oevent_type) {
-    case Oevent_type_midi_note: {
-      if (midi_note_count == Midi_on_capacity)
-        break;
-      Oevent_midi_note const *em = &e->midi_note;
-      Usz note_number = (Usz)(12u * em->octave + em->note);
-      if (note_number > 127)
-        note_number = 127;
-      Usz channel = em->channel;
-      if (channel > 15)
-        break;
-      if (em->mono) {
-        // 'mono' note-ons are strange. The more typical branch you'd expect to
-        // see, where you can play multiple notes per channel, is below.
-        monofied_chans |= 1u << (channel & 0xFu);
-        midi_mono_ons[channel] = (Midi_mono_on){.note_number = (U8)note_number,
-                                                .velocity = em->velocity,
-                                                .duration = em->duration};
-      } else {
-        midi_note_ons[midi_note_count] =
-            (Midi_note_on){.channel = (U8)channel,
-                           .note_number = (U8)note_number,
-                           .velocity = em->velocity};
-        new_susnotes[midi_note_count] =
-            (Susnote){.remaining = (float)(frame_secs * (double)em->duration),
-                      .chan_note = (U16)((channel << 8u) | note_number)};
-        ++midi_note_count;
-      }
-      break;
-    }
-    case Oevent_type_midi_cc: {
-      Oevent_midi_cc const *ec = &e->midi_cc;
-      // Note that we're not preserving the exact order of MIDI events as
-      // emitted by the orca VM. Notes and CCs that are emitted in the same
-      // step will always have the CCs sent first. Not sure if this is OK or
-      // not. If it's not OK, we can either loop again a second time to always
-      // send CCs after notes, or if that's not also OK, we can make the stack
-      // buffer more complicated and interleave the CCs in it.
-      send_midi_chan_msg(oosc_dev, midi_mode, 0xb, ec->channel, ec->control,
-                         ec->value);
-      break;
-    }
-    case Oevent_type_midi_pb: {
-      Oevent_midi_pb const *ep = &e->midi_pb;
-      // Same caveat regarding ordering with MIDI CC also applies here.
-      send_midi_chan_msg(oosc_dev, midi_mode, 0xe, ep->channel, ep->lsb,
-                         ep->msb);
-      break;
-    }
-    case Oevent_type_osc_ints: {
-      // kinda lame
-      if (!oosc_dev)
-        continue;
-      Oevent_osc_ints const *eo = &e->osc_ints;
-      char path[] = {'/', eo->glyph, '\0'};
-      I32 ints[ORCA_ARRAY_COUNTOF(eo->numbers)];
-      Usz nnum = eo->count;
-      for (Usz inum = 0; inum < nnum; ++inum) {
-        ints[inum] = eo->numbers[inum];
-      }
-      oosc_send_int32s(oosc_dev, path, ints, nnum);
-      break;
-    }
-    case Oevent_type_udp_string: {
-      // if (!oosc_dev)
-      //   continue;
-      // Oevent_udp_string const *eo = &e->udp_string;
-      // oosc_send_datagram(oosc_dev, eo->chars, eo->count);
-      break;
-    }
-    }
-  }
-
-do_note_ons:
-  if (midi_note_count > 0) {
-    Usz start_note_offs, end_note_offs;
-    susnote_list_add_notes(susnote_list, new_susnotes, midi_note_count,
-                           &start_note_offs, &end_note_offs);
-    if (start_note_offs != end_note_offs) {
-      Susnote const *restrict susnotes_off = susnote_list->buffer;
-      send_midi_note_offs(oosc_dev, midi_mode, susnotes_off + start_note_offs,
-                          susnotes_off + end_note_offs);
-    }
-    for (Usz i = 0; i < midi_note_count; ++i) {
-      Midi_note_on mno = midi_note_ons[i];
-      send_midi_chan_msg(oosc_dev, midi_mode, 0x9, mno.channel, mno.note_number,
-                         mno.velocity);
-    }
-  }
-  if (monofied_chans) {
-    // The behavior we end up with is that if regular note-ons are played in
-    // the same frame/step as a mono, the regular note-ons will have the actual
-    // MIDI note on sent, followed immediately by a MIDI note off. I don't know
-    // if this is good or not.
-    Usz start_note_offs, end_note_offs;
-    susnote_list_remove_by_chan_mask(susnote_list, monofied_chans,
-                                     &start_note_offs, &end_note_offs);
-    if (start_note_offs != end_note_offs) {
-      Susnote const *restrict susnotes_off = susnote_list->buffer;
-      send_midi_note_offs(oosc_dev, midi_mode, susnotes_off + start_note_offs,
-                          susnotes_off + end_note_offs);
-    }
-    midi_note_count = 0; // We're going to use this list again. Reset it.
-    for (Usz i = 0; i < 16; i++) { // Add these notes to list of note-ons
-      if (!(monofied_chans & 1u << i))
-        continue;
-      midi_note_ons[midi_note_count] =
-          (Midi_note_on){.channel = (U8)i,
-                         .note_number = midi_mono_ons[i].note_number,
-                         .velocity = midi_mono_ons[i].velocity};
-      new_susnotes[midi_note_count] = (Susnote){
-          .remaining = (float)(frame_secs * (double)midi_mono_ons[i].duration),
-          .chan_note = (U16)((i << 8u) | midi_mono_ons[i].note_number)};
-      midi_note_count++;
-    }
-    monofied_chans = false;
-    goto do_note_ons; // lol super wasteful for doing susnotes again
-  }
-}
-
-staticni void ged_clear_osc_udp(Ged *a) {
-  if (a->oosc_dev) {
-    if (a->midi_mode.any.type == Midi_mode_type_osc_bidule) {
-      ged_stop_all_sustained_notes(a);
-    }
-    oosc_dev_destroy(a->oosc_dev);
-    a->oosc_dev = NULL;
-  }
-}
-static bool ged_is_using_osc_udp(Ged *a) { return (bool)a->oosc_dev; }
-static bool ged_set_osc_udp(Ged *a, char const *dest_addr,
-                            char const *dest_port) {
-  ged_clear_osc_udp(a);
-  if (dest_port) {
-    Oosc_udp_create_error err =
-        oosc_dev_create_udp(&a->oosc_dev, dest_addr, dest_port);
-    if (err) {
-      return false;
-    }
-  }
-  return true;
-}
-
-static ORCA_FORCEINLINE double ms_to_sec(double ms) { return ms / 1000.0; }
-
-static double ged_secs_to_deadline(Ged const *a) {
-  if (!a->is_playing)
-    return 1.0;
-  double secs_span = 60.0 / (double)a->bpm / 4.0;
-  // If MIDI beat clock output is enabled, we need to send an event every 24
-  // parts per quarter note. Since we've already divided quarter notes into 4
-  // for ORCA's timing semantics, divide it by a further 6. This same logic is
-  // mirrored in ged_do_stuff().
-  if (a->midi_bclock)
-    secs_span /= 6.0;
-  double rem = secs_span - (stm_sec(stm_since(a->clock)) + a->accum_secs);
-  double next_note_off = a->time_to_next_note_off;
-  if (next_note_off < rem)
-    rem = next_note_off;
-  if (rem < 0.0)
-    rem = 0.0;
-  return rem;
-}
-
-staticni void clear_and_run_vm(Glyph *restrict gbuf, Mark *restrict mbuf,
-                               Usz height, Usz width, Usz tick_number,
-                               Oevent_list *oevent_list, Usz random_seed) {
-  mbuffer_clear(mbuf, height, width);
-  oevent_list_clear(oevent_list);
-  orca_run(gbuf, mbuf, height, width, tick_number, oevent_list, random_seed);
-}
-
-staticni void ged_do_stuff(Ged *a) {
-  if (!a->is_playing)
-    return;
-  double secs_span = 60.0 / (double)a->bpm / 4.0;
-  if (a->midi_bclock) // see also ged_secs_to_deadline()
-    secs_span /= 6.0;
-  Oosc_dev *oosc_dev = a->oosc_dev;
-  Midi_mode *midi_mode = &a->midi_mode;
-  bool crossed_deadline = false;
-#if TIME_DEBUG
-  Usz spins = 0;
-  U64 spin_start = stm_now();
-  (void)spin_start;
-#endif
-  for (;;) {
-    U64 now = stm_now();
-    U64 diff = stm_diff(now, a->clock);
-    double sdiff = stm_sec(diff) + a->accum_secs;
-    if (sdiff >= secs_span) {
-      a->clock = now;
-      a->accum_secs = sdiff - secs_span;
-#if TIME_DEBUG
-      if (a->accum_secs > 0.000001) {
-        fprintf(stderr, "late: %.2f u-secs\n", a->accum_secs * 1000 * 1000);
-        if (a->accum_secs > 0.00005) {
-          fprintf(stderr, "guilty timeout: %d\n", spin_track_timeout);
-        }
-      }
-#endif
-      crossed_deadline = true;
-      break;
-    }
-    if (secs_span - sdiff > ms_to_sec(0.1))
-      break;
-#if TIME_DEBUG
-    ++spins;
-#endif
-  }
-#if TIME_DEBUG
-  if (spins > 0) {
-    fprintf(stderr, "%d spins in %f us with timeout %d\n", (int)spins,
-            stm_us(stm_since(spin_start)), spin_track_timeout);
-  }
-#endif
-  if (!crossed_deadline)
-    return;
-  if (a->midi_bclock) {
-    send_midi_byte(oosc_dev, midi_mode, 0xF8); // MIDI beat clock
-    Usz sixths = a->midi_bclock_sixths;
-    a->midi_bclock_sixths = (U8)((sixths + 1) % 6);
-    if (sixths != 0)
-      return;
-  }
-  apply_time_to_sustained_notes(oosc_dev, midi_mode, secs_span,
-                                &a->susnote_list, &a->time_to_next_note_off);
-  clear_and_run_vm(a->field.buffer, a->mbuf_r.buffer, a->field.height,
-                   a->field.width, a->tick_num, &a->oevent_list,
-                   a->random_seed);
-  ++a->tick_num;
-  a->needs_remarking = true;
-  a->is_draw_dirty = true;
-
-  Usz count = a->oevent_list.count;
-  if (count > 0) {
-    send_output_events(oosc_dev, midi_mode, a->bpm, &a->susnote_list,
-                       a->oevent_list.buffer, count);
-    a->activity_counter += count;
-  }
+  grid_shadow_deinit(&a->grid_shadow);
 }
 
 static inline Isz isz_clamp(Isz x, Isz low, Isz high) {
@@ -1373,9 +1318,9 @@ staticni void ged_make_cursor_visible(Ged *a) {
   int cur_scr_y = a->grid_scroll_y;
   int cur_scr_x = a->grid_scroll_x;
   int new_scr_y = (int)scroll_offset_on_axis_for_cursor_pos(
-      grid_h, (Isz)a->field.height, (Isz)a->ged_cursor.y, 5, cur_scr_y);
+      grid_h, (Isz)a->player.field.height, (Isz)a->ged_cursor.y, 5, cur_scr_y);
   int new_scr_x = (int)scroll_offset_on_axis_for_cursor_pos(
-      a->win_w, (Isz)a->field.width, (Isz)a->ged_cursor.x, 5, cur_scr_x);
+      a->win_w, (Isz)a->player.field.width, (Isz)a->ged_cursor.x, 5, cur_scr_x);
   if (new_scr_y == cur_scr_y && new_scr_x == cur_scr_x)
     return;
   a->grid_scroll_y = new_scr_y;
@@ -1390,8 +1335,8 @@ staticni void ged_update_internal_geometry(Ged *a) {
   int softmargin_y = a->softmargin_y;
   bool show_hud = win_h > Hud_height + 1;
   int grid_h = show_hud ? win_h - Hud_height : win_h;
-  if (grid_h > a->field.height) {
-    int halfy = (grid_h - a->field.height + 1) / 2;
+  if (grid_h > a->player.field.height) {
+    int halfy = (grid_h - a->player.field.height + 1) / 2;
     grid_h -= halfy < softmargin_y ? halfy : softmargin_y;
   }
   a->grid_h = grid_h;
@@ -1412,75 +1357,121 @@ staticni void ged_set_window_size(Ged *a, int win_h, int win_w,
   ged_make_cursor_visible(a);
 }
 
+// Returns false if what's in the grid shadow can't be used to draw the grid
+// the way it is now, and the window has to be erased and drawn from scratch.
+// Either way, the shadow is set up to be used for drawing it after this.
+staticni bool ged_grid_shadow_begin(Ged *a, bool use_fancy_dots,
+                                    bool use_fancy_rulers) {
+  Grid_shadow *gs = &a->grid_shadow;
+  if (gs->is_valid && gs->draw_h == a->grid_h && gs->draw_w == a->win_w &&
+      gs->scroll_y == a->grid_scroll_y && gs->scroll_x == a->grid_scroll_x &&
+      gs->field_h == a->player.field.height &&
+      gs->field_w == a->player.field.width &&
+      gs->ruler_spacing_y == a->ruler_spacing_y &&
+      gs->ruler_spacing_x == a->ruler_spacing_x &&
+      gs->use_fancy_dots == use_fancy_dots &&
+      gs->use_fancy_rulers == use_fancy_rulers)
+    return true;
+  gs->draw_h = a->grid_h;
+  gs->draw_w = a->win_w;
+  gs->scroll_y = a->grid_scroll_y;
+  gs->scroll_x = a->grid_scroll_x;
+  gs->field_h = a->player.field.height;
+  gs->field_w = a->player.field.width;
+  gs->ruler_spacing_y = a->ruler_spacing_y;
+  gs->ruler_spacing_x = a->ruler_spacing_x;
+  gs->use_fancy_dots = use_fancy_dots;
+  gs->use_fancy_rulers = use_fancy_rulers;
+  gs->rows = gs->cols = 0; // Makes draw_glyphs_grid() draw every cell
+  gs->is_valid = true;
+  return false;
+}
+
+// Only what has changed since the last time is drawn, so the window has to be
+// left as it was, unless grid_shadow_invalidate() is called.
 staticni void ged_draw(Ged *a, WINDOW *win, char const *filename,
                        bool use_fancy_dots, bool use_fancy_rulers) {
-  // We can predictavely step the next simulation tick and then use the
-  // resulting mark buffer for better UI visualization. If we don't do this,
-  // after loading a fresh file or after the user performs some edit (or even
-  // after a regular simulation step), the new glyph buffer won't have had
-  // phase 0 of the simulation run, which means the ports and other flags won't
-  // be set on the mark buffer, so the colors for disabled cells, ports, etc.
-  // won't be set.
-  //
-  // We can just perform a simulation step using the current state, keep the
-  // mark buffer that it produces, then roll back the glyph buffer to where it
-  // was before. This should produce results similar to having specialized UI
-  // code that looks at each glyph and figures out the ports, etc.
-  if (a->needs_remarking && !a->is_playing) {
-    field_resize_raw_if_necessary(&a->scratch_field, a->field.height,
-                                  a->field.width);
-    field_copy(&a->field, &a->scratch_field);
-    mbuf_reusable_ensure_size(&a->mbuf_r, a->field.height, a->field.width);
-    clear_and_run_vm(a->scratch_field.buffer, a->mbuf_r.buffer, a->field.height,
-                     a->field.width, a->tick_num, &a->scratch_oevent_list,
-                     a->random_seed);
+  // When paused, after loading a file or after the user performs some edit
+  // (or even after a regular simulation step), the marks in the mark buffer
+  // aren't for the glyphs in the grid, so the colors for disabled cells,
+  // ports, etc. would be wrong. The marker works out the marks the next tick
+  // would set, without running it, and only for the rows near the edits.
+  if (a->player.has_new_tick) {
+    // The tick changed the grid without the marker seeing it.
+    orca_marker_invalidate(&a->marker);
+    a->needs_remarking = true;
+    a->player.has_new_tick = false;
+  }
+  if (a->needs_remarking && !a->player.is_playing) {
+    mbuf_reusable_ensure_size(&a->player.mbuf_r, a->player.field.height,
+                              a->player.field.width);
+    orca_marker_update(&a->marker, a->player.field.buffer,
+                       a->player.mbuf_r.buffer, a->player.field.height,
+                       a->player.field.width, a->remark_y0, a->remark_y1,
+                       &a->player.live_index);
+    a->remark_y0 = a->remark_y1 = 0;
     a->needs_remarking = false;
   }
   int win_w = a->win_w;
+  if (!ged_grid_shadow_begin(a, use_fancy_dots, use_fancy_rulers)) {
+    werase(win);
+  } else if (a->grid_h < a->win_h) {
+    // The HUD is small, so just redo all of it.
+    wmove(win, a->grid_h, 0);
+    wclrtobot(win);
+  }
   draw_glyphs_grid_scrolled(
-      win, 0, 0, a->grid_h, win_w, a->field.buffer, a->mbuf_r.buffer,
-      a->field.height, a->field.width, a->grid_scroll_y, a->grid_scroll_x,
-      a->ruler_spacing_y, a->ruler_spacing_x, use_fancy_dots, use_fancy_rulers);
-  draw_grid_cursor(win, 0, 0, a->grid_h, win_w, a->field.buffer,
-                   a->field.height, a->field.width, a->grid_scroll_y,
-                   a->grid_scroll_x, a->ged_cursor.y, a->ged_cursor.x,
-                   a->ged_cursor.h, a->ged_cursor.w, a->input_mode,
-                   a->is_playing);
+      win, 0, 0, a->grid_h, win_w, a->player.field.buffer,
+      a->player.mbuf_r.buffer, a->player.field.height, a->player.field.width,
+      a->grid_scroll_y, a->grid_scroll_x, a->ruler_spacing_y,
+      a->ruler_spacing_x, use_fancy_dots, use_fancy_rulers, &a->grid_shadow);
+  draw_grid_cursor(win, 0, 0, a->grid_h, win_w, a->player.field.buffer,
+                   a->player.field.height, a->player.field.width,
+                   a->grid_scroll_y, a->grid_scroll_x, a->ged_cursor.y,
+                   a->ged_cursor.x, a->ged_cursor.h, a->ged_cursor.w,
+                   a->input_mode, a->player.is_playing);
+  // The cursor and selection are drawn over the grid, so the cells under them
+  // have to be drawn again next time, even if they haven't changed.
+  grid_shadow_mark_stale(&a->grid_shadow, a->ged_cursor.y, a->ged_cursor.x,
+                         a->ged_cursor.h ? a->ged_cursor.h : 1,
+                         a->ged_cursor.w ? a->ged_cursor.w : 1);
   if (a->is_hud_visible) {
     filename = filename ? filename : "unnamed";
     int hud_x = win_w > 50 + a->softmargin_x * 2 ? a->softmargin_x : 0;
     draw_hud(win, a->grid_h, hud_x, Hud_height, win_w, filename,
-             a->field.height, a->field.width, a->ruler_spacing_y,
-             a->ruler_spacing_x, a->tick_num, a->bpm, &a->ged_cursor,
-             a->input_mode, a->activity_counter);
+             a->player.field.height, a->player.field.width, a->ruler_spacing_y,
+             a->ruler_spacing_x, a->player.tick_num, a->player.bpm,
+             &a->ged_cursor, a->input_mode, a->player.activity_counter,
+             a->frames.merged_ticks);
+  }
+  if (a->draw_event_list) {
+    Player_output_stats stats = player_output_stats(&a->player);
+    draw_oevent_list(win, &a->player.oevent_list, &stats,
+                     &a->player.clock.stats, a->player.oosc_dev);
+    grid_shadow_invalidate(&a->grid_shadow); // Drawn over all of it
   }
-  if (a->draw_event_list)
-    draw_oevent_list(win, &a->oevent_list);
   a->is_draw_dirty = false;
-}
-
-staticni void ged_send_osc_bpm(Ged *a, I32 bpm) {
-  send_num_message(a->oosc_dev, "/orca/bpm", bpm);
+  ged_frame_drawn(a);
 }
 
 staticni void ged_adjust_bpm(Ged *a, Isz delta_bpm) {
-  Isz new_bpm = (Isz)a->bpm;
+  Isz new_bpm = (Isz)a->player.bpm;
   if (delta_bpm < 0 || new_bpm < INT_MAX - delta_bpm)
     new_bpm += delta_bpm;
   else
     new_bpm = INT_MAX;
   if (new_bpm < 1)
     new_bpm = 1;
-  if ((Usz)new_bpm != a->bpm) {
-    a->bpm = (Usz)new_bpm;
+  if ((Usz)new_bpm != a->player.bpm) {
+    a->player.bpm = (Usz)new_bpm;
     a->is_draw_dirty = true;
-    ged_send_osc_bpm(a, (I32)new_bpm);
+    player_send_osc_bpm(&a->player, (I32)new_bpm);
   }
 }
 
 static void ged_move_cursor_relative(Ged *a, Isz delta_y, Isz delta_x) {
-  ged_cursor_move_relative(&a->ged_cursor, a->field.height, a->field.width,
-                           delta_y, delta_x);
+  ged_cursor_move_relative(&a->ged_cursor, a->player.field.height,
+                           a->player.field.width, delta_y, delta_x);
   ged_make_cursor_visible(a);
   a->is_draw_dirty = true;
 }
@@ -1512,7 +1503,7 @@ staticni bool ged_try_selection_clipped_to_field(Ged const *a, Usz *out_y,
                                                  Usz *out_w) {
   Usz curs_y = a->ged_cursor.y, curs_x = a->ged_cursor.x;
   Usz curs_h = a->ged_cursor.h, curs_w = a->ged_cursor.w;
-  Usz field_h = a->field.height, field_w = a->field.width;
+  Usz field_h = a->player.field.height, field_w = a->player.field.width;
   if (curs_y >= field_h || curs_x >= field_w)
     return false;
   if (field_h - curs_y < curs_h)
@@ -1540,12 +1531,15 @@ staticni bool ged_slide_selection(Ged *a, int delta_y, int delta_x) {
   if (curs_y_0 == curs_y_1 && curs_x_0 == curs_x_1 && curs_h_0 == curs_h_1 &&
       curs_w_0 == curs_w_1)
     return false;
-  undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-  Usz field_h = a->field.height;
-  Usz field_w = a->field.width;
-  gbuffer_copy_subrect(a->field.buffer, a->field.buffer, field_h, field_w,
-                       field_h, field_w, curs_y_0, curs_x_0, curs_y_1, curs_x_1,
-                       curs_h_0, curs_w_0);
+  if (curs_y_1 > curs_y_0)
+    ged_push_undo(a, curs_y_0, curs_y_1 - curs_y_0 + curs_h_0);
+  else
+    ged_push_undo(a, curs_y_1, curs_y_0 - curs_y_1 + curs_h_0);
+  Usz field_h = a->player.field.height;
+  Usz field_w = a->player.field.width;
+  gbuffer_copy_subrect(a->player.field.buffer, a->player.field.buffer, field_h,
+                       field_w, field_h, field_w, curs_y_0, curs_x_0, curs_y_1,
+                       curs_x_1, curs_h_0, curs_w_0);
   // Erase/clear the area that was within the selection rectangle in the
   // starting position, but wasn't written to during the copy. (In other words,
   // this is the area that was 'left behind' when we moved the selection
@@ -1567,11 +1561,14 @@ staticni bool ged_slide_selection(Ged *a, int delta_y, int delta_x) {
     ex = curs_x_1 + curs_w_0;
     ew = (curs_x_0 + curs_w_0) - ex;
   }
-  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, ey, curs_x_0, eh,
-                       curs_w_0, '.');
-  gbuffer_fill_subrect(a->field.buffer, field_h, field_w, curs_y_0, ex,
+  gbuffer_fill_subrect(a->player.field.buffer, field_h, field_w, ey, curs_x_0,
+                       eh, curs_w_0, '.');
+  gbuffer_fill_subrect(a->player.field.buffer, field_h, field_w, curs_y_0, ex,
                        curs_h_0, ew, '.');
-  a->needs_remarking = true;
+  live_index_update_rect(&a->player.live_index, a->player.field.buffer, field_h,
+                         field_w, curs_y_0, curs_x_0, curs_h_0, curs_w_0);
+  live_index_update_rect(&a->player.live_index, a->player.field.buffer, field_h,
+                         field_w, curs_y_1, curs_x_1, curs_h_0, curs_w_0);
   return true;
 }
 
@@ -1668,8 +1665,10 @@ ORCA_OK_IF_UNUSED staticni void ged_mouse_event(Ged *a, Usz vis_y, Usz vis_x,
     a->drag_start_y = 0;
     a->drag_start_x = 0;
   } else if ((mouse_bstate & BUTTON1_PRESSED) || a->is_mouse_down) {
-    Usz y = view_to_scrolled_grid(a->field.height, vis_y, a->grid_scroll_y);
-    Usz x = view_to_scrolled_grid(a->field.width, vis_x, a->grid_scroll_x);
+    Usz y =
+        view_to_scrolled_grid(a->player.field.height, vis_y, a->grid_scroll_y);
+    Usz x =
+        view_to_scrolled_grid(a->player.field.width, vis_x, a->grid_scroll_x);
     if (!a->is_mouse_down) {
       // some sequence to hopefully make terminal start reporting all further
       // mouse movement events. 'REPORT_MOUSE_POSITION' alone in the mousemask
@@ -1683,6 +1682,7 @@ ORCA_OK_IF_UNUSED staticni void ged_mouse_event(Ged *a, Usz vis_y, Usz vis_x,
       // own.
       fflush(stdout);
       wclear(stdscr);
+      grid_shadow_invalidate(&a->grid_shadow);
       a->is_mouse_down = true;
       a->ged_cursor.y = y;
       a->ged_cursor.x = x;
@@ -1743,27 +1743,28 @@ staticni void ged_adjust_rulers_relative(Ged *a, Isz delta_y, Isz delta_x) {
 }
 
 staticni void ged_resize_grid_relative(Ged *a, Isz delta_y, Isz delta_x) {
-  ged_resize_grid_snap_ruler(&a->field, &a->mbuf_r, a->ruler_spacing_y,
-                             a->ruler_spacing_x, delta_y, delta_x, a->tick_num,
-                             &a->scratch_field, &a->undo_hist, &a->ged_cursor);
-  a->needs_remarking = true; // could check if we actually resized
+  ged_resize_grid_snap_ruler(&a->player.field, &a->player.mbuf_r,
+                             a->ruler_spacing_y, a->ruler_spacing_x, delta_y,
+                             delta_x, a->player.tick_num, &a->scratch_field,
+                             &a->undo_hist, &a->ged_cursor);
+  orca_checkpoints_forget_from(&a->player.checkpoints, a->player.tick_num);
+  live_index_invalidate(&a->player.live_index);
+  ged_remark_all(a); // could check if we actually resized
   a->is_draw_dirty = true;
   ged_update_internal_geometry(a);
   ged_make_cursor_visible(a);
 }
 
 staticni void ged_write_character(Ged *a, char c) {
-  undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-  gbuffer_poke(a->field.buffer, a->field.height, a->field.width,
-               a->ged_cursor.y, a->ged_cursor.x, c);
-  // Indicate we want the next simulation step to be run predictavely,
-  // so that we can use the reulsting mark buffer for UI visualization.
-  // This is "expensive", so it could be skipped for non-interactive
-  // input in situations where max throughput is necessary.
-  a->needs_remarking = true;
+  ged_push_undo(a, a->ged_cursor.y, 1);
+  gbuffer_poke(a->player.field.buffer, a->player.field.height,
+               a->player.field.width, a->ged_cursor.y, a->ged_cursor.x, c);
+  live_index_update_rect(&a->player.live_index, a->player.field.buffer,
+                         a->player.field.height, a->player.field.width,
+                         a->ged_cursor.y, a->ged_cursor.x, 1, 1);
   if (a->input_mode == Ged_input_mode_append) {
-    ged_cursor_move_relative(&a->ged_cursor, a->field.height, a->field.width, 0,
-                             1);
+    ged_cursor_move_relative(&a->ged_cursor, a->player.field.height,
+                             a->player.field.width, 0, 1);
   }
   a->is_draw_dirty = true;
 }
@@ -1773,8 +1774,12 @@ staticni bool ged_fill_selection_with_char(Ged *a, Glyph c) {
   if (!ged_try_selection_clipped_to_field(a, &curs_y, &curs_x, &curs_h,
                                           &curs_w))
     return false;
-  gbuffer_fill_subrect(a->field.buffer, a->field.height, a->field.width, curs_y,
-                       curs_x, curs_h, curs_w, c);
+  gbuffer_fill_subrect(a->player.field.buffer, a->player.field.height,
+                       a->player.field.width, curs_y, curs_x, curs_h, curs_w,
+                       c);
+  live_index_update_rect(&a->player.live_index, a->player.field.buffer,
+                         a->player.field.height, a->player.field.width, curs_y,
+                         curs_x, curs_h, curs_w);
   return true;
 }
 
@@ -1783,12 +1788,13 @@ staticni bool ged_copy_selection_to_clipbard(Ged *a) {
   if (!ged_try_selection_clipped_to_field(a, &curs_y, &curs_x, &curs_h,
                                           &curs_w))
     return false;
-  Usz field_h = a->field.height;
-  Usz field_w = a->field.width;
+  Usz field_h = a->player.field.height;
+  Usz field_w = a->player.field.width;
   Field *cb_field = &a->clipboard_field;
   field_resize_raw_if_necessary(cb_field, curs_h, curs_w);
-  gbuffer_copy_subrect(a->field.buffer, cb_field->buffer, field_h, field_w,
-                       curs_h, curs_w, curs_y, curs_x, 0, 0, curs_h, curs_w);
+  gbuffer_copy_subrect(a->player.field.buffer, cb_field->buffer, field_h,
+                       field_w, curs_h, curs_w, curs_y, curs_x, 0, 0, curs_h,
+                       curs_w);
   return true;
 }
 
@@ -1803,9 +1809,8 @@ staticni void ged_input_character(Ged *a, char c) {
     if (a->ged_cursor.h <= 1 && a->ged_cursor.w <= 1) {
       ged_write_character(a, c);
     } else {
-      undo_history_push(&a->undo_hist, &a->field, a->tick_num);
+      ged_push_undo(a, a->ged_cursor.y, a->ged_cursor.h);
       ged_fill_selection_with_char(a, c);
-      a->needs_remarking = true;
       a->is_draw_dirty = true;
     }
     break;
@@ -1827,29 +1832,35 @@ typedef enum {
 } Ged_input_cmd;
 
 staticni void ged_set_playing(Ged *a, bool playing) {
-  if (playing == a->is_playing)
+  if (playing == a->player.is_playing)
     return;
-  if (playing) {
-    undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-    a->is_playing = true;
-    a->clock = stm_now();
-    a->midi_bclock_sixths = 0;
-    // dumb'n'dirty, get us close to the next step time, but not quite
-    a->accum_secs = 60.0 / (double)a->bpm / 4.0;
-    if (a->midi_bclock) {
-      send_midi_byte(a->oosc_dev, &a->midi_mode, 0xFA); // "start"
-      a->accum_secs /= 6.0;
-    }
-    a->accum_secs -= 0.0001;
-    send_control_message(a->oosc_dev, "/orca/started");
-  } else {
-    ged_stop_all_sustained_notes(a);
-    a->is_playing = false;
-    send_control_message(a->oosc_dev, "/orca/stopped");
-    if (a->midi_bclock)
-      send_midi_byte(a->oosc_dev, &a->midi_mode, 0xFC); // "stop"
+  if (playing)
+    undo_history_push(&a->undo_hist, &a->player.field, a->player.tick_num);
+  player_set_playing(&a->player, playing);
+  a->is_draw_dirty = true;
+}
+
+// Jumps to the start of the given tick, loading the nearest checkpoint if it
+// has to go back. Returns false if there's no checkpoint early enough.
+staticni bool ged_seek(Ged *a, Usz tick_num) {
+  Player *pl = &a->player;
+  bool added_hist = undo_history_push(&a->undo_hist, &pl->field, pl->tick_num);
+  undo_history_mark_all(&a->undo_hist);
+  if (!orca_seek(&pl->checkpoints, tick_num, &pl->field, &pl->mbuf_r,
+                 &pl->scratch_oevent_list, &pl->vm, &pl->live_index,
+                 &pl->band_pool, &pl->tick_num, &pl->random_seed)) {
+    if (added_hist)
+      undo_history_pop(&a->undo_hist, &pl->field, &pl->tick_num);
+    return false;
   }
+  orca_marker_invalidate(&a->marker); // The seek ran ticks into the marks
+  player_stop_all_sustained_notes(pl);
+  ged_cursor_confine(&a->ged_cursor, pl->field.height, pl->field.width);
+  ged_update_internal_geometry(a);
+  ged_make_cursor_visible(a);
+  ged_remark_all(a);
   a->is_draw_dirty = true;
+  return true;
 }
 
 staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
@@ -1857,14 +1868,17 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
   case Ged_input_cmd_undo:
     if (undo_history_count(&a->undo_hist) == 0)
       break;
-    if (a->is_playing)
-      undo_history_apply(&a->undo_hist, &a->field, &a->tick_num);
+    if (a->player.is_playing)
+      undo_history_apply(&a->undo_hist, &a->player.field, &a->player.tick_num);
     else
-      undo_history_pop(&a->undo_hist, &a->field, &a->tick_num);
-    ged_cursor_confine(&a->ged_cursor, a->field.height, a->field.width);
+      undo_history_pop(&a->undo_hist, &a->player.field, &a->player.tick_num);
+    orca_checkpoints_forget_from(&a->player.checkpoints, a->player.tick_num);
+    live_index_invalidate(&a->player.live_index);
+    ged_cursor_confine(&a->ged_cursor, a->player.field.height,
+                       a->player.field.width);
     ged_update_internal_geometry(a);
     ged_make_cursor_visible(a);
-    a->needs_remarking = true;
+    ged_remark_all(a);
     a->is_draw_dirty = true;
     break;
   case Ged_input_cmd_toggle_append_mode:
@@ -1886,17 +1900,11 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
     a->is_draw_dirty = true;
     break;
   case Ged_input_cmd_step_forward:
-    undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-    clear_and_run_vm(a->field.buffer, a->mbuf_r.buffer, a->field.height,
-                     a->field.width, a->tick_num, &a->oevent_list,
-                     a->random_seed);
-    ++a->tick_num;
-    a->activity_counter += a->oevent_list.count;
-    a->needs_remarking = true;
-    a->is_draw_dirty = true;
+    undo_history_push(&a->undo_hist, &a->player.field, a->player.tick_num);
+    player_step(&a->player); // Drawn like a tick from the clock thread
     break;
   case Ged_input_cmd_toggle_play_pause:
-    ged_set_playing(a, !a->is_playing);
+    ged_set_playing(a, !a->player.is_playing);
     break;
   case Ged_input_cmd_toggle_show_event_list:
     a->draw_event_list = !a->draw_event_list;
@@ -1904,9 +1912,8 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
     break;
   case Ged_input_cmd_cut:
     if (ged_copy_selection_to_clipbard(a)) {
-      undo_history_push(&a->undo_hist, &a->field, a->tick_num);
+      ged_push_undo(a, a->ged_cursor.y, a->ged_cursor.h);
       ged_fill_selection_with_char(a, '.');
-      a->needs_remarking = true;
       a->is_draw_dirty = true;
     }
     break;
@@ -1914,8 +1921,8 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
     ged_copy_selection_to_clipbard(a);
     break;
   case Ged_input_cmd_paste: {
-    Usz field_h = a->field.height;
-    Usz field_w = a->field.width;
+    Usz field_h = a->player.field.height;
+    Usz field_w = a->player.field.width;
     Usz curs_y = a->ged_cursor.y;
     Usz curs_x = a->ged_cursor.x;
     if (curs_y >= field_h || curs_x >= field_w)
@@ -1931,13 +1938,14 @@ staticni void ged_input_cmd(Ged *a, Ged_input_cmd ev) {
       cpy_w = field_w - curs_x;
     if (cpy_h == 0 || cpy_w == 0)
       break;
-    undo_history_push(&a->undo_hist, &a->field, a->tick_num);
-    gbuffer_copy_subrect(cb_field->buffer, a->field.buffer, cbfield_h,
+    ged_push_undo(a, curs_y, cpy_h);
+    gbuffer_copy_subrect(cb_field->buffer, a->player.field.buffer, cbfield_h,
                          cbfield_w, field_h, field_w, 0, 0, curs_y, curs_x,
                          cpy_h, cpy_w);
+    live_index_update_rect(&a->player.live_index, a->player.field.buffer,
+                           field_h, field_w, curs_y, curs_x, cpy_h, cpy_w);
     a->ged_cursor.h = cpy_h;
     a->ged_cursor.w = cpy_w;
-    a->needs_remarking = true;
     a->is_draw_dirty = true;
     break;
   }
@@ -1962,9 +1970,10 @@ static bool hacky_try_save(Field *field, char const *filename) {
   FILE *f = fopen(filename, "w");
   if (!f)
     return false;
-  field_fput(field, f);
-  fclose(f);
-  return true;
+  bool ok = field_fput(field, f);
+  if (fclose(f) != 0)
+    ok = false;
+  return ok;
 }
 
 //
@@ -1977,6 +1986,7 @@ enum {
   Save_as_form_id,
   Set_tempo_form_id,
   Set_grid_dims_form_id,
+  Seek_form_id,
   Autofit_menu_id,
   Confirm_new_file_menu_id,
   Cosmetics_menu_id,
@@ -2010,6 +2020,7 @@ enum {
   Main_menu_set_tempo,
   Main_menu_set_grid_dims,
   Main_menu_autofit_grid,
+  Main_menu_seek,
   Main_menu_about,
   Main_menu_cosmetics,
   Main_menu_playback,
@@ -2030,6 +2041,7 @@ static void push_main_menu(void) {
   qmenu_add_choice(qm, Main_menu_set_tempo, "Set BPM...");
   qmenu_add_choice(qm, Main_menu_set_grid_dims, "Set Grid Size...");
   qmenu_add_choice(qm, Main_menu_autofit_grid, "Auto-fit Grid");
+  qmenu_add_choice(qm, Main_menu_seek, "Go to Frame...");
   qmenu_add_spacer(qm);
   qmenu_add_choice(qm, Main_menu_osc, "OSC Output...");
 #ifdef FEAT_PORTMIDI
@@ -2336,6 +2348,12 @@ static void push_set_grid_dims_form(Usz init_height, Usz init_width) {
   char const *inistr = snres > 0 && (Usz)snres < sizeof buff ? buff : "57x25";
   qform_single_line_input(Set_grid_dims_form_id, "Set Grid Size", inistr);
 }
+static void push_seek_form(Usz initial) {
+  char buff[64];
+  int snres = snprintf(buff, sizeof buff, "%zu", initial);
+  char const *inistr = snres > 0 && (Usz)snres < sizeof buff ? buff : "0";
+  qform_single_line_input(Seek_form_id, "Go to Frame", inistr);
+}
 
 #ifdef FEAT_PORTMIDI
 staticni void push_portmidi_output_device_menu(Midi_mode const *midi_mode) {
@@ -2518,6 +2536,10 @@ typedef struct {
   int undo_history_limit;
   int softmargin_y, softmargin_x;
   int hardmargin_y, hardmargin_x;
+  int midi_lookahead_ms;
+  // From --osc-extra-dest. Not saved in the prefs.
+  char const **osc_extra_dests;
+  Usz osc_extra_dest_count;
   U32 prefs_touched;
   bool use_gui_cboard; // not bitfields due to taking address of
   bool strict_timing;
@@ -2574,7 +2596,7 @@ staticni void tui_load_conf(Tui *t) {
     case Confopt_midi_beat_clock: {
       bool enabled;
       if (conf_read_boolish(ez.value, &enabled)) {
-        t->ged.midi_bclock = enabled;
+        t->ged.player.midi_bclock = enabled;
         touched |= TOUCHFLAG(Confopt_midi_beat_clock);
       }
       break;
@@ -2620,7 +2642,7 @@ staticni void tui_load_conf(Tui *t) {
   }
 
 #ifdef FEAT_PORTMIDI
-  if (t->ged.midi_mode.any.type == Midi_mode_type_null &&
+  if (t->ged.player.midi_mode.any.type == Midi_mode_type_null &&
       osolen(portmidi_output_device)) {
     // PortMidi can be hilariously slow to initialize. Since it will be
     // initialized automatically if the user has a prefs entry for PortMidi
@@ -2633,8 +2655,11 @@ staticni void tui_load_conf(Tui *t) {
     if (portmidi_find_device_id_by_name(osoc(portmidi_output_device),
                                         osolen(portmidi_output_device), &pmerr,
                                         &devid)) {
-      midi_mode_deinit(&t->ged.midi_mode);
-      pmerr = midi_mode_init_portmidi(&t->ged.midi_mode, devid);
+      player_output_lock(&t->ged.player);
+      midi_mode_deinit(&t->ged.player.midi_mode);
+      pmerr = midi_mode_init_portmidi(&t->ged.player.midi_mode, devid,
+                                      t->midi_lookahead_ms);
+      player_output_unlock(&t->ged.player);
       if (pmerr) {
         // todo stuff
       }
@@ -2652,7 +2677,7 @@ staticni void tui_save_prefs(Tui *t) {
   Ezconf_w ez;
   ezconf_w_start(&ez, optsbuff, ORCA_ARRAY_COUNTOF(optsbuff), conf_file_name);
   oso *midi_output_device_name = NULL;
-  switch (t->ged.midi_mode.any.type) {
+  switch (t->ged.player.midi_mode.any.type) {
   case Midi_mode_type_null:
     break;
   case Midi_mode_type_osc_bidule:
@@ -2661,8 +2686,9 @@ staticni void tui_save_prefs(Tui *t) {
 #ifdef FEAT_PORTMIDI
   case Midi_mode_type_portmidi: {
     PmError pmerror;
-    if (!portmidi_find_name_of_device_id(t->ged.midi_mode.portmidi.device_id,
-                                         &pmerror, &midi_output_device_name) ||
+    if (!portmidi_find_name_of_device_id(
+            t->ged.player.midi_mode.portmidi.device_id, &pmerror,
+            &midi_output_device_name) ||
         osolen(midi_output_device_name) < 1) {
       osowipe(&midi_output_device_name);
       break;
@@ -2704,7 +2730,7 @@ staticni void tui_save_prefs(Tui *t) {
       break;
 #endif
     case Confopt_midi_beat_clock:
-      fputc(t->ged.midi_bclock ? '1' : '0', ez.file);
+      fputc(t->ged.player.midi_bclock ? '1' : '0', ez.file);
       break;
     case Confopt_margins:
       fprintf(ez.file, "%dx%d", t->softmargin_x, t->softmargin_y);
@@ -2783,10 +2809,14 @@ staticni void plainorfancy_menu_was_picked(Tui *t, int picked_id,
 staticni bool tui_restart_osc_udp_if_enabled_diderror(Tui *t) {
   bool error = false;
   if (t->osc_output_enabled && t->osc_port) {
-    error = !ged_set_osc_udp(&t->ged, osoc(t->osc_address) /* null ok here */,
-                             osoc(t->osc_port));
+    error = !player_set_osc_udp(&t->ged.player,
+                                osoc(t->osc_address) /* null ok here */,
+                                osoc(t->osc_port));
+    for (Usz i = 0; !error && i < t->osc_extra_dest_count; ++i) {
+      error = !player_add_osc_udp_dest(&t->ged.player, t->osc_extra_dests[i]);
+    }
   } else {
-    ged_clear_osc_udp(&t->ged);
+    player_clear_osc_udp(&t->ged.player);
   }
   return error;
 }
@@ -2794,9 +2824,9 @@ staticni void tui_restart_osc_udp_showerror(void) {
   qmsg_printf_push("OSC Networking Error", "Failed to set up OSC networking");
 }
 staticni void tui_restart_osc_udp_if_enabled(Tui *t) {
-  bool old_inuse = ged_is_using_osc_udp(&t->ged);
+  bool old_inuse = t->ged.player.oosc_dev;
   bool did_error = tui_restart_osc_udp_if_enabled_diderror(t);
-  bool new_inuse = ged_is_using_osc_udp(&t->ged);
+  bool new_inuse = t->ged.player.oosc_dev;
   if (old_inuse != new_inuse) {
     Qblock *qb = qnav_top_block();
     if (qb && qb->tag == Qblock_type_qmenu &&
@@ -2837,6 +2867,7 @@ staticni void tui_adjust_term_size(Tui *t, WINDOW **cont_window) {
       delwin(*cont_window);
     wclear(stdscr);
     *cont_window = derwin(stdscr, content_h, content_w, content_y, content_x);
+    grid_shadow_invalidate(&t->ged.grid_shadow);
     t->ged.is_draw_dirty = true;
   }
   // OK to call this unconditionally -- deriving the sub-window areas is
@@ -2849,7 +2880,7 @@ staticni void tui_adjust_term_size(Tui *t, WINDOW **cont_window) {
 
 static void tui_try_save(Tui *t) {
   if (osolen(t->file_name) > 0)
-    try_save_with_msg(&t->ged.field, t->file_name);
+    try_save_with_msg(&t->ged.player.field, t->file_name);
   else
     push_save_as_form("");
 }
@@ -2901,13 +2932,13 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
         case Main_menu_quit:
           return Tui_menus_quit;
         case Main_menu_playback:
-          push_playback_menu(t->ged.midi_bclock);
+          push_playback_menu(t->ged.player.midi_bclock);
           break;
         case Main_menu_cosmetics:
           push_cosmetics_menu();
           break;
         case Main_menu_osc:
-          push_osc_menu(ged_is_using_osc_udp(&t->ged));
+          push_osc_menu(t->ged.player.oosc_dev);
           break;
         case Main_menu_controls:
           push_controls_msg();
@@ -2931,17 +2962,21 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           push_save_as_form(osoc(t->file_name));
           break;
         case Main_menu_set_tempo:
-          push_set_tempo_form(t->ged.bpm);
+          push_set_tempo_form(t->ged.player.bpm);
           break;
         case Main_menu_set_grid_dims:
-          push_set_grid_dims_form(t->ged.field.height, t->ged.field.width);
+          push_set_grid_dims_form(t->ged.player.field.height,
+                                  t->ged.player.field.width);
           break;
         case Main_menu_autofit_grid:
           push_autofit_menu();
           break;
+        case Main_menu_seek:
+          push_seek_form(t->ged.player.tick_num);
+          break;
 #ifdef FEAT_PORTMIDI
         case Main_menu_choose_portmidi_output:
-          push_portmidi_output_device_menu(&t->ged.midi_mode);
+          push_portmidi_output_device_menu(&t->ged.player.midi_mode);
           break;
 #endif
         }
@@ -2960,11 +2995,15 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           break;
         }
         if (did_get_ok_size) {
-          ged_resize_grid(&t->ged.field, &t->ged.mbuf_r, new_field_h,
-                          new_field_w, t->ged.tick_num, &t->ged.scratch_field,
-                          &t->ged.undo_hist, &t->ged.ged_cursor);
+          ged_resize_grid(&t->ged.player.field, &t->ged.player.mbuf_r,
+                          new_field_h, new_field_w, t->ged.player.tick_num,
+                          &t->ged.scratch_field, &t->ged.undo_hist,
+                          &t->ged.ged_cursor);
+          orca_checkpoints_forget_from(&t->ged.player.checkpoints,
+                                       t->ged.player.tick_num);
+          live_index_invalidate(&t->ged.player.live_index);
           ged_update_internal_geometry(&t->ged);
-          t->ged.needs_remarking = true;
+          ged_remark_all(&t->ged);
           t->ged.is_draw_dirty = true;
           ged_make_cursor_visible(&t->ged);
         }
@@ -2981,16 +3020,20 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           Usz new_field_h, new_field_w;
           if (tui_suggest_nice_grid_size(t, t->ged.win_h, t->ged.win_w,
                                          &new_field_h, &new_field_w)) {
-            undo_history_push(&t->ged.undo_hist, &t->ged.field,
-                              t->ged.tick_num);
-            field_resize_raw(&t->ged.field, new_field_h, new_field_w);
-            memset(t->ged.field.buffer, '.',
+            undo_history_push(&t->ged.undo_hist, &t->ged.player.field,
+                              t->ged.player.tick_num);
+            undo_history_mark_all(&t->ged.undo_hist);
+            field_resize_raw(&t->ged.player.field, new_field_h, new_field_w);
+            memset(t->ged.player.field.buffer, '.',
                    new_field_h * new_field_w * sizeof(Glyph));
+            orca_checkpoints_forget_from(&t->ged.player.checkpoints, 0);
+            live_index_invalidate(&t->ged.player.live_index);
             ged_cursor_confine(&t->ged.ged_cursor, new_field_h, new_field_w);
-            mbuf_reusable_ensure_size(&t->ged.mbuf_r, new_field_h, new_field_w);
+            mbuf_reusable_ensure_size(&t->ged.player.mbuf_r, new_field_h,
+                                      new_field_w);
             ged_update_internal_geometry(&t->ged);
             ged_make_cursor_visible(&t->ged);
-            t->ged.needs_remarking = true;
+            ged_remark_all(&t->ged);
             t->ged.is_draw_dirty = true;
             osoclear(&t->file_name);
             qnav_stack_pop();
@@ -3018,11 +3061,11 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
       case Playback_menu_id:
         switch (act.picked.id) {
         case Playback_menu_midi_bclock: {
-          bool new_enabled = !t->ged.midi_bclock;
-          t->ged.midi_bclock = new_enabled;
-          if (t->ged.is_playing) {
+          bool new_enabled = !t->ged.player.midi_bclock;
+          t->ged.player.midi_bclock = new_enabled;
+          if (t->ged.player.is_playing) {
             int msgbyte = new_enabled ? 0xFA /* start */ : 0xFC /* stop */;
-            send_midi_byte(t->ged.oosc_dev, &t->ged.midi_mode, msgbyte);
+            player_output_midi_byte(&t->ged.player, msgbyte);
             // TODO timing judder will be experienced here, because the
             // deadline calculation conditions will have been changed by
             // toggling the midi_bclock flag. We would have to transfer the
@@ -3049,10 +3092,10 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
         switch (act.picked.id) {
         case Osc_menu_output_enabledisable: {
           qnav_stack_pop();
-          t->osc_output_enabled = !ged_is_using_osc_udp(&t->ged);
+          t->osc_output_enabled = !t->ged.player.oosc_dev;
           // Funny dance to keep the qnav stack in good order
           bool diderror = tui_restart_osc_udp_if_enabled_diderror(t);
-          push_osc_menu(ged_is_using_osc_udp(&t->ged));
+          push_osc_menu(t->ged.player.oosc_dev);
           if (diderror) {
             t->osc_output_enabled = false;
             tui_restart_osc_udp_showerror();
@@ -3071,9 +3114,12 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
         break;
 #ifdef FEAT_PORTMIDI
       case Portmidi_output_device_menu_id: {
-        ged_stop_all_sustained_notes(&t->ged);
-        midi_mode_deinit(&t->ged.midi_mode);
-        PmError pme = midi_mode_init_portmidi(&t->ged.midi_mode, act.picked.id);
+        player_stop_all_sustained_notes(&t->ged.player);
+        player_output_lock(&t->ged.player);
+        midi_mode_deinit(&t->ged.player.midi_mode);
+        PmError pme = midi_mode_init_portmidi(
+            &t->ged.player.midi_mode, act.picked.id, t->midi_lookahead_ms);
+        player_output_unlock(&t->ged.player);
         qnav_stack_pop();
         if (pme) {
           qmsg_printf_push("PortMidi Error",
@@ -3107,26 +3153,31 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           expand_home_tilde(&temp_name);
           if (!temp_name)
             break;
-          bool added_hist = undo_history_push(&t->ged.undo_hist, &t->ged.field,
-                                              t->ged.tick_num);
+          bool added_hist =
+              undo_history_push(&t->ged.undo_hist, &t->ged.player.field,
+                                t->ged.player.tick_num);
+          undo_history_mark_all(&t->ged.undo_hist);
           Field_load_error fle =
-              field_load_file(osoc(temp_name), &t->ged.field);
+              field_load_file(osoc(temp_name), &t->ged.player.field);
+          live_index_invalidate(&t->ged.player.live_index);
           if (fle == Field_load_error_ok) {
             qnav_stack_pop();
             osoputoso(&t->file_name, temp_name);
-            mbuf_reusable_ensure_size(&t->ged.mbuf_r, t->ged.field.height,
-                                      t->ged.field.width);
-            ged_cursor_confine(&t->ged.ged_cursor, t->ged.field.height,
-                               t->ged.field.width);
+            orca_checkpoints_forget_from(&t->ged.player.checkpoints, 0);
+            mbuf_reusable_ensure_size(&t->ged.player.mbuf_r,
+                                      t->ged.player.field.height,
+                                      t->ged.player.field.width);
+            ged_cursor_confine(&t->ged.ged_cursor, t->ged.player.field.height,
+                               t->ged.player.field.width);
             ged_update_internal_geometry(&t->ged);
             ged_make_cursor_visible(&t->ged);
-            t->ged.needs_remarking = true;
+            ged_remark_all(&t->ged);
             t->ged.is_draw_dirty = true;
             pop_qnav_if_main_menu();
           } else {
             if (added_hist)
-              undo_history_pop(&t->ged.undo_hist, &t->ged.field,
-                               &t->ged.tick_num);
+              undo_history_pop(&t->ged.undo_hist, &t->ged.player.field,
+                               &t->ged.player.tick_num);
             qmsg_printf_push("Error Loading File", "%s:\n%s", osoc(temp_name),
                              field_load_error_string(fle));
           }
@@ -3138,7 +3189,7 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           if (!temp_name)
             break;
           qnav_stack_pop();
-          bool saved_ok = try_save_with_msg(&t->ged.field, temp_name);
+          bool saved_ok = try_save_with_msg(&t->ged.player.field, temp_name);
           if (saved_ok)
             osoputoso(&t->file_name, temp_name);
           osofree(temp_name);
@@ -3150,8 +3201,24 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
             break;
           int newbpm = atoi(osoc(tmpstr));
           if (newbpm > 0) {
-            t->ged.bpm = (Usz)newbpm;
+            t->ged.player.bpm = (Usz)newbpm;
+            qnav_stack_pop();
+          }
+          osofree(tmpstr);
+          break;
+        }
+        case Seek_form_id: {
+          oso *tmpstr = qform_get_nonempty_single_line_input(qf);
+          if (!tmpstr)
+            break;
+          int frame = atoi(osoc(tmpstr));
+          if (frame > 0 || (frame == 0 && !strcmp(osoc(tmpstr), "0"))) {
             qnav_stack_pop();
+            pop_qnav_if_main_menu();
+            if (!ged_seek(&t->ged, (Usz)frame))
+              qmsg_printf_push("Can't Go to Frame",
+                               "No checkpoint was kept from before frame %d.",
+                               frame);
           }
           osofree(tmpstr);
           break;
@@ -3192,14 +3259,17 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
           if (sscanf(osoc(tmpstr), "%dx%d", &newwidth, &newheight) == 2 &&
               newheight > 0 && newwidth > 0 && newheight < ORCA_Y_MAX &&
               newwidth < ORCA_X_MAX) {
-            if (t->ged.field.height != (Usz)newheight ||
-                t->ged.field.width != (Usz)newwidth) {
-              ged_resize_grid(&t->ged.field, &t->ged.mbuf_r, (Usz)newheight,
-                              (Usz)newwidth, t->ged.tick_num,
-                              &t->ged.scratch_field, &t->ged.undo_hist,
-                              &t->ged.ged_cursor);
+            if (t->ged.player.field.height != (Usz)newheight ||
+                t->ged.player.field.width != (Usz)newwidth) {
+              ged_resize_grid(&t->ged.player.field, &t->ged.player.mbuf_r,
+                              (Usz)newheight, (Usz)newwidth,
+                              t->ged.player.tick_num, &t->ged.scratch_field,
+                              &t->ged.undo_hist, &t->ged.ged_cursor);
+              orca_checkpoints_forget_from(&t->ged.player.checkpoints,
+                                           t->ged.player.tick_num);
+              live_index_invalidate(&t->ged.player.live_index);
               ged_update_internal_geometry(&t->ged);
-              t->ged.needs_remarking = true;
+              ged_remark_all(&t->ged);
               t->ged.is_draw_dirty = true;
               ged_make_cursor_visible(&t->ged);
             }
@@ -3248,11 +3318,17 @@ staticni Tui_menus_result tui_drive_menus(Tui *t, int key) {
 enum {
   Argopt_hardmargins = UCHAR_MAX + 1,
   Argopt_undo_limit,
+  Argopt_undo_memory,
   Argopt_init_grid_size,
   Argopt_osc_midi_bidule,
   Argopt_strict_timing,
+  Argopt_midi_lookahead,
+  Argopt_osc_bundles,
+  Argopt_osc_extra_dest,
   Argopt_bpm,
   Argopt_seed,
+  Argopt_bands,
+  Argopt_max_fps,
   Argopt_portmidi_deprecated,
   Argopt_osc_deprecated,
 };
@@ -3261,12 +3337,18 @@ int main(int argc, char **argv) {
   static struct option tui_options[] = {
       {"hard-margins", required_argument, 0, Argopt_hardmargins},
       {"undo-limit", required_argument, 0, Argopt_undo_limit},
+      {"undo-memory", required_argument, 0, Argopt_undo_memory},
       {"initial-size", required_argument, 0, Argopt_init_grid_size},
       {"help", no_argument, 0, 'h'},
       {"osc-midi-bidule", required_argument, 0, Argopt_osc_midi_bidule},
       {"strict-timing", no_argument, 0, Argopt_strict_timing},
+      {"midi-lookahead", required_argument, 0, Argopt_midi_lookahead},
+      {"osc-bundles", no_argument, 0, Argopt_osc_bundles},
+      {"osc-extra-dest", required_argument, 0, Argopt_osc_extra_dest},
       {"bpm", required_argument, 0, Argopt_bpm},
       {"seed", required_argument, 0, Argopt_seed},
+      {"bands", required_argument, 0, Argopt_bands},
+      {"max-fps", required_argument, 0, Argopt_max_fps},
       {"portmidi-list-devices", no_argument, 0, Argopt_portmidi_deprecated},
       {"portmidi-output-device", required_argument, 0,
        Argopt_portmidi_deprecated},
@@ -3275,11 +3357,16 @@ int main(int argc, char **argv) {
       {NULL, 0, NULL, 0}};
   int init_bpm = 120;
   int init_seed = 1;
+  int band_threads = 1;
+  int max_fps = 60;
+  int undo_memory_mb = 64;
+  bool osc_bundles = false;
   int init_grid_dim_y = 25, init_grid_dim_x = 57;
   bool explicit_initial_grid_size = false;
 
   Tui t = {.file_name = NULL}; // Weird because of clang warning
   t.undo_history_limit = 100;
+  t.midi_lookahead_ms = 1;
   t.softmargin_y = 1;
   t.softmargin_x = 2;
   t.use_gui_cboard = true;
@@ -3315,6 +3402,10 @@ int main(int argc, char **argv) {
       if (read_int(optarg, &t.undo_history_limit) && t.undo_history_limit >= 0)
         break;
       OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_undo_memory:
+      if (read_int(optarg, &undo_memory_mb) && undo_memory_mb >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
     case Argopt_bpm:
       if (read_int(optarg, &init_bpm) && init_bpm >= 1)
         break;
@@ -3323,6 +3414,14 @@ int main(int argc, char **argv) {
       if (read_int(optarg, &init_seed) && init_seed >= 0)
         break;
       OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_bands:
+      if (read_int(optarg, &band_threads) && band_threads >= 1)
+        break;
+      OPTFAIL("Must be positive integer.");
+    case Argopt_max_fps:
+      if (read_int(optarg, &max_fps) && max_fps >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
     case Argopt_init_grid_size:
       if (sscanf(optarg, "%dx%d", &init_grid_dim_x, &init_grid_dim_y) != 2)
         OPTFAIL("Bad format or count. Expected something like: 40x30");
@@ -3340,6 +3439,25 @@ int main(int argc, char **argv) {
     case Argopt_strict_timing:
       t.strict_timing = true;
       break;
+    case Argopt_midi_lookahead:
+      if (read_int(optarg, &t.midi_lookahead_ms) && t.midi_lookahead_ms >= 0)
+        break;
+      OPTFAIL("Must be 0 or positive integer.");
+    case Argopt_osc_bundles:
+      osc_bundles = true;
+      break;
+    case Argopt_osc_extra_dest: {
+      char host[256];
+      char const *port;
+      if (!split_udp_dest(optarg, host, sizeof host, &port))
+        OPTFAIL("Expected a port, or something like: 192.168.1.2:49162");
+      Usz count = t.osc_extra_dest_count;
+      t.osc_extra_dests =
+          realloc(t.osc_extra_dests, (count + 1) * sizeof(char const *));
+      t.osc_extra_dests[count] = optarg;
+      t.osc_extra_dest_count = count + 1;
+      break;
+    }
     case Argopt_portmidi_deprecated:
       fprintf(stderr,
               "Option \"--%s\" has been removed.\nInstead, choose "
@@ -3365,11 +3483,20 @@ int main(int argc, char **argv) {
   }
   qnav_init(); // Initialize the menu/navigation global state
   // Initialize the 'Grid EDitor' stuff. This sits underneath the TUI.
-  ged_init(&t.ged, (Usz)t.undo_history_limit, (Usz)init_bpm, (Usz)init_seed);
+  ged_init(&t.ged, (Usz)t.undo_history_limit,
+           (Usz)undo_memory_mb * 1024 * 1024, (Usz)init_bpm, (Usz)init_seed,
+           (Usz)band_threads, t.strict_timing, (Usz)max_fps);
+  t.ged.player.output.osc_bundles = osc_bundles;
+  // Held from here on, except while waiting for input, so that the clock
+  // thread only runs ticks in between the things we do.
+  player_lock(&t.ged.player);
   // This will need to be changed to work with conf/menu
   if (osolen(t.osc_midi_bidule_path) > 0) {
-    midi_mode_deinit(&t.ged.midi_mode);
-    midi_mode_init_osc_bidule(&t.ged.midi_mode, osoc(t.osc_midi_bidule_path));
+    player_output_lock(&t.ged.player);
+    midi_mode_deinit(&t.ged.player.midi_mode);
+    midi_mode_init_osc_bidule(&t.ged.player.midi_mode,
+                              osoc(t.osc_midi_bidule_path));
+    player_output_unlock(&t.ged.player);
   }
   stm_setup(); // Set up timer lib
   // Enable UTF-8 by explicitly initializing our locale before initializing
@@ -3395,6 +3522,7 @@ int main(int argc, char **argv) {
   curs_set(0);             // Hide the terminal cursor
   set_escdelay(1);         // Short delay before triggering escape
   term_util_init_colors(); // Our color init routine
+  cell_attrs_init();
   mousemask(ALL_MOUSE_EVENTS | REPORT_MOUSE_POSITION, NULL);
   if (has_mouse()) // no waiting for distinguishing click from press
     mouseinterval(0);
@@ -3403,8 +3531,7 @@ int main(int argc, char **argv) {
   tui_load_conf(&t);                  // load orca.conf (if it exists)
   tui_restart_osc_udp_if_enabled(&t); // start udp if conf enabled it
 
-  wtimeout(stdscr, 0);
-  int cur_timeout = 0;
+  wtimeout(stdscr, 0); // We wait for input ourselves, in ged_wait_for_input()
   Usz brackpaste_starting_x = 0, brackpaste_y = 0, brackpaste_x = 0,
       brackpaste_max_y = 0, brackpaste_max_x = 0;
   bool is_in_brackpaste = false;
@@ -3414,13 +3541,14 @@ int main(int argc, char **argv) {
 
   bool grid_initialized = false;
   if (osolen(t.file_name)) {
-    Field_load_error fle = field_load_file(osoc(t.file_name), &t.ged.field);
+    Field_load_error fle =
+        field_load_file(osoc(t.file_name), &t.ged.player.field);
     switch (fle) {
     case Field_load_error_ok:
-      if (t.ged.field.height < 1 || t.ged.field.width < 1) {
+      if (t.ged.player.field.height < 1 || t.ged.player.field.width < 1) {
         // Opening an empty file or attempting to open a directory can lead us
         // here.
-        field_deinit(&t.ged.field);
+        field_deinit(&t.ged.player.field);
         qmsg_printf_push("Unusable File", "Not a usable file:\n%s",
                          (osoc(t.file_name)));
         break;
@@ -3451,82 +3579,39 @@ int main(int argc, char **argv) {
       new_field_h = (Usz)init_grid_dim_y;
       new_field_w = (Usz)init_grid_dim_x;
     }
-    field_init_fill(&t.ged.field, (Usz)new_field_h, (Usz)new_field_w, '.');
+    field_init_fill(&t.ged.player.field, (Usz)new_field_h, (Usz)new_field_w,
+                    '.');
   }
-  mbuf_reusable_ensure_size(&t.ged.mbuf_r, t.ged.field.height,
-                            t.ged.field.width);
+  mbuf_reusable_ensure_size(&t.ged.player.mbuf_r, t.ged.player.field.height,
+                            t.ged.player.field.width);
   ged_make_cursor_visible(&t.ged);
-  ged_send_osc_bpm(&t.ged, (I32)t.ged.bpm); // Send initial BPM
-  ged_set_playing(&t.ged, true);            // Auto-play
+  player_send_osc_bpm(&t.ged.player, (I32)t.ged.player.bpm); // Send initial BPM
+  ged_set_playing(&t.ged, true);                             // Auto-play
   // Enter main loop. Process events as they arrive.
 event_loop:;
   int key = wgetch(stdscr);
-  if (cur_timeout != 0) {
-    wtimeout(stdscr, 0); // Until we run out, don't wait between events.
-    cur_timeout = 0;
-  }
   switch (key) {
   case ERR: { // ERR indicates no more events.
-    ged_do_stuff(&t.ged);
+    int timeout_ms = player_clock_timeout_ms(&t.ged.player, Ui_max_wait_ms);
     bool drew_any = false;
-    if (ged_is_draw_dirty(&t.ged) || qnav_stack.occlusion_dirty) {
-      werase(cont_window);
+    if (qnav_stack.occlusion_dirty ||
+        (ged_is_draw_dirty(&t.ged) && ged_frame_is_due(&t.ged, &timeout_ms))) {
+      // Only the changed parts of the window get drawn, so if a menu was
+      // closed, the rest has to be copied out again to cover where it was.
+      if (qnav_stack.occlusion_dirty)
+        touchwin(cont_window);
       ged_draw(&t.ged, cont_window, osoc(t.file_name), t.fancy_grid_dots,
                t.fancy_grid_rulers);
       wnoutrefresh(cont_window);
       drew_any = true;
     }
     drew_any |= qnav_draw(); // clears qnav_stack.occlusion_dirty
+    player_unlock(&t.ged.player);
     if (drew_any)
       doupdate();
-    double secs_to_d = ged_secs_to_deadline(&t.ged);
-#define DEADTIME(_millisecs, _new_timeout)                                     \
-  else if (secs_to_d < ms_to_sec(_millisecs)) new_timeout = _new_timeout;
-    int new_timeout;
-    // These values are tuned to work OK with the normal scheduling behavior
-    // on Linux, Mac, and Windows. All of the usual caveats of trying to
-    // guess what the scheduler will do apply.
-    //
-    // Of course, there's no guarantee about how the scheduler will work, so
-    // if you are using a modified kernel or something, or the measurements
-    // here are bad, or it's some OS that behaves differently than expected,
-    // this won't be very good. But there's not really much we can do about
-    // it, and it's better than doing nothing and burning up the CPU!
-    if (t.strict_timing) { // clang-format off
-      if (false) {}
-      // "If there's less than 1.5 milliseconds to the deadline, use a curses
-      // timeout value of 0."
-      DEADTIME(  1.5,  0)
-      DEADTIME(  3.0,  1)
-      DEADTIME(  5.0,  2)
-      DEADTIME(  7.0,  3)
-      DEADTIME(  9.0,  4)
-      DEADTIME( 11.0,  5)
-      DEADTIME( 13.0,  6)
-      DEADTIME( 15.0,  7)
-      DEADTIME( 25.0, 12)
-      DEADTIME( 50.0, 20)
-      DEADTIME(100.0, 40)
-      else new_timeout = 50;
-    } else {
-      if (false) {}
-      DEADTIME(  1.0,  0)
-      DEADTIME(  2.0,  1)
-      DEADTIME(  7.0,  2)
-      DEADTIME( 15.0,  5)
-      DEADTIME( 25.0, 10)
-      DEADTIME( 50.0, 20)
-      DEADTIME(100.0, 40)
-      else new_timeout = 50;
-    } // clang-format on
-#undef DEADTIME
-    if (new_timeout != cur_timeout) {
-      wtimeout(stdscr, new_timeout);
-      cur_timeout = new_timeout;
-#if TIME_DEBUG
-      spin_track_timeout = cur_timeout;
-#endif
-    }
+    if (timeout_ms != 0)
+      ged_wait_for_input(&t.ged, timeout_ms);
+    player_lock(&t.ged.player);
     goto event_loop;
   }
   case KEY_RESIZE:
@@ -3583,7 +3668,9 @@ event_loop:;
           t.ged.ged_cursor.h = brackpaste_max_y - t.ged.ged_cursor.y + 1;
         if (brackpaste_max_x > t.ged.ged_cursor.x)
           t.ged.ged_cursor.w = brackpaste_max_x - t.ged.ged_cursor.x + 1;
-        t.ged.needs_remarking = true;
+        // The marks may have been worked out partway through.
+        ged_remark_rows(&t.ged, t.ged.ged_cursor.y,
+                        brackpaste_max_y - t.ged.ged_cursor.y + 1);
         t.ged.is_draw_dirty = true;
       }
       goto event_loop;
@@ -3600,10 +3687,16 @@ event_loop:;
         char cleaned = (char)key;
         if (!orca_is_valid_glyph((Glyph)key))
           cleaned = '.';
-        if (brackpaste_y < t.ged.field.height &&
-            brackpaste_x < t.ged.field.width) {
-          gbuffer_poke(t.ged.field.buffer, t.ged.field.height,
-                       t.ged.field.width, brackpaste_y, brackpaste_x, cleaned);
+        if (brackpaste_y < t.ged.player.field.height &&
+            brackpaste_x < t.ged.player.field.width) {
+          gbuffer_poke(t.ged.player.field.buffer, t.ged.player.field.height,
+                       t.ged.player.field.width, brackpaste_y, brackpaste_x,
+                       cleaned);
+          live_index_update_rect(&t.ged.player.live_index,
+                                 t.ged.player.field.buffer,
+                                 t.ged.player.field.height,
+                                 t.ged.player.field.width, brackpaste_y,
+                                 brackpaste_x, 1, 1);
           // Could move this out one level if we wanted the final selection
           // size to reflect even the pasted area which didn't fit on the
           // grid.
@@ -3642,10 +3735,11 @@ event_loop:;
     ged_input_cmd(&t.ged, Ged_input_cmd_undo);
     break;
   case CTRL_PLUS('r'):
-    t.ged.tick_num = 0;
-    t.ged.needs_remarking = true;
+    t.ged.player.tick_num = 0;
+    ged_remark_all(&t.ged);
     t.ged.is_draw_dirty = true;
-    reset_last_unique_value(); // Call this to reset the global unique value
+    orca_vm_reset(&t.ged.player.vm);
+    orca_checkpoints_forget_from(&t.ged.player.checkpoints, 0);
     break;
   case '[':
     ged_adjust_rulers_relative(&t.ged, 0, -1);
@@ -3708,15 +3802,19 @@ event_loop:;
     break;
   case CTRL_PLUS('v'):
     if (t.use_gui_cboard) {
+      // The pasted size isn't known until it's pasted.
       bool added_hist =
-          undo_history_push(&t.ged.undo_hist, &t.ged.field, t.ged.tick_num);
+          ged_push_undo(&t.ged, t.ged.ged_cursor.y,
+                        t.ged.player.field.height - t.ged.ged_cursor.y);
       Usz pasted_h, pasted_w;
       Cboard_error cberr = cboard_paste(
-          t.ged.field.buffer, t.ged.field.height, t.ged.field.width,
-          t.ged.ged_cursor.y, t.ged.ged_cursor.x, &pasted_h, &pasted_w);
+          t.ged.player.field.buffer, t.ged.player.field.height,
+          t.ged.player.field.width, t.ged.ged_cursor.y, t.ged.ged_cursor.x,
+          &pasted_h, &pasted_w);
       if (cberr) {
         if (added_hist)
-          undo_history_pop(&t.ged.undo_hist, &t.ged.field, &t.ged.tick_num);
+          undo_history_pop(&t.ged.undo_hist, &t.ged.player.field,
+                           &t.ged.player.tick_num);
         t.use_gui_cboard = false;
         ged_input_cmd(&t.ged, Ged_input_cmd_paste);
       } else {
@@ -3725,7 +3823,7 @@ event_loop:;
           t.ged.ged_cursor.w = pasted_w;
         }
       }
-      t.ged.needs_remarking = true;
+      live_index_invalidate(&t.ged.player.live_index);
       t.ged.is_draw_dirty = true;
     } else {
       ged_input_cmd(&t.ged, Ged_input_cmd_paste);
@@ -3749,7 +3847,8 @@ event_loop:;
     // handle. Such as bracketed paste.
     if (brackpaste_seq_getungetch(stdscr) == Brackpaste_seq_begin) {
       is_in_brackpaste = true;
-      undo_history_push(&t.ged.undo_hist, &t.ged.field, t.ged.tick_num);
+      ged_push_undo(&t.ged, t.ged.ged_cursor.y,
+                    t.ged.player.field.height - t.ged.ged_cursor.y);
       brackpaste_y = t.ged.ged_cursor.y;
       brackpaste_x = t.ged.ged_cursor.x;
       brackpaste_starting_x = brackpaste_x;
@@ -3862,7 +3961,7 @@ event_loop:;
   }
   goto event_loop;
 quit:
-  ged_stop_all_sustained_notes(&t.ged);
+  player_stop_all_sustained_notes(&t.ged.player);
   qnav_deinit();
   if (cont_window)
     delwin(cont_window);
@@ -3871,14 +3970,15 @@ quit:
 #endif
   printf("\033[?2004h\n"); // Tell terminal to not use bracketed paste
   endwin();
+  player_unlock(&t.ged.player);
   ged_deinit(&t.ged);
   osofree(t.file_name);
   osofree(t.osc_address);
   osofree(t.osc_port);
   osofree(t.osc_midi_bidule_path);
+  free(t.osc_extra_dests);
 #ifdef FEAT_PORTMIDI
-  if (portmidi_is_initialized)
-    Pm_Terminate();
+  portmidi_deinit_if_necessary();
 #endif
 }
 
@@ -17,6 +17,17 @@ void oevent_list_copy(Oevent_list const *src, Oevent_list *dest) {
   memcpy(dest->buffer, src->buffer, src_count * sizeof(Oevent));
   dest->count = src_count;
 }
+void oevent_list_append(Oevent_list const *src, Oevent_list *dest) {
+  Usz src_count = src->count, dest_count = dest->count;
+  if (dest->capacity - dest_count < src_count) {
+    Usz new_cap = orca_round_up_power2(dest_count + src_count);
+    dest->buffer = realloc(dest->buffer, new_cap * sizeof(Oevent));
+    dest->capacity = new_cap;
+  }
+  if (src_count)
+    memcpy(dest->buffer + dest_count, src->buffer, src_count * sizeof(Oevent));
+  dest->count = dest_count + src_count;
+}
 Oevent *oevent_list_alloc_item(Oevent_list *olist) {
   Usz count = olist->count;
   if (olist->capacity == count) {
@@ -76,4 +76,6 @@ void oevent_list_clear(Oevent_list *olist);
 ORCA_NOINLINE
 void oevent_list_copy(Oevent_list const *src, Oevent_list *dest);
 ORCA_NOINLINE
+void oevent_list_append(Oevent_list const *src, Oevent_list *dest);
+ORCA_NOINLINE
 Oevent *oevent_list_alloc_item(Oevent_list *olist);